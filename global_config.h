@@ -9,11 +9,97 @@
 #define EPSILON 0.0000002 // max. difference at convergence (L2 norm)
 #define MAX_ITER 200 // max. iterations of algorithm, set to 0 to disable ceiling
 // DO NOT DISABLE BOTH CHECK_CONVERGENCE AND MAX_ITER!
+#define COMPARE_TOLERANCE 0.001 // largest difference between the results of two engines, relative to the largest rank
+
+// push (out-matrix) parameters
+#define PUSH_LOCAL_BUFFERS 0 // every thread adds into its own vector (nodes * threads floats), merged in parallel
+#define PUSH_PARTITIONED 1   // every thread owns a range of destinations and pushes only into it
+#define PUSH_ATOMIC 2        // atomic float adds into the shared vector (no extra memory)
+#define PB_BIN_NODES (1 << 18) // propagation blocking: destinations per bin, their ranks (1 MB) should fit in cache
+
+// adaptive pagerank parameters
+#define ADAPTIVE_TOLERANCE 0.000001  // a node is stable in an iteration if its rank changes by at most this fraction
+#define ADAPTIVE_PERIOD 3            // stable iterations in a row after which a node is frozen
+#define ADAPTIVE_COMPACT_FRACTION 0.1 // the active rows are compacted once this share of them has been frozen
+
+// extrapolation parameters
+#define EXTRAP_NONE 0
+#define EXTRAP_AITKEN 1    // per-node Aitken delta-squared on the last 3 iterates
+#define EXTRAP_QUADRATIC 2 // quadratic extrapolation (Kamvar et al.) on the last 4 iterates
+#define EXTRAPOLATION EXTRAP_QUADRATIC // method of the extrapolated engines, compared with plain power iterations
+#define EXTRAPOLATION_PERIOD 10 // power iterations between two extrapolations
 
 // OCL worker allocation parameters
 #define WARP_SIZE 16
 #define WORKGROUP_SIZE 256
 
+// sparse matrix parameters
+#define PATTERN_ONLY 0 // if enabled, CSR/ELL/JDS/SELL matrices store no values (all values of a column are
+                       // 1/out-degree): every iteration scales the pagerank once per node and the products sum it
+
+// SELL-C-sigma parameters
+#define SELL_C 8        // rows per chunk (SIMD width on the CPU, a multiple of it on GPUs)
+#define SELL_SIGMA 256  // rows are sorted by length within windows of SELL_SIGMA rows
+
+// JDS parameters
+#define JDS_MAX_PIECES 16        // most ELL pieces (kernel launches per iteration) the JDS builder may choose
+#define JDS_MAX_PADDING 0.05     // fewer pieces are used once the padding is at most this fraction of the nonzeros
+#define JDS_MEMORY_FRACTION 0.8  // share of the device memory that the JDS matrix and vectors may use
+
+// HYB (ELL + COO) parameters
+#define HYB_ELL_FRACTION 3      // ELL width: the largest K such that at least 1/HYB_ELL_FRACTION of the rows have K entries
+#define HYB_COO_INTERVAL 64     // COO entries reduced by one OCL work item (segmented reduction)
+
+// CPU SIMD parameters
+#define SIMD_AUTO -1
+#define SIMD_SCALAR 0
+#define SIMD_AVX2 1   // 8-lane gathers (AVX2 + FMA)
+#define SIMD_AVX512 2 // 16-lane gathers (AVX-512F)
+#define SIMD_LEVEL SIMD_AUTO // gather kernels of the CSR and fused CPU engines: the widest the CPU supports, or forced
+#define SIMD_PREFETCH_DISTANCE 64 // in long rows, the ranks of the neighbours this far ahead are prefetched (0 disables)
+
+// graph size parameters
+#define LARGE_GRAPHS 0 // if enabled, edge counts and offsets are 64-bit (graphs with more than 2^31 edges);
+                       // node ids stay 32-bit. Graph caches of the other mode are rebuilt
+#if LARGE_GRAPHS
+typedef long long edge_t;
+#define EDGE_MAX 0x7fffffffffffffffLL
+#else
+typedef int edge_t;
+#define EDGE_MAX 0x7fffffff
+#endif
+
+// input parameters
+#define USE_GRAPH_CACHE 1 // if enabled, the formatted graph is stored in (and later mapped from) `<graph_file>.cache`
+#define STREAMING_INGEST 0 // if enabled, the graph is read in two passes without building the edge list (lower peak memory)
+#define FORMAT_AUTO 0     // detected from the first line of the file
+#define FORMAT_PREPARED 1 // output of `py_src/prepare_graph.py`: `[node_count]\t[edge_count]` header, ids 0..n-1
+#define FORMAT_SNAP 2     // raw edge list with arbitrary ids and `#` comments
+#define FORMAT_PAJEK 3    // `*Vertices`, `*Arcs`, `*Edges` sections, ids 1..n
+#define FORMAT_MTX 4      // MatrixMarket coordinate file, ids 1..n
+#define INPUT_FORMAT FORMAT_AUTO // set explicitly e.g. for SNAP files without comment lines
+#define ENABLE_GZIP 1 // read gzip compressed graphs (link with -lz)
+#define ENABLE_ZSTD 1 // read zstd compressed graphs (link with -lzstd)
+#define DECOMPRESS_BUFFERS 8 // buffers between the decompressing thread and the parsing threads
+#define DECOMPRESS_BUFFER_SIZE (4 << 20)
+
+// reordering parameters
+#define REORDER_NONE 0
+#define REORDER_DEGREE 1 // hubs (highest out-degree) first
+#define REORDER_BFS 2    // breadth-first order
+#define REORDER_RCM 3    // reverse Cuthill-McKee
+#define REORDER_GORDER 4 // greedy window ordering, like Gorder
+#define REORDER_STRATEGY REORDER_NONE // nodes are relabelled after loading, results are written with the original ids
+#define GORDER_WINDOW 5
+
+// output parameters
+#define OUTPUT_TEXT 0   // one `%.12f` value per line
+#define OUTPUT_FLOAT 1  // raw little-endian floats
+#define OUTPUT_DOUBLE 2 // raw little-endian doubles
+#define OUTPUT_TOP_K 3  // `[node]\t[pagerank]` lines of the TOP_K best nodes, sorted
+#define OUTPUT_FORMAT OUTPUT_TEXT
+#define TOP_K 100
+
 // other parameters
 #define MAX_SOURCE_SIZE (16384)
 #define PRINT   0
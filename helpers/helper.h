@@ -4,6 +4,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <stdbool.h>
+#include "../global_config.h"
 
 float square(float val) {
     return val * val;
@@ -49,6 +52,34 @@ int compare_vectors_detailed(float * a, float * b, int n) {
     return mistakes;
 }
 
+float max_difference(float * a, float * b, int n) {
+    // largest absolute difference, for results that are expected to differ by rounding
+    float max_diff = 0.f;
+    for (int i = 0; i < n; i++)
+        if (fabsf(a[i] - b[i]) > max_diff)
+            max_diff = fabsf(a[i] - b[i]);
+    return max_diff;
+}
+
+int check_vectors(float * reference, float * b, int n) {
+    /*
+     * compares the result of an engine with the reference one. The engines add in different orders
+     * (and some stop on other criteria), so float results only agree up to COMPARE_TOLERANCE of the
+     * largest rank. Prints the largest difference, returns 1 if it is above the tolerance
+     */
+    float max_rank = 0.f;
+    for (int i = 0; i < n; i++)
+        if (fabsf(reference[i]) > max_rank)
+            max_rank = fabsf(reference[i]);
+    float max_diff = max_difference(reference, b, n);
+    printf("Largest difference: %e (%.2e of the largest rank)\n", max_diff, max_diff / max_rank);
+    if (max_diff > COMPARE_TOLERANCE * max_rank) {
+        printf("Inconsistencies in the two vectors!!!\n");
+        return 1;
+    }
+    return 0;
+}
+
 void init_pagerank(float ** pagerank_old, float ** pagerank_new, int nodes_count) {
     *pagerank_old = (float*) malloc(nodes_count * sizeof(float));
     *pagerank_new = (float*) malloc(nodes_count * sizeof(float));
@@ -58,4 +89,48 @@ void init_pagerank(float ** pagerank_old, float ** pagerank_new, int nodes_count
         (*pagerank_old)[i] = init_value;
 }
 
+int parse_engines(char * arg, char * defaults, const char ** names, int names_count, bool * enabled) {
+    /*
+     * parses a `--engines=name1,name2` command line argument into `enabled` (one flag per
+     * entry of `names`). Without the argument (`arg` NULL) the comma separated `defaults`
+     * are enabled. Returns 1, after printing the valid names, if an engine is unknown
+     */
+    char * list = defaults;
+    if (arg != NULL) {
+        if (strncmp(arg, "--engines=", 10) != 0) {
+            printf("Unknown argument `%s`\n", arg);
+            return 1;
+        }
+        list = arg + 10;
+    }
+
+    for (int i = 0; i < names_count; i++)
+        enabled[i] = false;
+    while (*list != '\0') {
+        size_t length = strcspn(list, ",");
+        int found = 0;
+        for (int i = 0; i < names_count; i++)
+            if (strlen(names[i]) == length && strncmp(list, names[i], length) == 0) {
+                enabled[i] = true;
+                found = 1;
+            }
+        if (!found) {
+            printf("Unknown engine `%.*s`, valid engines are:", (int) length, list);
+            for (int i = 0; i < names_count; i++)
+                printf(" %s", names[i]);
+            printf("\n");
+            return 1;
+        }
+        list += length;
+        if (*list == ',')
+            list++;
+    }
+
+    for (int i = 0; i < names_count; i++)
+        if (enabled[i])
+            return 0;
+    printf("No engine selected\n");
+    return 1;
+}
+
 #endif
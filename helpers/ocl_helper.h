@@ -7,6 +7,14 @@
 #include <stdarg.h>
 #include "../global_config.h"
 
+// kernels see the host edge_t and PATTERN_ONLY through the build options
+#define OCL_STRINGIFY_VALUE(x) #x
+#define OCL_STRINGIFY(x) OCL_STRINGIFY_VALUE(x)
+#if LARGE_GRAPHS
+#define OCL_BUILD_OPTIONS "-D edge_t=long -D PATTERN_ONLY=" OCL_STRINGIFY(PATTERN_ONLY)
+#else
+#define OCL_BUILD_OPTIONS "-D edge_t=int -D PATTERN_ONLY=" OCL_STRINGIFY(PATTERN_ONLY)
+#endif
 
 float print_ocl_time(cl_event event, cl_command_queue queue, char* event_name) {
     clWaitForEvents(1, &event);
@@ -31,6 +39,21 @@ void check_status(cl_int clStatus, char* msg) {
     }
 }
 
+int ocl_device_memory(cl_ulong * global_mem_size, cl_ulong * max_alloc_size) {
+    // memory of the device that `ocl_init` uses (first GPU of the first platform)
+    cl_platform_id platform;
+    cl_device_id device;
+    cl_int clStatus = clGetPlatformIDs(1, &platform, NULL);
+    clStatus |= clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, NULL);
+    clStatus |= clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), global_mem_size, NULL);
+    clStatus |= clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(cl_ulong), max_alloc_size, NULL);
+    if (clStatus != CL_SUCCESS) {
+        printf("Error while reading device memory size, code %d\n", clStatus);
+        return 1;
+    }
+    return 0;
+}
+
 int ocl_init(char * kernel_filename, cl_command_queue * command_queue, cl_context * context,
             cl_program * program) 
 {
@@ -88,7 +111,7 @@ int ocl_init(char * kernel_filename, cl_command_queue * command_queue, cl_contex
 
     // Create and build a program
     *program = clCreateProgramWithSource(*context, 1, (const char **)&source_str, NULL, &clStatus);
-    clStatus = clBuildProgram(*program, 1, devices, NULL, NULL, NULL);
+    clStatus = clBuildProgram(*program, 1, devices, OCL_BUILD_OPTIONS, NULL, NULL);
     size_t build_log_len;
     clGetProgramBuildInfo(*program, devices[0], CL_PROGRAM_BUILD_LOG, 0, NULL, &build_log_len);
 
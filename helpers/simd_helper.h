@@ -0,0 +1,207 @@
+#ifndef SIMD_HELPER
+#define SIMD_HELPER
+
+#include <stdio.h>
+#include "../global_config.h"
+
+/*
+ * Gather kernels of the pull products: the sum of vin[idx[k]] (or of data[k] * vin[idx[k]]) over
+ * the `count` entries of a row. The programs are compiled without -march, so every vector variant
+ * is compiled for its own instruction set through a target attribute, and `simd_init` selects the
+ * widest one the CPU supports (CPUID, through __builtin_cpu_supports) at startup. Rows are processed
+ * with hardware gathers, the tail with a masked gather, and in long rows the ranks of the neighbours
+ * SIMD_PREFETCH_DISTANCE entries ahead are prefetched
+ */
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+const char * simd_names[] = {"scalar", "AVX2", "AVX-512"};
+
+struct gather_kernels {
+    int level;
+    float (*sum)(const int * idx, const float * vin, long long count);
+    float (*dot)(const int * idx, const float * data, const float * vin, long long count);
+};
+
+
+/*
+ * SCALAR KERNELS (the loops of the engines, same order of the additions)
+ */
+
+float gather_sum_scalar(const int * idx, const float * vin, long long count) {
+    float sum = 0.0f;
+    for (long long k = 0; k < count; k++)
+        sum += vin[idx[k]];
+    return sum;
+}
+
+float gather_dot_scalar(const int * idx, const float * data, const float * vin, long long count) {
+    float sum = 0.0f;
+    for (long long k = 0; k < count; k++)
+        sum += data[k] * vin[idx[k]];
+    return sum;
+}
+
+#if SIMD_X86
+
+/*
+ * AVX2 KERNELS (8 lanes, with FMA)
+ */
+
+__attribute__((target("avx2,fma")))
+static inline float hsum_avx2(__m256 acc) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256i tail_mask_avx2(long long remaining) {
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32((int) remaining), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+__attribute__((target("avx2,fma")))
+float gather_sum_avx2(const int * idx, const float * vin, long long count) {
+    __m256 acc = _mm256_setzero_ps();
+    long long k = 0;
+    for (; k + 8 <= count; k += 8) {
+        if (SIMD_PREFETCH_DISTANCE > 0 && k + SIMD_PREFETCH_DISTANCE + 8 <= count)
+            for (int l = 0; l < 8; l++)
+                _mm_prefetch((const char *) &vin[idx[k + SIMD_PREFETCH_DISTANCE + l]], _MM_HINT_T0);
+        __m256i vidx = _mm256_loadu_si256((const __m256i *) &idx[k]);
+        acc = _mm256_add_ps(acc, _mm256_i32gather_ps(vin, vidx, 4));
+    }
+    if (k < count) {
+        __m256i mask = tail_mask_avx2(count - k);
+        __m256i vidx = _mm256_maskload_epi32(&idx[k], mask);
+        acc = _mm256_add_ps(acc, _mm256_mask_i32gather_ps(_mm256_setzero_ps(), vin, vidx, _mm256_castsi256_ps(mask), 4));
+    }
+    return hsum_avx2(acc);
+}
+
+__attribute__((target("avx2,fma")))
+float gather_dot_avx2(const int * idx, const float * data, const float * vin, long long count) {
+    __m256 acc = _mm256_setzero_ps();
+    long long k = 0;
+    for (; k + 8 <= count; k += 8) {
+        if (SIMD_PREFETCH_DISTANCE > 0 && k + SIMD_PREFETCH_DISTANCE + 8 <= count)
+            for (int l = 0; l < 8; l++)
+                _mm_prefetch((const char *) &vin[idx[k + SIMD_PREFETCH_DISTANCE + l]], _MM_HINT_T0);
+        __m256i vidx = _mm256_loadu_si256((const __m256i *) &idx[k]);
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(&data[k]), _mm256_i32gather_ps(vin, vidx, 4), acc);
+    }
+    if (k < count) {
+        __m256i mask = tail_mask_avx2(count - k);
+        __m256i vidx = _mm256_maskload_epi32(&idx[k], mask);
+        __m256 values = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), vin, vidx, _mm256_castsi256_ps(mask), 4);
+        acc = _mm256_fmadd_ps(_mm256_maskload_ps(&data[k], mask), values, acc);
+    }
+    return hsum_avx2(acc);
+}
+
+
+/*
+ * AVX-512 KERNELS (16 lanes)
+ */
+
+__attribute__((target("avx512f")))
+float gather_sum_avx512(const int * idx, const float * vin, long long count) {
+    __m512 acc = _mm512_setzero_ps();
+    long long k = 0;
+    for (; k + 16 <= count; k += 16) {
+        if (SIMD_PREFETCH_DISTANCE > 0 && k + SIMD_PREFETCH_DISTANCE + 16 <= count)
+            for (int l = 0; l < 16; l++)
+                _mm_prefetch((const char *) &vin[idx[k + SIMD_PREFETCH_DISTANCE + l]], _MM_HINT_T0);
+        __m512i vidx = _mm512_loadu_si512((const void *) &idx[k]);
+        acc = _mm512_add_ps(acc, _mm512_i32gather_ps(vidx, vin, 4));
+    }
+    if (k < count) {
+        __mmask16 mask = (__mmask16) ((1u << (count - k)) - 1);
+        __m512i vidx = _mm512_maskz_loadu_epi32(mask, &idx[k]);
+        acc = _mm512_add_ps(acc, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, vidx, vin, 4));
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+__attribute__((target("avx512f")))
+float gather_dot_avx512(const int * idx, const float * data, const float * vin, long long count) {
+    __m512 acc = _mm512_setzero_ps();
+    long long k = 0;
+    for (; k + 16 <= count; k += 16) {
+        if (SIMD_PREFETCH_DISTANCE > 0 && k + SIMD_PREFETCH_DISTANCE + 16 <= count)
+            for (int l = 0; l < 16; l++)
+                _mm_prefetch((const char *) &vin[idx[k + SIMD_PREFETCH_DISTANCE + l]], _MM_HINT_T0);
+        __m512i vidx = _mm512_loadu_si512((const void *) &idx[k]);
+        acc = _mm512_fmadd_ps(_mm512_loadu_ps(&data[k]), _mm512_i32gather_ps(vidx, vin, 4), acc);
+    }
+    if (k < count) {
+        __mmask16 mask = (__mmask16) ((1u << (count - k)) - 1);
+        __m512i vidx = _mm512_maskz_loadu_epi32(mask, &idx[k]);
+        __m512 values = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, vidx, vin, 4);
+        acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &data[k]), values, acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+#endif
+
+
+/*
+ * DISPATCH
+ */
+
+struct gather_kernels gather = {SIMD_SCALAR, gather_sum_scalar, gather_dot_scalar};
+
+int simd_detect() {
+    // widest gather kernels supported by the CPU
+#if SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SIMD_AVX2;
+#endif
+    return SIMD_SCALAR;
+}
+
+void simd_select(int level) {
+    // `level` must be supported by the CPU (at most `simd_detect()`)
+    gather.level = SIMD_SCALAR;
+    gather.sum = gather_sum_scalar;
+    gather.dot = gather_dot_scalar;
+#if SIMD_X86
+    if (level == SIMD_AVX2) {
+        gather.level = SIMD_AVX2;
+        gather.sum = gather_sum_avx2;
+        gather.dot = gather_dot_avx2;
+    } else if (level == SIMD_AVX512) {
+        gather.level = SIMD_AVX512;
+        gather.sum = gather_sum_avx512;
+        gather.dot = gather_dot_avx512;
+    }
+#endif
+}
+
+int simd_init(int level) {
+    /*
+     * selects the gather kernels at startup: SIMD_AUTO picks the widest supported ones, a forced
+     * level the CPU does not support falls back to the widest supported. Returns the selected level
+     */
+    int supported = simd_detect();
+    if (level == SIMD_AUTO || level > supported) {
+        if (level != SIMD_AUTO)
+            printf("%s gather kernels are not supported by this CPU.\n", simd_names[level]);
+        level = supported;
+    }
+    simd_select(level);
+    printf("CPU gather kernels: %s\n", simd_names[gather.level]);
+    return gather.level;
+}
+
+#endif
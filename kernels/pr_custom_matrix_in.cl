@@ -1,3 +1,7 @@
+#ifndef edge_t
+#define edge_t int // set by the host build options
+#endif
+
 __kernel void compute_leaked_pagerank(
     __global int * leaves_count,
     __global int * leaves,
@@ -111,7 +115,7 @@ __kernel void compute_norm_difference_fin(
 
 __kernel void pagerank_step_simple(
     __global int * graph,
-    __global int * in_deg_CDF, // used to correctly address the graph
+    __global edge_t * in_deg_CDF, // used to correctly address the graph
     __global int * in_degrees,
     __global int * out_degrees,
     __global float * pagerank_old,
@@ -154,7 +158,7 @@ __kernel void pagerank_step_simple(
 
 __kernel void pagerank_step(
     __global int * graph,
-    __global int * in_deg_CDF, // used to correctly address the graph
+    __global edge_t * in_deg_CDF, // used to correctly address the graph
     __global int * in_degrees,
     __global int * out_degrees,
     __global float * pagerank_old,
@@ -211,7 +215,7 @@ __kernel void pagerank_step(
 
 __kernel void pagerank_step_expanded(
     __global int * graph,
-    __global int * in_deg_CDF, // used to correctly address the graph
+    __global edge_t * in_deg_CDF, // used to correctly address the graph
     __global int * in_degrees,
     __global int * expanded_out_degrees,
     __global float * pagerank_old,
@@ -233,7 +237,8 @@ __kernel void pagerank_step_expanded(
     int gid = get_global_id(0);
     float leaked_pagerank_addition = *leaked_pagerank_addition_glob / (float)*nodes_count;
 
-    int i, tmp_idx;
+    int i;
+    edge_t tmp_idx;
 
     int _node = get_global_id(0) / threads_per_row;
     int _offset = get_global_id(0) % threads_per_row;
@@ -268,7 +273,7 @@ __kernel void pagerank_step_expanded(
 }
 
 __kernel void expand_out_degrees(
-    __global int * edges_count,
+    __global edge_t * edges_count,
     __global int * out_degrees,
     __global int * graph,
     __global int * expand_out_degrees
@@ -281,12 +286,191 @@ __kernel void expand_out_degrees(
     int lid = get_local_id(0);
     int gid = get_global_id(0);
     
-    int wg_low = get_group_id(0) * (*edges_count) / get_num_groups(0); // included
-    int wg_high = (get_group_id(0) + 1) * (*edges_count) / get_num_groups(0); // excluded
+    edge_t wg_low = get_group_id(0) * (*edges_count) / get_num_groups(0); // included
+    edge_t wg_high = (get_group_id(0) + 1) * (*edges_count) / get_num_groups(0); // excluded
 
-    int _current = wg_low + lid;
+    edge_t _current = wg_low + lid;
     while (_current < wg_high) {
         expand_out_degrees[_current] = out_degrees[graph[_current]];
         _current += get_local_size(0);
     }
-}
\ No newline at end of file
+}
+__kernel void pagerank_step_adaptive(
+    __global int * active,          // nodes of the active rows
+    __global edge_t * row_start,    // `active_count + 1` entries, rows in `cols`
+    __global int * cols,            // in-neighbours that were active at the last compaction
+    __global float * frozen_sum,    // sum of pr / out_degree over the frozen in-neighbours of each row
+    __global uchar * frozen,
+    __global int * out_degrees,
+    __global float * pagerank_old,
+    __global float * pagerank_new,
+    __global float * leaked_pagerank_addition_glob,
+    __global int * nodes_count,
+    int active_count
+) {
+    /**
+     * pagerank step of adaptive pagerank: each thread computes the pagerank of one active node,
+     * the nodes frozen since the last compaction are skipped (their rank is in both vectors)
+     */
+    int gid = get_global_id(0);
+    float leaked_pagerank_addition = *leaked_pagerank_addition_glob / (float)*nodes_count;
+
+    while (gid < active_count) {
+        int node = active[gid];
+        if (!frozen[node]) {
+            double i_pr = frozen_sum[gid];
+            for (edge_t e = row_start[gid]; e < row_start[gid + 1]; e++)
+                i_pr += pagerank_old[cols[e]] / out_degrees[cols[e]];
+            pagerank_new[node] = leaked_pagerank_addition + 0.85 * i_pr;
+        }
+        gid += get_global_size(0);
+    }
+}
+
+__kernel void adaptive_update(
+    __global int * active,
+    __global uchar * stable,        // stable iterations in a row of every node
+    __global uchar * frozen,
+    __global float * pagerank_old,
+    __global float * pagerank_new,
+    __global int * frozen_count,    // incremented for every node frozen in this iteration
+    int active_count,
+    float tolerance,
+    int period
+) {
+    /**
+     * freezes the active nodes whose rank changed by at most `tolerance` (relative) for `period` iterations
+     * in a row, and copies their rank to the old vector so both vectors hold it
+     */
+    int gid = get_global_id(0);
+
+    while (gid < active_count) {
+        int node = active[gid];
+        if (!frozen[node]) {
+            float change = fabs(pagerank_new[node] - pagerank_old[node]);
+            stable[node] = change <= tolerance * pagerank_old[node] ? stable[node] + 1 : 0;
+            if (stable[node] >= period) {
+                frozen[node] = 1;
+                pagerank_old[node] = pagerank_new[node];
+                atomic_inc(frozen_count);
+            }
+        }
+        gid += get_global_size(0);
+    }
+}
+
+__kernel void extrapolation_sums_wg(
+    __global float * x0,            // iterates, oldest first
+    __global float * x1,
+    __global float * x2,
+    __global float * x3,
+    __global double * group_sums,   // 8 sums per work group
+    __local double * partial,       // 8 * local item size
+    __global int * nodes_count
+) {
+    /**
+     * sums of quadratic extrapolation: with a = x1 - x0, b = x2 - x0 and c = x3 - x0, each work group
+     * writes its part of a.a, a.b, b.b, a.c, b.c and of the sums of x1, x2 and x3 to `group_sums`;
+     * the host adds the groups up and computes the weights
+     */
+    // note: the code assumes that the local size is a power of 2
+    int gid = get_global_id(0);
+    int lid = get_local_id(0);
+    int lsize = get_local_size(0);
+
+    double s[8] = {0., 0., 0., 0., 0., 0., 0., 0.};
+    while (gid < *nodes_count) {
+        double a = x1[gid] - x0[gid], b = x2[gid] - x0[gid], c = x3[gid] - x0[gid];
+        s[0] += a * a;
+        s[1] += a * b;
+        s[2] += b * b;
+        s[3] += a * c;
+        s[4] += b * c;
+        s[5] += x1[gid];
+        s[6] += x2[gid];
+        s[7] += x3[gid];
+        gid += get_global_size(0);
+    }
+    for (int k = 0; k < 8; k++)
+        partial[k * lsize + lid] = s[k];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // reduction
+    for (int i = lsize >> 1; i > 0; i >>= 1) {
+        if (lid < i)
+            for (int k = 0; k < 8; k++)
+                partial[k * lsize + lid] += partial[k * lsize + lid + i];
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0)
+        for (int k = 0; k < 8; k++)
+            group_sums[8 * get_group_id(0) + k] = partial[k * lsize];
+}
+
+__kernel void extrapolate_aitken_wg(
+    __global float * x0,            // iterates, oldest first
+    __global float * x1,
+    __global float * x2,            // replaced by the extrapolated values
+    __global double * group_sums,   // 2 sums per work group: x2 before and after
+    __local double * partial,       // 2 * local item size
+    __global int * nodes_count
+) {
+    /**
+     * Aitken delta-squared on every node (kept as x2 unless the ratio r of the last two changes
+     * satisfies |r| < 0.99), as `aitken_extrapolate` on the host. The host scales the result to the
+     * sum of x2 with the `linear_combination` kernel
+     */
+    // note: the code assumes that the local size is a power of 2
+    int gid = get_global_id(0);
+    int lid = get_local_id(0);
+    int lsize = get_local_size(0);
+
+    double sum_before = 0., sum = 0.;
+    while (gid < *nodes_count) {
+        float x = x2[gid];
+        sum_before += x;
+        float d1 = x1[gid] - x0[gid], d2 = x - x1[gid];
+        if (d1 != 0.f) {
+            float r = d2 / d1;
+            if (fabs(r) < 0.99f && x + d2 * r / (1 - r) > 0.f)
+                x = x + d2 * r / (1 - r);
+        }
+        x2[gid] = x;
+        sum += x;
+        gid += get_global_size(0);
+    }
+    partial[lid] = sum_before;
+    partial[lsize + lid] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // reduction
+    for (int i = lsize >> 1; i > 0; i >>= 1) {
+        if (lid < i) {
+            partial[lid] += partial[lid + i];
+            partial[lsize + lid] += partial[lsize + lid + i];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0) {
+        group_sums[2 * get_group_id(0)] = partial[0];
+        group_sums[2 * get_group_id(0) + 1] = partial[lsize];
+    }
+}
+
+__kernel void linear_combination(
+    __global float * x1,
+    __global float * x2,
+    __global float * x3,            // replaced by w1 * x1 + w2 * x2 + w3 * x3
+    float w1,
+    float w2,
+    float w3,
+    __global int * nodes_count
+) {
+    int gid = get_global_id(0);
+    while (gid < *nodes_count) {
+        x3[gid] = w1 * x1[gid] + w2 * x2[gid] + w3 * x3[gid];
+        gid += get_global_size(0);
+    }
+}
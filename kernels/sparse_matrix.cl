@@ -1,6 +1,21 @@
 #define DAMPENING 0.85
 #define WARP_SIZE 16
 
+#ifndef edge_t
+#define edge_t int // set by the host build options
+#endif
+#ifndef PATTERN_ONLY
+#define PATTERN_ONLY 0 // set by the host build options
+#endif
+
+// one term of a matrix-vector product: with PATTERN_ONLY there is no `data`, the matrix values
+// (1/out-degree of the column) are applied once per node by `scaleRank`, so vin is the scaled vector
+#if PATTERN_ONLY
+#define MATRIX_TERM(idx) vin[col[idx]]
+#else
+#define MATRIX_TERM(idx) data[idx] * vin[col[idx]]
+#endif
+
 /*
  * GENERAL HELPERS
  */
@@ -50,6 +65,29 @@ __kernel void normDiff(__global const float *a, __global const float *b, int vec
 		
 }
 
+// PATTERN_ONLY: scaled[i] = vin[i] * col_scale[i], the input of the next matrix-vector product
+// (scaled has total_nodes + 1 entries, the last one stays 0 for the padding elements)
+__kernel void scaleRank(__global const float *vin, __global const float *col_scale, __global float *scaled, int total_nodes) {
+	int gid = get_global_id(0);
+	int w_total = get_global_size(0);
+
+	while (gid < total_nodes) {
+        scaled[gid] = vin[gid] * col_scale[gid];
+        gid += w_total;
+    }
+}
+
+// vout = 0, for the products that add into vout
+__kernel void zeroVector(__global float *vout, int total_nodes) {
+	int gid = get_global_id(0);
+	int w_total = get_global_size(0);
+
+	while (gid < total_nodes) {
+        vout[gid] = 0.0f;
+        gid += w_total;
+    }
+}
+
 // zeros out dangling nodes (needed for JDS)
 __kernel void nullifyDangling(__global float *vout, __global const float *dangling, int total_nodes) {
 	int gid = get_global_id(0);
@@ -67,21 +105,21 @@ __kernel void nullifyDangling(__global float *vout, __global const float *dangli
  * MATRIX-VECTOR IMPL.
  */
 
-__kernel void mCSRbasic(__global const int *rowptr, __global const int *col, __global const float *data,
+__kernel void mCSRbasic(__global const edge_t *rowptr, __global const int *col, __global const float *data,
 					   	__global const float *vin, __global float *vout, int rows) {		
     
 	int gid = get_global_id(0); 
 	if(gid < rows) {
 		float sum = 0.0f;
-        for (int j = rowptr[gid]; j < rowptr[gid + 1]; j++)
-            sum += data[j] * vin[col[j]];
+        for (edge_t j = rowptr[gid]; j < rowptr[gid + 1]; j++)
+            sum += MATRIX_TERM(j);
 		vout[gid] = sum;
 	}
 }
 
 // computes product between matrix in CSR format and vector using multiple threads per row
 // WARP_SIZE must be set correctly to match dynamic worker allocation (same as in global_config.h)
-__kernel void mCSRmulth(__global const int *rowptr, __global const int *col, __global const float *data,
+__kernel void mCSRmulth(__global const edge_t *rowptr, __global const int *col, __global const float *data,
 					    __global const float *vin, __global float *vout, __local float *buffer, int rows) {		
 	
 	int lid = get_local_id(0);
@@ -90,8 +128,8 @@ __kernel void mCSRmulth(__global const int *rowptr, __global const int *col, __g
 	int wlid = gid % WARP_SIZE; // local id within a warp
 	if (wid < rows) {
 		buffer[lid] = 0;
-		for (int j = rowptr[wid] + wlid; j < rowptr[wid + 1]; j += WARP_SIZE)
-			buffer[lid] += data[j] * vin[col[j]];
+		for (edge_t j = rowptr[wid] + wlid; j < rowptr[wid + 1]; j += WARP_SIZE)
+			buffer[lid] += MATRIX_TERM(j);
 		barrier(CLK_LOCAL_MEM_FENCE);
 		if (wlid < WARP_SIZE/2) {
 			for (int inc = WARP_SIZE/2; inc > 0; inc /= 2) {
@@ -110,10 +148,10 @@ __kernel void mELL(__global const int *col, __global const float *data,
 	int gid = get_global_id(0); 
 	if(gid < rows) {
 		float sum = 0.0f;
-		int idx;
+		edge_t idx;
 		for (int j = 0; j < elemsinrow; j++) {
-			idx = j * rows + gid;
-            sum += data[idx] * vin[col[idx]];
+			idx = (edge_t) j * rows + gid;
+            sum += MATRIX_TERM(idx);
 		}
 		vout[gid] = sum;
 	}
@@ -125,11 +163,99 @@ __kernel void mJDS(__global const int *col, __global const float *data, __global
 	int gid = get_global_id(0); 
 	if(gid < rows) {
 		float sum = 0.0f;
-		int idx;
+		edge_t idx;
 		for (int j = 0; j < elemsinrow; j++) {
-			idx = j * rows + gid;
-            sum += data[idx] * vin[col[idx]];
+			idx = (edge_t) j * rows + gid;
+            sum += MATRIX_TERM(idx);
 		}
 		vout[row_p[gid]] = sum;
 	}
 }
+
+// one work item per lane of a SELL-C-sigma chunk: the lanes of a chunk read consecutive elements
+__kernel void mSELL(__global const edge_t *chunk_ptr, __global const int *chunk_width, __global const int *row_ind,
+					    __global const int *col, __global const float *data,
+					    __global float *vin, __global float *vout, int slots, int chunk_size) {
+
+	int gid = get_global_id(0);
+	if(gid < slots) {
+		int row = row_ind[gid];
+		if(row < 0)
+			return;
+		int chunk = gid / chunk_size;
+		float sum = 0.0f;
+		edge_t idx = chunk_ptr[chunk] + gid % chunk_size;
+		for (int j = 0; j < chunk_width[chunk]; j++) {
+            sum += MATRIX_TERM(idx);
+			idx += chunk_size;
+		}
+		vout[row] = sum;
+	}
+}
+
+// COO part of a HYB matrix (sorted by row), added to vout after mELL: every work item reduces `interval`
+// consecutive entries. Rows that start and end inside the interval are added directly, the partial sums
+// of its first and last row go to carries 2*gid and 2*gid+1 (the same row twice if it has only one)
+__kernel void mCOOtail(__global const int *row, __global const int *col, __global const float *data,
+					    __global float *vin, __global float *vout, __global int *carry_row, __global float *carry_val,
+					    edge_t nonzeros, int interval) {
+
+	int gid = get_global_id(0);
+	edge_t begin = (edge_t) gid * interval;
+	if(begin >= nonzeros) {
+		carry_row[2*gid] = -1;
+		carry_row[2*gid + 1] = -1;
+		return;
+	}
+	edge_t end = begin + interval < nonzeros ? begin + interval : nonzeros;
+
+	int first_row = row[begin], last_row = row[end - 1];
+	int current = first_row;
+	float sum = 0.0f;
+	for (edge_t idx = begin; idx < end; idx++) {
+		if(row[idx] != current) {
+			if(current == first_row)
+				carry_val[2*gid] = sum;
+			else
+				vout[current] += sum;
+			current = row[idx];
+			sum = 0.0f;
+		}
+		sum += MATRIX_TERM(idx);
+	}
+	carry_row[2*gid] = first_row;
+	carry_row[2*gid + 1] = last_row;
+	if(first_row == last_row) {
+		carry_val[2*gid] = sum;
+		carry_val[2*gid + 1] = 0.0f;
+	} else
+		carry_val[2*gid + 1] = sum;
+}
+
+// adds the carries of mCOOtail: they are sorted by row (-1 after the last entry), the first work item
+// of every run of equal rows sums the run
+__kernel void mCOOcarry(__global const int *carry_row, __global const float *carry_val, __global float *vout, int carries) {
+	int gid = get_global_id(0);
+	if(gid < carries && carry_row[gid] >= 0 && (gid == 0 || carry_row[gid - 1] != carry_row[gid])) {
+		float sum = 0.0f;
+		for (int k = gid; k < carries && carry_row[k] == carry_row[gid]; k++)
+			sum += carry_val[k];
+		vout[carry_row[gid]] += sum;
+	}
+}
+
+// column-blocked CSR: one work item per segment (the nonzeros of a row in the column block that starts
+// at col_base, with 16-bit local columns). Launched once per block, so a row is never updated concurrently
+__kernel void mBCSR(__global const edge_t *seg_ptr, __global const int *seg_row, __global const ushort *col,
+					__global const float *data, __global const float *vin, __global float *vout,
+					edge_t seg_begin, edge_t seg_end, int col_base) {
+
+	edge_t seg = seg_begin + get_global_id(0);
+	if(seg < seg_end) {
+		vin += col_base;
+		float sum = 0.0f;
+		for(edge_t idx = seg_ptr[seg]; idx < seg_ptr[seg+1]; idx++)
+			sum += MATRIX_TERM(idx);
+		vout[seg_row[seg]] += sum;
+	}
+}
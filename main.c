@@ -3,79 +3,197 @@
 #include <omp.h> 
 #include <stdbool.h>
 #include "readers/custom_matrix.h"
-#include "readers/mtx_sparse.h"
+#include "readers/graph_store.h"
 #include "pagerank_implementations/pagerank_custom.h"
+#include "pagerank_implementations/pagerank_sparse_cpu.h"
 #include "helpers/file_helper.h"
+#include "helpers/helper.h"
 #include "global_config.h"
 
-float * measure_time_custom_matrix_out(int ** edges, int * out_degrees, int nodes_count, int edges_count);
-float * measure_time_custom_matrix_in(int ** edges, int * in_degrees, int * out_degrees, int nodes_count, int edges_count);
-float * measure_time_csr(int ** edges, int * in_degrees, int * out_degrees, int nodes_count, int edges_count);
+#define ENGINES_COUNT 15
+const char * engine_names[ENGINES_COUNT] = {"out", "in", "in_ocl", "compressed", "csr", "sell", "hyb", "bcsr", "fused", "push",
+            "blocked", "gs", "delta", "adaptive", "extrap"};
+// push, blocked, gs, delta, adaptive and extrap are alternatives to the out and in engines, only run them when requested
+#define DEFAULT_ENGINES "out,in,in_ocl,compressed,csr,sell,hyb,bcsr,fused"
+
+float * measure_time_custom_matrix_out(struct graph_store * g);
+float * measure_time_custom_matrix_out_parallel(struct graph_store * g);
+float * measure_time_custom_matrix_out_blocked(struct graph_store * g);
+float * measure_time_custom_matrix_in(struct graph_store * g);
+float * measure_time_custom_matrix_in_ocl(struct graph_store * g);
+float * measure_time_custom_matrix_in_compressed(struct graph_store * g);
+float * measure_time_csr(struct graph_store * g);
+float * measure_time_sell(struct graph_store * g);
+float * measure_time_hyb(struct graph_store * g);
+float * measure_time_bcsr(struct graph_store * g);
+float * measure_time_custom_matrix_in_fused(struct graph_store * g);
+float * measure_time_custom_matrix_in_gauss_seidel(struct graph_store * g);
+float * measure_time_custom_matrix_out_delta(struct graph_store * g);
+float * measure_time_custom_matrix_in_adaptive(struct graph_store * g);
+float * measure_time_custom_matrix_in_extrapolated(struct graph_store * g);
 
 int main(int argc, char* argv[]) {
 
-    if (argc != 3) {
-        printf("Usage: ./a.out <graph_file_name> <out_file_name>\n");
+    bool engines[ENGINES_COUNT];
+    if (argc < 3 || argc > 4 || parse_engines(argc == 4 ? argv[3] : NULL, DEFAULT_ENGINES,
+                engine_names, ENGINES_COUNT, engines)) {
+        printf("Usage: ./a.out <graph_file_name> <out_file_name> [--engines=out,in,in_ocl,compressed,csr,sell,hyb,bcsr,fused,push,blocked,gs,delta,adaptive,extrap]\n");
         exit(1);
     }
-    print_vendor_type();
-    int nodes_count, edges_count, i;
-    double start, end;
+    if (engines[2])
+        print_vendor_type();
+    simd_init(SIMD_LEVEL);
 
-    start = omp_get_wtime();
-    int ** edges;
-    int * out_degrees;
-    int * in_degrees;
-    if(read_edges(argv[1], &edges, &out_degrees, &in_degrees, &nodes_count, &edges_count))
+    // read the graph once (or map it from the graph cache), every engine derives its format from it
+    struct graph_store g;
+    if (graph_store_load(&g, argv[1]))
         exit(1);
-    
-    end = omp_get_wtime();
-    printf("Matrix reading time: %.4f\n", end - start);
 
-    // compute pagerank with multiple strategies
-    float * ref_pagerank = measure_time_custom_matrix_out(edges, out_degrees, nodes_count, edges_count);
-    float * pagerank_in = measure_time_custom_matrix_in(edges, in_degrees, out_degrees, nodes_count, edges_count);
+    // run alone, the compressed engine only keeps the compressed in-lists: they are encoded right away
+    // (from the mapped graph cache if there is one) and the int in-lists are released
+    int engines_count = 0;
+    for (int e = 0; e < ENGINES_COUNT; e++)
+        engines_count += engines[e];
+    if (engines[3] && engines_count == 1) {
+        if (graph_store_compressed(&g) == NULL)
+            exit(1);
+        graph_store_release_in(&g);
+    }
 
-    // compare the obtained pageranks
-    compare_vectors(ref_pagerank, pagerank_in, nodes_count);
+    // compute pagerank with the selected strategies
+    float * results[ENGINES_COUNT] = {NULL};
+    if (engines[0])
+        results[0] = measure_time_custom_matrix_out(&g);
+    if (engines[1])
+        results[1] = measure_time_custom_matrix_in(&g);
+    if (engines[2])
+        results[2] = measure_time_custom_matrix_in_ocl(&g);
+    if (engines[3])
+        results[3] = measure_time_custom_matrix_in_compressed(&g);
+    if (engines[4])
+        results[4] = measure_time_csr(&g);
+    if (engines[5])
+        results[5] = measure_time_sell(&g);
+    if (engines[6])
+        results[6] = measure_time_hyb(&g);
+    if (engines[7])
+        results[7] = measure_time_bcsr(&g);
+    if (engines[8])
+        results[8] = measure_time_custom_matrix_in_fused(&g);
+    if (engines[9])
+        results[9] = measure_time_custom_matrix_out_parallel(&g);
+    if (engines[10])
+        results[10] = measure_time_custom_matrix_out_blocked(&g);
+    if (engines[11])
+        results[11] = measure_time_custom_matrix_in_gauss_seidel(&g);
+    if (engines[12])
+        results[12] = measure_time_custom_matrix_out_delta(&g);
+    if (engines[13])
+        results[13] = measure_time_custom_matrix_in_adaptive(&g);
+    if (engines[14])
+        results[14] = measure_time_custom_matrix_in_extrapolated(&g);
 
-    // write the reference pagerank to file to be compared with the nx results
-    write_to_file(argv[2], ref_pagerank, nodes_count);
+    // the first engine that ran provides the reference pagerank, written to file to be compared with the nx results
+    int reference = 0;
+    while (results[reference] == NULL)
+        reference++;
+    graph_store_write_results(&g, argv[2], results[reference]);
+
+    // compare the other obtained pageranks with it
+    int inconsistent = 0;
+    for (int e = reference + 1; e < ENGINES_COUNT; e++) {
+        if (results[e] == NULL)
+            continue;
+        printf("\nComparing `%s` with `%s`\n", engine_names[e], engine_names[reference]);
+        inconsistent |= check_vectors(results[reference], results[e], g.nodes_count);
+    }
+    graph_store_free(&g);
+    return inconsistent;
 }
 
-float * measure_time_custom_matrix_out(int ** edges, int * out_degrees, int nodes_count, int edges_count) {
+float * measure_time_custom_matrix_out(struct graph_store * g) {
     double start, end;
-    int ** graph;
-    int * leaves;
-    int leaves_count;
 
     printf("\nCOMPUTING PAGERANK WITH CUSTOM_MATRIX_OUT\n");
-    start = omp_get_wtime();
-    format_graph_out(edges, out_degrees, &leaves_count, &leaves, &graph, nodes_count, edges_count);
-    end = omp_get_wtime();
-    printf("CUSTOM_MATRIX_OUT - Matrix formatting time: %.4f\n", end - start);
+    int ** graph = graph_store_out(g);
+    if (graph == NULL)
+        exit(1);
 
     start = omp_get_wtime();
-    float * pagerank = pagerank_custom_out(graph, out_degrees, leaves_count, leaves, nodes_count, EPSILON);
+    float * pagerank = pagerank_custom_out(graph, g->out_degrees, g->leaves_count, g->leaves, g->nodes_count, EPSILON);
     end = omp_get_wtime();
     printf("TOTAL CUSTOM_MATRIX_OUT - Pagerank computation time (serial): %.4f\n\n", end - start);
-    free(graph);
     return pagerank;
 
 }
 
-float * measure_time_custom_matrix_in(int ** edges, int * in_degrees, int * out_degrees, int nodes_count, int edges_count) {
+float * measure_time_custom_matrix_out_parallel(struct graph_store * g) {
     double start, end;
-    int ** graph;
-    int * leaves;
-    int leaves_count;
+    const char * strategy_names[] = {"thread-local buffers", "partitioned destinations", "atomic adds"};
+    float * pagerank = NULL;
+
+    printf("\nCOMPUTING PAGERANK WITH CUSTOM_MATRIX_OUT (PUSH)\n");
+    int ** graph = graph_store_out(g);
+    if (graph == NULL)
+        exit(1);
+
+    // partitioned destinations first: it adds in the order of the serial engine, so it is the returned result
+    int strategies[] = {PUSH_PARTITIONED, PUSH_LOCAL_BUFFERS, PUSH_ATOMIC};
+    for (int k = 0; k < 3; k++) {
+        int strategy = strategies[k];
+        start = omp_get_wtime();
+        float * pagerank_push = pagerank_custom_out_parallel(graph, g->out_degrees, g->leaves_count, g->leaves,
+                        g->nodes_count, EPSILON, strategy);
+        end = omp_get_wtime();
+        printf("TOTAL CUSTOM_MATRIX_OUT - Pagerank computation time (%s, OMP with %d threads): %.4f\n\n",
+                strategy_names[strategy], omp_get_max_threads(), end - start);
+        // the strategies add the contributions of a destination in different orders
+        if (pagerank == NULL) {
+            pagerank = pagerank_push;
+        } else {
+            printf("Largest difference from partitioned destinations: %e\n", max_difference(pagerank, pagerank_push, g->nodes_count));
+            free(pagerank_push);
+        }
+    }
+    return pagerank;
+}
+
+float * measure_time_custom_matrix_out_blocked(struct graph_store * g) {
+    double start, end;
+
+    printf("\nCOMPUTING PAGERANK WITH PROPAGATION BLOCKING\n");
+    int ** graph = graph_store_out(g);
+    if (graph == NULL)
+        exit(1);
 
-    printf("\nCOMPUTING PAGERANK WITH CUSTOM_MATRIX_IN\n");
     start = omp_get_wtime();
-    format_graph_in(edges, in_degrees, out_degrees, &leaves_count, &leaves, &graph, nodes_count, edges_count);
+    float * pagerank = pagerank_custom_out_blocked(graph, g->out_degrees, g->leaves_count, g->leaves, g->nodes_count, EPSILON);
     end = omp_get_wtime();
-    printf("CUSTOM_MATRIX_IN - Matrix formatting time: %.4f\n", end - start);
-    
+    printf("TOTAL PROPAGATION BLOCKING - Pagerank computation time (OMP with %d threads): %.4f\n\n", omp_get_max_threads(), end - start);
+    return pagerank;
+}
+
+float * measure_time_custom_matrix_out_delta(struct graph_store * g) {
+    double start, end;
+
+    printf("\nCOMPUTING PAGERANK WITH RESIDUAL PUSH\n");
+    int ** graph = graph_store_out(g);
+    if (graph == NULL)
+        exit(1);
+
+    start = omp_get_wtime();
+    float * pagerank = pagerank_custom_out_delta(graph, g->out_degrees, g->nodes_count, EPSILON);
+    end = omp_get_wtime();
+    printf("TOTAL RESIDUAL PUSH - Pagerank computation time (OMP with %d threads): %.4f\n\n", omp_get_max_threads(), end - start);
+    return pagerank;
+}
+
+float * measure_time_custom_matrix_in(struct graph_store * g) {
+    double start, end;
+    int ** graph = g->in, * in_degrees = g->in_degrees, * out_degrees = g->out_degrees;
+    int * leaves = g->leaves, leaves_count = g->leaves_count, nodes_count = g->nodes_count;
+
+    printf("\nCOMPUTING PAGERANK WITH CUSTOM_MATRIX_IN\n");
     start = omp_get_wtime();
     float * pagerank = pagerank_custom_in(graph, in_degrees, out_degrees, leaves_count, leaves, nodes_count, EPSILON, false);
     end = omp_get_wtime();
@@ -91,27 +209,227 @@ float * measure_time_custom_matrix_in(int ** edges, int * in_degrees, int * out_
         end = omp_get_wtime();
         printf("TOTAL CUSTOM_MATRIX_IN - Pagerank computation time (OMP with %d threads): %.4f\n\n", omp_get_max_threads(), end - start);
     }
+    // the later engines run with all the threads again
+    omp_set_num_threads(max_threads);
+
+    check_vectors(pagerank, pagerank_omp, nodes_count);
+    return pagerank;
+}
+
+float * measure_time_custom_matrix_in_ocl(struct graph_store * g) {
+    double start, end;
+    int ** graph = g->in, * in_degrees = g->in_degrees, * out_degrees = g->out_degrees;
+    int * leaves = g->leaves, leaves_count = g->leaves_count, nodes_count = g->nodes_count;
+    edge_t edges_count = g->edges_count;
+
+    printf("\nCOMPUTING PAGERANK WITH CUSTOM_MATRIX_IN (OCL)\n");
 
     // ocl - pass `start` and `end` to function so not to measure compilation etc.
     float * pagerank_ocl_simple = pagerank_custom_in_ocl(graph, in_degrees, out_degrees, leaves_count,
-                    leaves, nodes_count, edges_count, EPSILON, &start, &end, "pagerank_step_simple");
+                    leaves, nodes_count, edges_count, EPSILON, &start, &end, "pagerank_step_simple",
+                    EXTRAP_NONE);
     printf("TOTAL CUSTOM_MATRIX_IN - Pagerank computation time (OCL, one thread per row): %.4f\n\n", end - start);
 
 
     float * pagerank_ocl = pagerank_custom_in_ocl(graph, in_degrees, out_degrees, leaves_count,
-                    leaves, nodes_count, edges_count, EPSILON, &start, &end, "pagerank_step");
+                    leaves, nodes_count, edges_count, EPSILON, &start, &end, "pagerank_step",
+                    EXTRAP_NONE);
     printf("TOTAL CUSTOM_MATRIX_IN - Pagerank computation time (OCL): %.4f\n\n", end - start);
 
     float * pagerank_ocl_exp = pagerank_custom_in_ocl(graph, in_degrees, out_degrees, leaves_count,
-                    leaves ,nodes_count, edges_count, EPSILON, &start, &end, "pagerank_step_expanded");
+                    leaves ,nodes_count, edges_count, EPSILON, &start, &end, "pagerank_step_expanded",
+                    EXTRAP_NONE);
     printf("TOTAL CUSTOM_MATRIX_IN - Pagerank computation time (expanded OCL): %.4f\n\n", end - start);
 
-    compare_vectors(pagerank, pagerank_omp, nodes_count);
-    compare_vectors(pagerank, pagerank_ocl_simple, nodes_count);
-    compare_vectors(pagerank, pagerank_ocl_exp, nodes_count);
-    compare_vectors(pagerank, pagerank_ocl, nodes_count);
+    check_vectors(pagerank_ocl_simple, pagerank_ocl_exp, nodes_count);
+    check_vectors(pagerank_ocl_simple, pagerank_ocl, nodes_count);
+
+    return pagerank_ocl_simple;
+
+}
+
+float * measure_time_custom_matrix_in_compressed(struct graph_store * g) {
+    double start, end;
+    int * in_degrees = g->in_degrees, * out_degrees = g->out_degrees;
+    int * leaves = g->leaves, leaves_count = g->leaves_count;
+
+    printf("\nCOMPUTING PAGERANK WITH COMPRESSED CUSTOM_MATRIX_IN\n");
+    custom_matrix_compressed * cgraph = graph_store_compressed(g);
+    if (cgraph == NULL)
+        exit(1);
+
+    start = omp_get_wtime();
+    float * pagerank = pagerank_custom_in_compressed(cgraph, in_degrees, out_degrees, leaves_count, leaves, EPSILON, false);
+    end = omp_get_wtime();
+    printf("TOTAL COMPRESSED CUSTOM_MATRIX_IN - Pagerank computation time (serial): %.4f\n\n", end - start);
+
+    float * pagerank_omp;
+    int max_threads = omp_get_max_threads();
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        omp_set_num_threads(threads);
+        start = omp_get_wtime();
+        pagerank_omp = pagerank_custom_in_compressed(cgraph, in_degrees, out_degrees, leaves_count, leaves, EPSILON, true);
+        end = omp_get_wtime();
+        printf("TOTAL COMPRESSED CUSTOM_MATRIX_IN - Pagerank computation time (OMP with %d threads): %.4f\n\n", omp_get_max_threads(), end - start);
+        free(pagerank_omp);
+    }
+    omp_set_num_threads(max_threads);
+    return pagerank;
+}
+
+float * measure_time_custom_matrix_in_fused(struct graph_store * g) {
+    double start, end;
+    float * pagerank = NULL;
+
+    printf("\nCOMPUTING PAGERANK WITH FUSED CUSTOM_MATRIX_IN\n");
+    int max_threads = omp_get_max_threads();
+
+    // the scalar loop first, as a baseline for the gather kernels selected at startup
+    int level = gather.level;
+    float * pagerank_scalar = NULL;
+    if (level != SIMD_SCALAR) {
+        simd_select(SIMD_SCALAR);
+        start = omp_get_wtime();
+        pagerank_scalar = pagerank_custom_in_fused(g->in, g->in_degrees, g->out_degrees, g->nodes_count, EPSILON);
+        end = omp_get_wtime();
+        printf("TOTAL FUSED CUSTOM_MATRIX_IN - Pagerank computation time (scalar, OMP with %d threads): %.4f\n\n", max_threads, end - start);
+        simd_select(level);
+    }
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        omp_set_num_threads(threads);
+        free(pagerank);
+        start = omp_get_wtime();
+        pagerank = pagerank_custom_in_fused(g->in, g->in_degrees, g->out_degrees, g->nodes_count, EPSILON);
+        end = omp_get_wtime();
+        printf("TOTAL FUSED CUSTOM_MATRIX_IN - Pagerank computation time (%s, OMP with %d threads): %.4f\n\n",
+                simd_names[level], threads, end - start);
+    }
+    omp_set_num_threads(max_threads);
+    if (pagerank_scalar != NULL) {
+        printf("Largest difference from the scalar loop: %e\n", max_difference(pagerank_scalar, pagerank, g->nodes_count));
+        free(pagerank_scalar);
+    }
+    return pagerank;
+}
+
+float * measure_time_custom_matrix_in_gauss_seidel(struct graph_store * g) {
+    double start, end;
+
+    printf("\nCOMPUTING PAGERANK WITH GAUSS-SEIDEL CUSTOM_MATRIX_IN\n");
+    start = omp_get_wtime();
+    float * pagerank = pagerank_custom_in_gauss_seidel(g->in, g->in_degrees, g->out_degrees, g->nodes_count, EPSILON);
+    end = omp_get_wtime();
+    printf("TOTAL GAUSS-SEIDEL CUSTOM_MATRIX_IN - Pagerank computation time (OMP with %d threads): %.4f\n\n",
+            omp_get_max_threads(), end - start);
+    // without the convergence check every engine runs MAX_ITER iterations, so the sweeps saved do not show
+    if (!CHECK_CONVERGENCE)
+        printf("CHECK_CONVERGENCE is off: the iteration count cannot be compared with the Jacobi engines\n\n");
+    return pagerank;
+}
+
+float * measure_time_custom_matrix_in_adaptive(struct graph_store * g) {
+    double start, end;
+
+    printf("\nCOMPUTING PAGERANK WITH ADAPTIVE CUSTOM_MATRIX_IN\n");
+    start = omp_get_wtime();
+    float * pagerank = pagerank_custom_in_adaptive(g->in, g->in_degrees, g->out_degrees, g->leaves_count, g->leaves,
+                    g->nodes_count, EPSILON);
+    end = omp_get_wtime();
+    printf("TOTAL ADAPTIVE CUSTOM_MATRIX_IN - Pagerank computation time (OMP with %d threads): %.4f\n\n",
+            omp_get_max_threads(), end - start);
+    return pagerank;
+}
+
+float * measure_time_custom_matrix_in_extrapolated(struct graph_store * g) {
+    double start, end;
+    const char * method_names[] = {"none", "Aitken", "quadratic"};
+
+    printf("\nCOMPUTING PAGERANK WITH EXTRAPOLATED CUSTOM_MATRIX_IN\n");
+    start = omp_get_wtime();
+    float * pagerank = pagerank_custom_in_extrapolated(g->in, g->in_degrees, g->out_degrees, g->leaves_count, g->leaves,
+                    g->nodes_count, EPSILON, EXTRAPOLATION);
+    end = omp_get_wtime();
+    printf("TOTAL EXTRAPOLATED CUSTOM_MATRIX_IN - Pagerank computation time (%s every %d iterations, OMP with %d threads): %.4f\n\n",
+            method_names[EXTRAPOLATION], EXTRAPOLATION_PERIOD, omp_get_max_threads(), end - start);
+    // without the convergence check every engine runs MAX_ITER iterations, so the iterations saved do not show
+    if (!CHECK_CONVERGENCE)
+        printf("CHECK_CONVERGENCE is off: the iteration count cannot be compared with the power iteration\n\n");
+    return pagerank;
+}
+
+float * measure_time_csr(struct graph_store * g) {
+    double start, end;
+
+    printf("\nCOMPUTING PAGERANK WITH CSR (CPU)\n");
+    mtx_CSR * mCSR = graph_store_csr(g);
+    if (mCSR == NULL)
+        exit(1);
+
+    // the scalar loop first, as a baseline for the gather kernels selected at startup
+    int level = gather.level;
+    float * pagerank_scalar = NULL;
+    if (level != SIMD_SCALAR) {
+        simd_select(SIMD_SCALAR);
+        start = omp_get_wtime();
+        pagerank_scalar = pagerank_CSR_cpu(*mCSR);
+        end = omp_get_wtime();
+        printf("TOTAL CSR - Pagerank computation time (scalar, OMP with %d threads): %.4f\n\n", omp_get_max_threads(), end - start);
+        simd_select(level);
+    }
+
+    start = omp_get_wtime();
+    float * pagerank = pagerank_CSR_cpu(*mCSR);
+    end = omp_get_wtime();
+    printf("TOTAL CSR - Pagerank computation time (%s, OMP with %d threads): %.4f\n\n", simd_names[level], omp_get_max_threads(), end - start);
+    if (pagerank_scalar != NULL) {
+        printf("Largest difference from the scalar loop: %e\n", max_difference(pagerank_scalar, pagerank, g->nodes_count));
+        free(pagerank_scalar);
+    }
+    return pagerank;
+}
 
-    free(graph);
+float * measure_time_sell(struct graph_store * g) {
+    double start, end;
+
+    printf("\nCOMPUTING PAGERANK WITH SELL-C-SIGMA (CPU)\n");
+    mtx_SELL * mSELL = graph_store_sell(g);
+    if (mSELL == NULL)
+        exit(1);
+
+    start = omp_get_wtime();
+    float * pagerank = pagerank_SELL_cpu(*mSELL);
+    end = omp_get_wtime();
+    printf("TOTAL SELL - Pagerank computation time (OMP with %d threads): %.4f\n\n", omp_get_max_threads(), end - start);
     return pagerank;
+}
 
-}
\ No newline at end of file
+float * measure_time_hyb(struct graph_store * g) {
+    double start, end;
+
+    printf("\nCOMPUTING PAGERANK WITH HYB (CPU)\n");
+    mtx_HYB * mHYB = graph_store_hyb(g);
+    if (mHYB == NULL)
+        exit(1);
+
+    start = omp_get_wtime();
+    float * pagerank = pagerank_HYB_cpu(*mHYB);
+    end = omp_get_wtime();
+    printf("TOTAL HYB - Pagerank computation time (OMP with %d threads): %.4f\n\n", omp_get_max_threads(), end - start);
+    return pagerank;
+}
+
+float * measure_time_bcsr(struct graph_store * g) {
+    double start, end;
+
+    printf("\nCOMPUTING PAGERANK WITH COLUMN-BLOCKED CSR (CPU)\n");
+    mtx_BCSR * mBCSR = graph_store_bcsr(g);
+    if (mBCSR == NULL)
+        exit(1);
+
+    start = omp_get_wtime();
+    float * pagerank = pagerank_BCSR_cpu(*mBCSR);
+    end = omp_get_wtime();
+    printf("TOTAL BCSR - Pagerank computation time (OMP with %d threads): %.4f\n\n", omp_get_max_threads(), end - start);
+    return pagerank;
+}
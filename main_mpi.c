@@ -3,7 +3,10 @@
 #include <omp.h> 
 #include <stdbool.h>
 #include <unistd.h>
+#include <limits.h>
+#include <string.h>
 #include "readers/custom_matrix.h"
+#include "readers/graph_store.h"
 #include "readers/mtx_sparse.h"
 #include "pagerank_implementations/pagerank_custom_mpi.h"
 #include "pagerank_implementations/pagerank_custom.h"
@@ -11,9 +14,12 @@
 #include "global_config.h"
 
 #define MASTER 0
+#define SCATTER_CHUNK (1 << 30) // ints per point to point message when the graph does not fit MPI counts
 
 void measure_time_custom_matrix_in_mpi(int ** graph, int * in_degrees, int * out_degrees, int nodes_count, int leaves_count, 
                 int * leaves, int my_id, int world_size);
+void scatter_graph(int * graph, long long * counts, long long * displacements, int * my_graph,
+                int my_id, int world_size);
 
 int main(int argc, char* argv[]) {
 
@@ -38,23 +44,19 @@ int main(int argc, char* argv[]) {
     int * out_degrees;
     int * in_degrees;
     int * leaves;
-    int nodes_count, edges_count, i, leaves_count;
+    int nodes_count, leaves_count;
 
     if (my_id == MASTER){
-        // the master node reads and formats the graph
-        int ** edges;
-
-        start = MPI_Wtime();
-        if(read_edges(argv[1], &edges, &out_degrees, &in_degrees, &nodes_count, &edges_count))
+        // the master node reads and formats the graph (or maps it from the graph cache)
+        struct graph_store g;
+        if (graph_store_load(&g, argv[1]))
             exit(1);
-        end = MPI_Wtime();
-        printf("Matrix reading time: %.4f\n", end - start);
-
-        // format graph
-        start = MPI_Wtime();
-        format_graph_in(edges, in_degrees, out_degrees, &leaves_count, &leaves, &graph, nodes_count, edges_count);
-        end = MPI_Wtime();
-        printf("Matrix formatting time: %.4f\n", end - start);
+        graph = g.in;
+        in_degrees = g.in_degrees;
+        out_degrees = g.out_degrees;
+        leaves = g.leaves;
+        leaves_count = g.leaves_count;
+        nodes_count = g.nodes_count;
     }
 
     measure_time_custom_matrix_in_mpi(graph, in_degrees, out_degrees,
@@ -78,13 +80,14 @@ void measure_time_custom_matrix_in_mpi(int ** graph, int * in_degrees, int * out
     MPI_Bcast(leaves, leaves_count, MPI_INT, MASTER, MPI_COMM_WORLD);
     
     // divide word and broadcast the graph
-    int * counts_send_graph = (int *) calloc(world_size, sizeof(int));
-    int * displacements_graph = (int *) calloc(world_size, sizeof(int));
+    long long * counts_send_graph = (long long *) calloc(world_size, sizeof(long long));
+    long long * displacements_graph = (long long *) calloc(world_size, sizeof(long long));
     int * counts_send_nodes = (int *) malloc(world_size * sizeof(int));
     int * displacements_nodes = (int *) malloc(world_size * sizeof(int));
 
     // divide nodes
-    int init_node, end_node, nodes, cdf_graph = 0, cdf_nodes = 0;
+    int init_node, end_node, nodes, cdf_nodes = 0;
+    long long cdf_graph = 0;
     for (int i = 0; i < world_size; i++) {
         init_node = i * nodes_count / world_size;
         end_node = (i + 1) * nodes_count / world_size;
@@ -97,7 +100,7 @@ void measure_time_custom_matrix_in_mpi(int ** graph, int * in_degrees, int * out
 
         // set values for the graph
         if (my_id == MASTER) {
-            int node_total = 0;
+            long long node_total = 0;
             for (int node = init_node; node < end_node; node++)
                 node_total += in_degrees[node];
 
@@ -107,26 +110,26 @@ void measure_time_custom_matrix_in_mpi(int ** graph, int * in_degrees, int * out
         }
     }
 
-    MPI_Bcast(counts_send_graph, world_size, MPI_INT, MASTER, MPI_COMM_WORLD);
-    MPI_Bcast(displacements_graph, world_size, MPI_INT, MASTER, MPI_COMM_WORLD);
+    MPI_Bcast(counts_send_graph, world_size, MPI_LONG_LONG, MASTER, MPI_COMM_WORLD);
+    MPI_Bcast(displacements_graph, world_size, MPI_LONG_LONG, MASTER, MPI_COMM_WORLD);
 
     // scatter only the needed part of the graph
     int * my_graph_contiguous = (int *) malloc(counts_send_graph[my_id] * sizeof(int));
     int * my_in_degrees = (int *) malloc(counts_send_nodes[my_id] * sizeof(int));
     if (my_id != MASTER)
         out_degrees = (int *) malloc(nodes_count * sizeof(int));
-    for (int i = 0; i < counts_send_graph[my_id]; i++)
+    for (long long i = 0; i < counts_send_graph[my_id]; i++)
         my_graph_contiguous[i] = 1;
 
     int my_nodes = counts_send_nodes[my_id];
-    MPI_Scatterv(&graph[0][0], counts_send_graph, displacements_graph, MPI_INT, 
-            my_graph_contiguous, counts_send_graph[my_id], MPI_INT, MASTER, MPI_COMM_WORLD);
+    scatter_graph(my_id == MASTER ? graph[0] : NULL, counts_send_graph, displacements_graph,
+            my_graph_contiguous, my_id, world_size);
     MPI_Bcast(out_degrees, nodes_count, MPI_INT, MASTER, MPI_COMM_WORLD);
     MPI_Scatterv(&in_degrees[0], counts_send_nodes, displacements_nodes, MPI_INT,
             my_in_degrees, my_nodes, MPI_INT, MASTER, MPI_COMM_WORLD);
 
     int ** my_graph = (int **) malloc(counts_send_nodes[my_id] * sizeof(int*));
-    int cdf = 0;
+    edge_t cdf = 0;
     for (int i = 0; i < my_nodes; i++) {
         my_graph[i] = &my_graph_contiguous[cdf];
         cdf += my_in_degrees[i];
@@ -151,4 +154,46 @@ void measure_time_custom_matrix_in_mpi(int ** graph, int * in_degrees, int * out
     }
     free(my_graph_contiguous);
     free(my_graph);
+    free(counts_send_graph);
+    free(displacements_graph);
+}
+
+void scatter_graph(int * graph, long long * counts, long long * displacements, int * my_graph,
+                int my_id, int world_size) {
+    /*
+     * sends every process its slice of the in-lists. MPI counts are ints, so when the graph
+     * has more than INT_MAX edges the slices are sent point to point in SCATTER_CHUNK pieces
+     */
+    long long total = displacements[world_size - 1] + counts[world_size - 1];
+    if (total <= INT_MAX) {
+        int * counts_int = (int *) malloc(world_size * sizeof(int));
+        int * displacements_int = (int *) malloc(world_size * sizeof(int));
+        for (int i = 0; i < world_size; i++) {
+            counts_int[i] = (int) counts[i];
+            displacements_int[i] = (int) displacements[i];
+        }
+        MPI_Scatterv(graph, counts_int, displacements_int, MPI_INT,
+                my_graph, counts_int[my_id], MPI_INT, MASTER, MPI_COMM_WORLD);
+        free(counts_int);
+        free(displacements_int);
+        return;
+    }
+
+    if (my_id != MASTER) {
+        for (long long done = 0; done < counts[my_id]; done += SCATTER_CHUNK) {
+            long long chunk = counts[my_id] - done < SCATTER_CHUNK ? counts[my_id] - done : SCATTER_CHUNK;
+            MPI_Recv(my_graph + done, (int) chunk, MPI_INT, MASTER, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+        return;
+    }
+
+    memcpy(my_graph, graph + displacements[MASTER], counts[MASTER] * sizeof(int));
+    for (int p = 0; p < world_size; p++) {
+        if (p == MASTER)
+            continue;
+        for (long long done = 0; done < counts[p]; done += SCATTER_CHUNK) {
+            long long chunk = counts[p] - done < SCATTER_CHUNK ? counts[p] - done : SCATTER_CHUNK;
+            MPI_Send(graph + displacements[p] + done, (int) chunk, MPI_INT, p, 0, MPI_COMM_WORLD);
+        }
+    }
 }
\ No newline at end of file
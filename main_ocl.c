@@ -2,124 +2,168 @@
 #include <stdlib.h>
 #include <omp.h>
 #include <stdbool.h>
-#include "readers/custom_matrix.h"
-#include "readers/mtx_sparse.h"
-#include "readers/mtx_hybrid.h"
+#include "readers/graph_store.h"
 #include "pagerank_implementations/pagerank_custom.h"
 #include "pagerank_implementations/pagerank_OCL.h"
 #include "helpers/file_helper.h"
+#include "helpers/helper.h"
+
+#define ENGINES_COUNT 12
+const char * engine_names[ENGINES_COUNT] = {"custom_simple", "custom", "custom_expanded",
+            "csr_scalar", "csr_vector", "ell", "jds", "sell", "hyb", "bcsr", "custom_adaptive",
+            "custom_extrapolated"};
+// ELL pads every row to the longest row of the matrix, only run it when requested
+#define DEFAULT_ENGINES "custom_simple,custom,custom_expanded,csr_scalar,csr_vector,jds,sell,hyb,bcsr,custom_adaptive,custom_extrapolated"
 
 
 int main(int argc, char* argv[]) {
 
-    if (argc != 3) {
-        printf("Usage: ./a.out <graph_file_name> <out_file_name>\n");
+    bool engines[ENGINES_COUNT];
+    if (argc < 3 || argc > 4 || parse_engines(argc == 4 ? argv[3] : NULL, DEFAULT_ENGINES,
+                engine_names, ENGINES_COUNT, engines)) {
+        printf("Usage: ./a.out <graph_file_name> <out_file_name> [--engines=name1,name2,...]\n");
         exit(1);
     }
 
     double timer, start_gl, end_gl;
 
-    // compute pagerank with OCL
+    // read the graph once, the matrix formats are derived from it when first needed
     timer = omp_get_wtime();
-    int nodes_count, edges_count, i;
-    int ** edges;
-    int * out_degrees;
-    int * in_degrees;
-    if (read_edges(argv[1], &edges, &out_degrees, &in_degrees, &nodes_count, &edges_count)) {
+    struct graph_store g;
+    if (graph_store_load(&g, argv[1])) {
         printf("Could not create custom format.\n");
         exit(1);
     }
-    printf("Read edges.\n");
-    int ** graph;
-    int * leaves;
-    int leaves_count;
-    format_graph_in(edges, in_degrees, out_degrees, &leaves_count, &leaves, &graph, nodes_count, edges_count);
     timer = omp_get_wtime() - timer;
     printf("Custom format read time: %f.\n", timer);
-    
-    timer = omp_get_wtime();
-    mtx_CSR mCSR;
-    if (get_CSR_from_file(&mCSR, argv[1]) != 0) {
-        printf("Could not create CSR.\n");
-        exit(1);
+
+    char * kernels[3] = {"pagerank_step_simple", "pagerank_step", "pagerank_step_expanded"};
+    for (int k = 0; k < 3; k++) {
+        if (!engines[k])
+            continue;
+        timer = omp_get_wtime(); 
+        float * custom_pagerank = pagerank_custom_in_ocl(g.in, g.in_degrees, g.out_degrees, g.leaves_count, g.leaves, 
+                    g.nodes_count, g.edges_count, EPSILON, &start_gl, &end_gl, kernels[k], EXTRAP_NONE);
+        timer = omp_get_wtime() - timer;
+        printf("Custom kernel %d total time: %f.\n", k + 1, timer);
+        free(custom_pagerank);
     }
-    timer = omp_get_wtime() - timer;
-    printf("CSR matrix read time: %f.\n", timer);
-    
-    /*timer = omp_get_wtime();
-    mtx_ELL mELL;
-    if (get_ELL_from_file(&mELL, argv[1]) != 0) {
-        printf("Could not create ELL.\n");
-        exit(1);
+
+    if (engines[3] || engines[4]) {
+        mtx_CSR * mCSR = graph_store_csr(&g);
+        if (mCSR == NULL) {
+            printf("Could not create CSR.\n");
+            exit(1);
+        }
+
+        if (engines[3]) {
+            timer = omp_get_wtime(); 
+            float * csr_sca_pagerank = pagerank_CSR_scalar(*mCSR);
+            timer = omp_get_wtime() - timer;
+            printf("CSR scalar OCL total time: %f.\n", timer);
+            free(csr_sca_pagerank);
+        }
+
+        if (engines[4]) {
+            timer = omp_get_wtime(); 
+            float * csr_vec_pagerank = pagerank_CSR_vector(*mCSR);
+            timer = omp_get_wtime() - timer;
+            printf("CSR vector OCL total time: %f.\n", timer);
+            free(csr_vec_pagerank);
+        }
     }
-    timer = omp_get_wtime() - timer;
-    printf("ELL matrix read time: %f.\n", timer);
-
-    timer = omp_get_wtime();    
-    mtx_JDS mJDS;
-    int * dangling;
-    int num_pieces = 3; // if number is too low (<=25), can return wrong answer instead of OOM error
-    if (get_JDS_from_file(&mJDS, &dangling, &num_pieces, argv[1]) != 0) {
-        printf("Could not create JDS.\n");
-        exit(1);
+
+    if (engines[5]) {
+        mtx_ELL * mELL = graph_store_ell(&g);
+        if (mELL == NULL) {
+            printf("Could not create ELL.\n");
+            exit(1);
+        }
+        timer = omp_get_wtime(); 
+        float * ell_pagerank = pagerank_ELL(*mELL);
+        timer = omp_get_wtime() - timer;
+        printf("ELL OCL total time: %f.\n", timer);
+        free(ell_pagerank);
     }
-    timer = omp_get_wtime() - timer;
-    printf("JDS matrix read time: %f.\n", timer);*/
 
+    if (engines[6]) {
+        // pieces are chosen from the row lengths to fit the device
+        cl_ulong global_mem_size, max_alloc_size;
+        if (ocl_device_memory(&global_mem_size, &max_alloc_size))
+            exit(1);
+        mtx_JDS * mJDS = graph_store_jds(&g, JDS_MAX_PIECES, (long long) (JDS_MEMORY_FRACTION * global_mem_size),
+                    (long long) max_alloc_size);
+        if (mJDS == NULL) {
+            printf("Could not create JDS.\n");
+            exit(1);
+        }
+        timer = omp_get_wtime(); 
+        float * jds_pagerank = pagerank_JDS(*mJDS, &g.jds_dangling);
+        timer = omp_get_wtime() - timer;
+        printf("JDS OCL total time: %f.\n", timer);
+        free(jds_pagerank);
+    }
 
-    char kernel1[] = "pagerank_step_simple";
-    char kernel2[] = "pagerank_step";
-    char kernel3[] = "pagerank_step_expanded";
-    
-    timer = omp_get_wtime(); 
-    float * custom_pagerank1 = pagerank_custom_in_ocl(graph, in_degrees, out_degrees, leaves_count, leaves, 
-                nodes_count, edges_count, EPSILON, &start_gl, &end_gl, kernel1);
-    timer = omp_get_wtime() - timer;
-    printf("Custom kernel 1 total time: %f.\n", timer);
+    if (engines[7]) {
+        mtx_SELL * mSELL = graph_store_sell(&g);
+        if (mSELL == NULL) {
+            printf("Could not create SELL.\n");
+            exit(1);
+        }
+        timer = omp_get_wtime(); 
+        float * sell_pagerank = pagerank_SELL(*mSELL);
+        timer = omp_get_wtime() - timer;
+        printf("SELL OCL total time: %f.\n", timer);
+        free(sell_pagerank);
+    }
 
-    timer = omp_get_wtime(); 
-    float * custom_pagerank2 = pagerank_custom_in_ocl(graph, in_degrees, out_degrees, leaves_count, leaves, 
-                nodes_count, edges_count, EPSILON, &start_gl, &end_gl, kernel2);
-    timer = omp_get_wtime() - timer;
-    printf("Custom kernel 2 total time: %f.\n", timer);
+    if (engines[8]) {
+        mtx_HYB * mHYB = graph_store_hyb(&g);
+        if (mHYB == NULL) {
+            printf("Could not create HYB.\n");
+            exit(1);
+        }
+        timer = omp_get_wtime();
+        float * hyb_pagerank = pagerank_HYB(*mHYB);
+        timer = omp_get_wtime() - timer;
+        printf("HYB OCL total time: %f.\n", timer);
+        free(hyb_pagerank);
+    }
 
-    timer = omp_get_wtime(); 
-    float * custom_pagerank3 = pagerank_custom_in_ocl(graph, in_degrees, out_degrees, leaves_count, leaves, 
-                nodes_count, edges_count, EPSILON, &start_gl, &end_gl, kernel3);
-    timer = omp_get_wtime() - timer;
-    printf("Custom kernel 3 total time: %f.\n", timer);
+    if (engines[9]) {
+        mtx_BCSR * mBCSR = graph_store_bcsr(&g);
+        if (mBCSR == NULL) {
+            printf("Could not create BCSR.\n");
+            exit(1);
+        }
+        timer = omp_get_wtime();
+        float * bcsr_pagerank = pagerank_BCSR(*mBCSR);
+        timer = omp_get_wtime() - timer;
+        printf("BCSR OCL total time: %f.\n", timer);
+        free(bcsr_pagerank);
+    }
 
-    timer = omp_get_wtime(); 
-    float * csr_sca_pagerank = pagerank_CSR_scalar(mCSR);
-    timer = omp_get_wtime() - timer;
-    printf("CSR scalar OCL total time: %f.\n", timer);
-    
-    timer = omp_get_wtime(); 
-    float * csr_vec_pagerank = pagerank_CSR_vector(mCSR);
-    timer = omp_get_wtime() - timer;
-    printf("CSR vector OCL total time: %f.\n", timer);
+    if (engines[10]) {
+        timer = omp_get_wtime();
+        float * adaptive_pagerank = pagerank_custom_in_ocl_adaptive(g.in, g.in_degrees, g.out_degrees, g.leaves_count,
+                    g.leaves, g.nodes_count, EPSILON, &start_gl, &end_gl);
+        timer = omp_get_wtime() - timer;
+        printf("Custom adaptive OCL total time: %f.\n", timer);
+        free(adaptive_pagerank);
+    }
 
-    /*timer = omp_get_wtime(); 
-    float * ell_pagerank = pagerank_ELL(mELL);
-    timer = omp_get_wtime() - timer;
-    printf("ELL OCL total time: %f.\n", timer);
+    if (engines[11]) {
+        timer = omp_get_wtime();
+        float * extrapolated_pagerank = pagerank_custom_in_ocl(g.in, g.in_degrees, g.out_degrees, g.leaves_count,
+                    g.leaves, g.nodes_count, g.edges_count, EPSILON, &start_gl, &end_gl, "pagerank_step",
+                    EXTRAPOLATION);
+        timer = omp_get_wtime() - timer;
+        printf("Custom extrapolated OCL total time: %f.\n", timer);
+        free(extrapolated_pagerank);
+    }
 
-    timer = omp_get_wtime(); 
-    float * jds_pagerank = pagerank_JDS(mJDS, &dangling);
-    timer = omp_get_wtime() - timer;
-    printf("JDS OCL total time: %f.\n", timer);*/
-    
-
-    // compare the obtained pageranks
-    // compare_vectors_detailed(ref_pagerank, csr_sca_pagerank, nodes_count);
-    // compare_vectors_detailed(ref_pagerank, csr_vec_pagerank, nodes_count);
-    // compare_vectors_detailed(ref_pagerank, ell_pagerank, nodes_count);
-    // compare_vectors_detailed(ref_pagerank, jds_pagerank, nodes_count);
-    
     // free data
-    mtx_CSR_free(&mCSR);
-    //mtx_ELL_free(&mELL);
-    //mtx_JDS_free(&mJDS);
+    graph_store_free(&g);
 
     return 0;
 }
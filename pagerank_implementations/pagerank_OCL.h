@@ -7,6 +7,60 @@
 #include "../helpers/helper.h"
 
 
+/*
+ * PATTERN_ONLY: the matrices store no values, so before every product `scaleRank` writes
+ * pagerank[j] / out_degree[j] into `scaled_d` and the matrix kernels read it instead of the
+ * pagerank vector. `scaled_d` has num_cols + 1 entries, padding elements read the last one (0)
+ */
+struct rank_scaling {
+    cl_kernel kernel;
+    cl_mem col_scale_d;
+    cl_mem scaled_d;
+    size_t global_item_size;
+    size_t local_item_size;
+};
+
+void rank_scaling_init(struct rank_scaling * scaling, cl_context context, cl_command_queue command_queue,
+                       cl_program program, float * col_scale, int num_cols) {
+    cl_int clStatus, status = CL_SUCCESS;
+    float zero = 0;
+    scaling->col_scale_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    num_cols * sizeof(cl_float), col_scale, &clStatus);
+    status |= clStatus;
+    scaling->scaled_d = clCreateBuffer(context, CL_MEM_READ_WRITE, (num_cols + 1) * sizeof(cl_float), NULL, &clStatus);
+    status |= clStatus;
+    status |= clEnqueueWriteBuffer(command_queue, scaling->scaled_d, CL_TRUE, num_cols * sizeof(cl_float),
+                                    sizeof(cl_float), &zero, 0, NULL, NULL);
+
+    scaling->kernel = clCreateKernel(program, "scaleRank", &clStatus);
+    status |= clStatus;
+    status |= clSetKernelArg(scaling->kernel, 1, sizeof(cl_mem), (void *)&scaling->col_scale_d);
+    status |= clSetKernelArg(scaling->kernel, 2, sizeof(cl_mem), (void *)&scaling->scaled_d);
+    status |= clSetKernelArg(scaling->kernel, 3, sizeof(cl_int), (void *)&num_cols);
+    check_status(status, "preparing the pattern-only scaling");
+
+    scaling->local_item_size = WORKGROUP_SIZE;
+    scaling->global_item_size = ((num_cols - 1) / WORKGROUP_SIZE + 1) * WORKGROUP_SIZE;
+}
+
+cl_int rank_scaling_run(struct rank_scaling * scaling, cl_command_queue command_queue, cl_mem vin,
+                        cl_kernel * kernels, int kernels_count, int vin_arg) {
+    // scales `vin` and passes the result as argument `vin_arg` of every kernel in `kernels`
+    cl_int clStatus = clSetKernelArg(scaling->kernel, 0, sizeof(cl_mem), (void *)&vin);
+    clStatus |= clEnqueueNDRangeKernel(command_queue, scaling->kernel, 1, NULL,
+                                    &scaling->global_item_size, &scaling->local_item_size, 0, NULL, NULL);
+    for (int k = 0; k < kernels_count; k++)
+        clStatus |= clSetKernelArg(kernels[k], vin_arg, sizeof(cl_mem), (void *)&scaling->scaled_d);
+    return clStatus;
+}
+
+void rank_scaling_release(struct rank_scaling * scaling) {
+    clReleaseKernel(scaling->kernel);
+    clReleaseMemObject(scaling->col_scale_d);
+    clReleaseMemObject(scaling->scaled_d);
+}
+
+
 float * pagerank_CSR_vector(mtx_CSR mCSR) {
     double start, end;
     cl_command_queue command_queue;
@@ -42,17 +96,20 @@ float * pagerank_CSR_vector(mtx_CSR mCSR) {
 
     // allocate CSR memory on device and transfer data from host CSR
     cl_mem mCSRrowptr_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
-                                   (mCSR.num_rows + 1) * sizeof(cl_int), NULL, &clStatus);
+                                   (mCSR.num_rows + 1) * sizeof(edge_t), NULL, &clStatus);
     cl_mem mCSRcol_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
                                     mCSR.num_nonzeros * sizeof(cl_int), NULL, &clStatus);
-    cl_mem mCSRdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
-                                    mCSR.num_nonzeros * sizeof(cl_float), NULL, &clStatus);
     clStatus = clEnqueueWriteBuffer(command_queue, mCSRrowptr_d, CL_TRUE, 0,
-                                   (mCSR.num_rows + 1) * sizeof(cl_int), mCSR.rowptr, 0, NULL, NULL);				
+                                   (mCSR.num_rows + 1) * sizeof(edge_t), mCSR.rowptr, 0, NULL, NULL);				
     clStatus = clEnqueueWriteBuffer(command_queue, mCSRcol_d, CL_TRUE, 0,	
                                     mCSR.num_nonzeros * sizeof(cl_int), mCSR.col, 0, NULL, NULL);				
-    clStatus = clEnqueueWriteBuffer(command_queue, mCSRdata_d, CL_TRUE, 0,
+    cl_mem mCSRdata_d = NULL; // no values with PATTERN_ONLY
+    if(!PATTERN_ONLY) {
+        mCSRdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
+                                    mCSR.num_nonzeros * sizeof(cl_float), NULL, &clStatus);
+        clStatus = clEnqueueWriteBuffer(command_queue, mCSRdata_d, CL_TRUE, 0,
                                     mCSR.num_nonzeros * sizeof(cl_float), mCSR.data, 0, NULL, NULL);
+    }
 
     /*
      * CREATE KERNELS
@@ -79,6 +136,10 @@ float * pagerank_CSR_vector(mtx_CSR mCSR) {
     clStatus |=	clSetKernelArg(kernelCSR_multh, 5, WORKGROUP_SIZE*sizeof(cl_float), NULL);
 	clStatus |= clSetKernelArg(kernelCSR_multh, 6, sizeof(cl_int), (void *)&(mCSR.num_rows));
 
+    struct rank_scaling scaling;
+    if(PATTERN_ONLY)
+        rank_scaling_init(&scaling, context, command_queue, program, mCSR.col_scale, mCSR.num_cols);
+
     /*
      * LAUNCH COMPUTATION
      */
@@ -108,6 +169,8 @@ float * pagerank_CSR_vector(mtx_CSR mCSR) {
             clStatus |= clSetKernelArg(kernelCSR_multh, 4, sizeof(cl_mem), (void *)&vecIn_d);
             clStatus |= clSetKernelArg(fixPROutput, 0, sizeof(cl_mem), (void *)&vecIn_d);
         }
+        if(PATTERN_ONLY)
+            clStatus |= rank_scaling_run(&scaling, command_queue, iterations % 2 == 0 ? vecIn_d : vecOut_d, &kernelCSR_multh, 1, 3);
 
         clStatus |= clEnqueueNDRangeKernel(command_queue, kernelCSR_multh, 1, NULL,						
                                         &global_item_size_CSRpar, &local_item_size, 0, NULL, NULL);
@@ -164,12 +227,15 @@ float * pagerank_CSR_vector(mtx_CSR mCSR) {
     clStatus = clReleaseKernel(fixPROutput);
     clStatus = clReleaseKernel(normDiff);
     clStatus = clReleaseKernel(kernelCSR_multh);
+    if(PATTERN_ONLY)
+        rank_scaling_release(&scaling);
 
     clStatus = clReleaseMemObject(vecIn_d);
     clStatus = clReleaseMemObject(vecOut_d);
     clStatus = clReleaseMemObject(mCSRrowptr_d);
     clStatus = clReleaseMemObject(mCSRcol_d);
-    clStatus = clReleaseMemObject(mCSRdata_d);
+    if(!PATTERN_ONLY)
+        clStatus = clReleaseMemObject(mCSRdata_d);
     clStatus = clReleaseMemObject(norm_diff_d);
     
     ocl_destroy(command_queue, context, program);
@@ -213,17 +279,20 @@ float * pagerank_CSR_scalar(mtx_CSR mCSR) {
 
     // allocate CSR memory on device and transfer data from host CSR
     cl_mem mCSRrowptr_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
-                                   (mCSR.num_rows + 1) * sizeof(cl_int), NULL, &clStatus);
+                                   (mCSR.num_rows + 1) * sizeof(edge_t), NULL, &clStatus);
     cl_mem mCSRcol_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
                                     mCSR.num_nonzeros * sizeof(cl_int), NULL, &clStatus);
-    cl_mem mCSRdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
-                                    mCSR.num_nonzeros * sizeof(cl_float), NULL, &clStatus);
     clStatus = clEnqueueWriteBuffer(command_queue, mCSRrowptr_d, CL_TRUE, 0,
-                                   (mCSR.num_rows + 1) * sizeof(cl_int), mCSR.rowptr, 0, NULL, NULL);				
+                                   (mCSR.num_rows + 1) * sizeof(edge_t), mCSR.rowptr, 0, NULL, NULL);				
     clStatus = clEnqueueWriteBuffer(command_queue, mCSRcol_d, CL_TRUE, 0,	
                                     mCSR.num_nonzeros * sizeof(cl_int), mCSR.col, 0, NULL, NULL);				
-    clStatus = clEnqueueWriteBuffer(command_queue, mCSRdata_d, CL_TRUE, 0,
+    cl_mem mCSRdata_d = NULL; // no values with PATTERN_ONLY
+    if(!PATTERN_ONLY) {
+        mCSRdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
+                                    mCSR.num_nonzeros * sizeof(cl_float), NULL, &clStatus);
+        clStatus = clEnqueueWriteBuffer(command_queue, mCSRdata_d, CL_TRUE, 0,
                                     mCSR.num_nonzeros * sizeof(cl_float), mCSR.data, 0, NULL, NULL);
+    }
 
     /*
      * CREATE KERNELS
@@ -249,6 +318,10 @@ float * pagerank_CSR_scalar(mtx_CSR mCSR) {
     clStatus |= clSetKernelArg(kernelCSR_basic, 4, sizeof(cl_mem), (void *)&vecOut_d);
 	clStatus |= clSetKernelArg(kernelCSR_basic, 5, sizeof(cl_int), (void *)&(mCSR.num_rows));
 
+    struct rank_scaling scaling;
+    if(PATTERN_ONLY)
+        rank_scaling_init(&scaling, context, command_queue, program, mCSR.col_scale, mCSR.num_cols);
+
     /*
      * LAUNCH COMPUTATION
      */
@@ -276,6 +349,8 @@ float * pagerank_CSR_scalar(mtx_CSR mCSR) {
             clStatus |= clSetKernelArg(kernelCSR_basic, 4, sizeof(cl_mem), (void *)&vecIn_d);
             clStatus |= clSetKernelArg(fixPROutput, 0, sizeof(cl_mem), (void *)&vecIn_d);
         }
+        if(PATTERN_ONLY)
+            clStatus |= rank_scaling_run(&scaling, command_queue, iterations % 2 == 0 ? vecIn_d : vecOut_d, &kernelCSR_basic, 1, 3);
 
         clStatus |= clEnqueueNDRangeKernel(command_queue, kernelCSR_basic, 1, NULL,						
                                         &global_item_size_CSR, &local_item_size, 0, NULL, NULL);
@@ -314,6 +389,7 @@ float * pagerank_CSR_scalar(mtx_CSR mCSR) {
     printf("Total number of iterations: %d\n", iterations);
     printf("CSR scalar average time per iteration: %f\n", (end - start) / iterations);
     printf("CSR scalar OCL total computation: %f\n", end - start);
+    printf("CSR scalar matrix bandwidth: %.2f GB/s\n", mtx_CSR_bytes(&mCSR) * iterations / (end - start) / 1e9);
 
     if(iterations % 2 == 0)
         clStatus |= clEnqueueReadBuffer(command_queue, vecOut_d, CL_TRUE, 0,						
@@ -332,12 +408,15 @@ float * pagerank_CSR_scalar(mtx_CSR mCSR) {
     clStatus = clReleaseKernel(fixPROutput);
     clStatus = clReleaseKernel(normDiff);
     clStatus = clReleaseKernel(kernelCSR_basic);
+    if(PATTERN_ONLY)
+        rank_scaling_release(&scaling);
 
     clStatus = clReleaseMemObject(vecIn_d);
     clStatus = clReleaseMemObject(vecOut_d);
     clStatus = clReleaseMemObject(mCSRrowptr_d);
     clStatus = clReleaseMemObject(mCSRcol_d);
-    clStatus = clReleaseMemObject(mCSRdata_d);
+    if(!PATTERN_ONLY)
+        clStatus = clReleaseMemObject(mCSRdata_d);
     clStatus = clReleaseMemObject(norm_diff_d);
     
     ocl_destroy(command_queue, context, program);
@@ -381,12 +460,15 @@ float * pagerank_ELL(mtx_ELL mELL) {
     // allocate memory on device and transfer data from host ELL
     cl_mem mELLcol_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
                                     mELL.num_elements * sizeof(cl_int), NULL, &clStatus);
-    cl_mem mELLdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
-                                    mELL.num_elements * sizeof(cl_float), NULL, &clStatus);
     clStatus = clEnqueueWriteBuffer(command_queue, mELLcol_d, CL_TRUE, 0,						
                                     mELL.num_elements * sizeof(cl_int), mELL.col, 0, NULL, NULL);				
-    clStatus = clEnqueueWriteBuffer(command_queue, mELLdata_d, CL_TRUE, 0,						
+    cl_mem mELLdata_d = NULL; // no values with PATTERN_ONLY
+    if(!PATTERN_ONLY) {
+        mELLdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY, 
+                                    mELL.num_elements * sizeof(cl_float), NULL, &clStatus);
+        clStatus = clEnqueueWriteBuffer(command_queue, mELLdata_d, CL_TRUE, 0,						
                                     mELL.num_elements * sizeof(cl_float), mELL.data, 0, NULL, NULL);
+    }
 
     /*
      * CREATE KERNELS
@@ -412,6 +494,10 @@ float * pagerank_ELL(mtx_ELL mELL) {
 	clStatus |= clSetKernelArg(kernelELL, 4, sizeof(cl_int), (void *)&(mELL.num_rows));
 	clStatus |= clSetKernelArg(kernelELL, 5, sizeof(cl_int), (void *)&(mELL.num_elementsinrow));
 
+    struct rank_scaling scaling;
+    if(PATTERN_ONLY)
+        rank_scaling_init(&scaling, context, command_queue, program, mELL.col_scale, mELL.num_cols);
+
 
     /*
      * LAUNCH COMPUTATION
@@ -441,6 +527,8 @@ float * pagerank_ELL(mtx_ELL mELL) {
             clStatus |= clSetKernelArg(kernelELL, 3, sizeof(cl_mem), (void *)&vecIn_d);
             clStatus |= clSetKernelArg(fixPROutput, 0, sizeof(cl_mem), (void *)&vecIn_d);
         }
+        if(PATTERN_ONLY)
+            clStatus |= rank_scaling_run(&scaling, command_queue, iterations % 2 == 0 ? vecIn_d : vecOut_d, &kernelELL, 1, 2);
 
         clStatus |= clEnqueueNDRangeKernel(command_queue, kernelELL, 1, NULL,						
                                         &global_item_size_ELL, &local_item_size, 0, NULL, NULL);
@@ -502,11 +590,14 @@ float * pagerank_ELL(mtx_ELL mELL) {
     clStatus = clReleaseKernel(fixPROutput);
     clStatus = clReleaseKernel(normDiff);
     clStatus = clReleaseKernel(kernelELL);
+    if(PATTERN_ONLY)
+        rank_scaling_release(&scaling);
 
     clStatus = clReleaseMemObject(vecIn_d);
     clStatus = clReleaseMemObject(vecOut_d);
     clStatus = clReleaseMemObject(mELLcol_d);
-    clStatus = clReleaseMemObject(mELLdata_d);
+    if(!PATTERN_ONLY)
+        clStatus = clReleaseMemObject(mELLdata_d);
     clStatus = clReleaseMemObject(norm_diff_d);
     
     ocl_destroy(command_queue, context, program);
@@ -559,13 +650,16 @@ float * pagerank_JDS(mtx_JDS mJDS, int ** dangling) {
     for(int p = 0; p < mJDS.num_pieces; p++) {
         mJDScol_d[p] = clCreateBuffer(context, CL_MEM_READ_ONLY, 
                                     mJDS.pieces[p]->num_elements * sizeof(cl_int), NULL, &clStatus);
-        mJDSdata_d[p] = clCreateBuffer(context, CL_MEM_READ_ONLY, 
+        mJDSdata_d[p] = NULL; // no values with PATTERN_ONLY
+        if(!PATTERN_ONLY)
+            mJDSdata_d[p] = clCreateBuffer(context, CL_MEM_READ_ONLY, 
                                     mJDS.pieces[p]->num_elements * sizeof(cl_float), NULL, &clStatus);
         mJDSrow_d[p] = clCreateBuffer(context, CL_MEM_READ_ONLY,
                                     mJDS.pieces[p]->num_rows * sizeof(cl_int), NULL, &clStatus);
         clStatus = clEnqueueWriteBuffer(command_queue, mJDScol_d[p], CL_TRUE, 0,						
                                     mJDS.pieces[p]->num_elements * sizeof(cl_int),mJDS.pieces[p]->col, 0, NULL, NULL);				
-        clStatus = clEnqueueWriteBuffer(command_queue, mJDSdata_d[p], CL_TRUE, 0,						
+        if(!PATTERN_ONLY)
+            clStatus = clEnqueueWriteBuffer(command_queue, mJDSdata_d[p], CL_TRUE, 0,						
                                     mJDS.pieces[p]->num_elements * sizeof(cl_float), mJDS.pieces[p]->data, 0, NULL, NULL);
         clStatus = clEnqueueWriteBuffer(command_queue, mJDSrow_d[p], CL_TRUE, 0,						
                                     mJDS.pieces[p]->num_rows * sizeof(cl_int), mJDS.row_ind[p], 0, NULL, NULL);
@@ -615,6 +709,10 @@ float * pagerank_JDS(mtx_JDS mJDS, int ** dangling) {
     clStatus |= clSetKernelArg(nullifyDangling, 1, sizeof(cl_mem), (void *)&dangling_d);
     clStatus |= clSetKernelArg(nullifyDangling, 2, sizeof(cl_int), (void *)&(mJDS.num_cols));
 
+    struct rank_scaling scaling;
+    if(PATTERN_ONLY)
+        rank_scaling_init(&scaling, context, command_queue, program, mJDS.col_scale, mJDS.num_cols);
+
 
     /*
      * LAUNCH COMPUTATION
@@ -657,6 +755,9 @@ float * pagerank_JDS(mtx_JDS mJDS, int ** dangling) {
             clStatus |= clSetKernelArg(fixPROutput, 0, sizeof(cl_mem), (void *)&vecIn_d);
             clStatus |= clSetKernelArg(nullifyDangling, 0, sizeof(cl_mem), (void *)&vecIn_d);
         }
+        if(PATTERN_ONLY)
+            clStatus |= rank_scaling_run(&scaling, command_queue, iterations % 2 == 0 ? vecIn_d : vecOut_d,
+                                        kernelsJDS, mJDS.num_pieces, 3);
 
         for(int p = 0; p < mJDS.num_pieces; p++)
             clStatus |= clEnqueueNDRangeKernel(command_queue, kernelsJDS[p], 1, NULL,						
@@ -718,13 +819,16 @@ float * pagerank_JDS(mtx_JDS mJDS, int ** dangling) {
     clStatus = clReleaseKernel(normDiff);
     for(int p = 0; p < mJDS.num_pieces; p++)
         clStatus = clReleaseKernel(kernelsJDS[p]);
+    if(PATTERN_ONLY)
+        rank_scaling_release(&scaling);
 
     clStatus = clReleaseMemObject(vecIn_d);
     clStatus = clReleaseMemObject(vecOut_d);
     clStatus = clReleaseMemObject(norm_diff_d);
     for(int p = 0; p < mJDS.num_pieces; p++) {
         clStatus = clReleaseMemObject(mJDScol_d[p]);
-        clStatus = clReleaseMemObject(mJDSdata_d[p]);
+        if(!PATTERN_ONLY)
+            clStatus = clReleaseMemObject(mJDSdata_d[p]);
         clStatus = clReleaseMemObject(mJDSrow_d[p]);
     }
     
@@ -738,3 +842,552 @@ float * pagerank_JDS(mtx_JDS mJDS, int ** dangling) {
 
     return pagerank_out;
 }
+
+float * pagerank_SELL(mtx_SELL mSELL) {
+    double start, end;
+    cl_command_queue command_queue;
+    cl_context context;
+    cl_program program;
+
+    int clStatus = ocl_init("kernels/sparse_matrix.cl", &command_queue, &context, &program);
+    if (clStatus != 0) {
+        printf("Initialization failed. Exiting OCL computation.\n");
+        exit(1);
+    }
+
+    /*
+     * DATA ALLOCATION
+     */
+
+    // allocate pagerank vectors and compute initial values
+    float * pagerank_in  = (float*) malloc(mSELL.num_cols * sizeof(float));
+    float * pagerank_out = (float*) malloc(mSELL.num_cols * sizeof(float));
+    for (int i = 0; i < mSELL.num_cols; i++)
+        pagerank_in[i] = 1. / mSELL.num_cols;
+
+    cl_mem vecIn_d = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, 
+                                    mSELL.num_cols * sizeof(cl_float), pagerank_in, &clStatus);
+    cl_mem vecOut_d = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+                                    mSELL.num_cols * sizeof(cl_float), NULL, &clStatus);
+
+    // allocate float for norm
+    cl_mem norm_diff_d = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_float), NULL, &clStatus);
+    float zero = 0;
+    float norm;
+
+    // allocate memory on device and transfer data from host SELL
+    int slots = mSELL.num_chunks * mSELL.chunk_size;
+    cl_mem mSELLchunkptr_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (mSELL.num_chunks + 1) * sizeof(edge_t), mSELL.chunk_ptr, &clStatus);
+    cl_mem mSELLwidth_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    mSELL.num_chunks * sizeof(cl_int), mSELL.chunk_width, &clStatus);
+    cl_mem mSELLrow_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    slots * sizeof(cl_int), mSELL.row_ind, &clStatus);
+    cl_mem mSELLcol_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    mSELL.num_elements * sizeof(cl_int), mSELL.col, &clStatus);
+    cl_mem mSELLdata_d = NULL; // no values with PATTERN_ONLY
+    if(!PATTERN_ONLY)
+        mSELLdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    mSELL.num_elements * sizeof(cl_float), mSELL.data, &clStatus);
+
+    /*
+     * CREATE KERNELS
+     */
+
+    cl_kernel fixPROutput = clCreateKernel(program, "fixPROutput", &clStatus);
+    clStatus |= clSetKernelArg(fixPROutput, 1, sizeof(cl_int), (void *)&(mSELL.num_cols));
+
+    cl_kernel normDiff = clCreateKernel(program, "normDiff", &clStatus);
+    clStatus |= clSetKernelArg(normDiff, 2, sizeof(cl_int), (void *)&(mSELL.num_cols));
+    clStatus |= clSetKernelArg(normDiff, 3, WORKGROUP_SIZE*sizeof(cl_float), NULL);
+    clStatus |= clSetKernelArg(normDiff, 4, sizeof(cl_mem), (void *)&norm_diff_d);
+
+    // create kernel SELL and set arguments
+    cl_kernel kernelSELL = clCreateKernel(program, "mSELL", &clStatus);
+    clStatus |= clSetKernelArg(kernelSELL, 0, sizeof(cl_mem), (void *)&mSELLchunkptr_d);
+    clStatus |= clSetKernelArg(kernelSELL, 1, sizeof(cl_mem), (void *)&mSELLwidth_d);
+    clStatus |= clSetKernelArg(kernelSELL, 2, sizeof(cl_mem), (void *)&mSELLrow_d);
+    clStatus |= clSetKernelArg(kernelSELL, 3, sizeof(cl_mem), (void *)&mSELLcol_d);
+    clStatus |= clSetKernelArg(kernelSELL, 4, sizeof(cl_mem), (void *)&mSELLdata_d);
+    clStatus |= clSetKernelArg(kernelSELL, 7, sizeof(cl_int), (void *)&slots);
+    clStatus |= clSetKernelArg(kernelSELL, 8, sizeof(cl_int), (void *)&(mSELL.chunk_size));
+
+    struct rank_scaling scaling;
+    if(PATTERN_ONLY)
+        rank_scaling_init(&scaling, context, command_queue, program, mSELL.col_scale, mSELL.num_cols);
+
+    /*
+     * LAUNCH COMPUTATION
+     */
+
+    size_t local_item_size = WORKGROUP_SIZE;
+
+    // Divide work
+    int num_groups = (mSELL.num_cols - 1) / local_item_size + 1;
+    size_t global_item_size_helpers = num_groups * local_item_size;
+
+    num_groups = (slots - 1) / local_item_size + 1;
+    size_t global_item_size_SELL = num_groups * local_item_size;
+
+    // SELL write, execute, read
+    int iterations = 0;
+    cl_mem vec_current = vecIn_d, vec_next = vecOut_d;
+
+    start = omp_get_wtime();
+
+    while (1) {
+        clStatus |= clSetKernelArg(kernelSELL, 5, sizeof(cl_mem), (void *)&vec_current);
+        clStatus |= clSetKernelArg(kernelSELL, 6, sizeof(cl_mem), (void *)&vec_next);
+        clStatus |= clSetKernelArg(fixPROutput, 0, sizeof(cl_mem), (void *)&vec_next);
+        if(PATTERN_ONLY)
+            clStatus |= rank_scaling_run(&scaling, command_queue, vec_current, &kernelSELL, 1, 5);
+
+        clStatus |= clEnqueueNDRangeKernel(command_queue, kernelSELL, 1, NULL,						
+                                        &global_item_size_SELL, &local_item_size, 0, NULL, NULL);
+        clStatus |= clEnqueueNDRangeKernel(command_queue, fixPROutput, 1, NULL,						
+                                        &global_item_size_helpers, &local_item_size, 0, NULL, NULL);
+
+        iterations++;
+
+        // Check exit criteria
+        int done = MAX_ITER > 0 && iterations >= MAX_ITER;
+        if(!done && CHECK_CONVERGENCE) {
+            clStatus |= clSetKernelArg(normDiff, 0, sizeof(cl_mem), (void *)&vec_current);
+            clStatus |= clSetKernelArg(normDiff, 1, sizeof(cl_mem), (void *)&vec_next);
+            clStatus |= clEnqueueWriteBuffer(command_queue, norm_diff_d, CL_TRUE, 0,						
+                                        sizeof(cl_float), &zero, 0, NULL, NULL);
+            clStatus |= clEnqueueNDRangeKernel(command_queue, normDiff, 1, NULL,						
+                                        &global_item_size_helpers, &local_item_size, 0, NULL, NULL);
+            clStatus |= clEnqueueReadBuffer(command_queue, norm_diff_d, CL_TRUE, 0,						
+                                        sizeof(cl_float), &norm, 0, NULL, NULL);
+            done = sqrt(norm) <= EPSILON;
+        }
+
+        cl_mem tmp = vec_current;
+        vec_current = vec_next;
+        vec_next = tmp;
+        if(done)
+            break;
+    }
+    clFinish(command_queue);
+
+    end = omp_get_wtime();
+    printf("Total number of iterations: %d\n", iterations);
+    printf("SELL-%d-%d average time per iteration: %f\n", mSELL.chunk_size, mSELL.sigma, (end - start) / iterations);
+    printf("SELL-%d-%d OCL total computation: %f\n", mSELL.chunk_size, mSELL.sigma, end - start);
+
+    clStatus |= clEnqueueReadBuffer(command_queue, vec_current, CL_TRUE, 0,						
+                                    mSELL.num_cols*sizeof(cl_float), pagerank_out, 0, NULL, NULL);
+
+    // Normalize output
+    double sum = 0.;
+    for(int i = 0; i < mSELL.num_cols; i++)
+        sum += pagerank_out[i];
+    for(int i = 0; i < mSELL.num_cols; i++)
+        pagerank_out[i] /= sum;
+
+    // Free memory structures
+    clStatus = clReleaseKernel(fixPROutput);
+    clStatus = clReleaseKernel(normDiff);
+    clStatus = clReleaseKernel(kernelSELL);
+    if(PATTERN_ONLY)
+        rank_scaling_release(&scaling);
+
+    clStatus = clReleaseMemObject(vecIn_d);
+    clStatus = clReleaseMemObject(vecOut_d);
+    clStatus = clReleaseMemObject(mSELLchunkptr_d);
+    clStatus = clReleaseMemObject(mSELLwidth_d);
+    clStatus = clReleaseMemObject(mSELLrow_d);
+    clStatus = clReleaseMemObject(mSELLcol_d);
+    if(!PATTERN_ONLY)
+        clStatus = clReleaseMemObject(mSELLdata_d);
+    clStatus = clReleaseMemObject(norm_diff_d);
+
+    ocl_destroy(command_queue, context, program);
+    free(pagerank_in);
+    return pagerank_out;
+}
+
+float * pagerank_HYB(mtx_HYB mHYB) {
+    double start, end;
+    cl_command_queue command_queue;
+    cl_context context;
+    cl_program program;
+    mtx_ELL mELL = mHYB.ell;
+
+    int clStatus = ocl_init("kernels/sparse_matrix.cl", &command_queue, &context, &program);
+    if (clStatus != 0) {
+        printf("Initialization failed. Exiting OCL computation.\n");
+        exit(1);
+    }
+
+    /*
+     * DATA ALLOCATION
+     */
+
+    // allocate pagerank vectors and compute initial values
+    float * pagerank_in  = (float*) malloc(mELL.num_cols * sizeof(float));
+    float * pagerank_out = (float*) malloc(mELL.num_cols * sizeof(float));
+    for (int i = 0; i < mELL.num_cols; i++)
+        pagerank_in[i] = 1. / mELL.num_cols;
+
+    cl_mem vecIn_d = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, 
+                                    mELL.num_cols * sizeof(cl_float), pagerank_in, &clStatus);
+    cl_mem vecOut_d = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+                                    mELL.num_cols * sizeof(cl_float), NULL, &clStatus);
+
+    // allocate float for norm
+    cl_mem norm_diff_d = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_float), NULL, &clStatus);
+    float zero = 0;
+    float norm;
+
+    // allocate memory on device and transfer data from host HYB (empty parts get a 1-element buffer)
+    int coo_items = (mHYB.coo_nonzeros + HYB_COO_INTERVAL - 1) / HYB_COO_INTERVAL;
+    int carries = 2 * coo_items;
+    // mCOOtail writes the carries of every launched work item, including the ones past `coo_items`
+    int carry_slots = 2 * ((coo_items + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE) * WORKGROUP_SIZE;
+    int interval = HYB_COO_INTERVAL;
+    int rows = mELL.num_rows;
+    cl_mem mELLcol_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (mELL.num_elements > 0 ? mELL.num_elements : 1) * sizeof(cl_int), mELL.col, &clStatus);
+    cl_mem mCOOrow_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (mHYB.coo_nonzeros > 0 ? mHYB.coo_nonzeros : 1) * sizeof(cl_int), mHYB.coo_row, &clStatus);
+    cl_mem mCOOcol_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (mHYB.coo_nonzeros > 0 ? mHYB.coo_nonzeros : 1) * sizeof(cl_int), mHYB.coo_col, &clStatus);
+    cl_mem mELLdata_d = NULL, mCOOdata_d = NULL; // no values with PATTERN_ONLY
+    if(!PATTERN_ONLY) {
+        mELLdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (mELL.num_elements > 0 ? mELL.num_elements : 1) * sizeof(cl_float), mELL.data, &clStatus);
+        mCOOdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (mHYB.coo_nonzeros > 0 ? mHYB.coo_nonzeros : 1) * sizeof(cl_float), mHYB.coo_data, &clStatus);
+    }
+    cl_mem carryRow_d = clCreateBuffer(context, CL_MEM_READ_WRITE, (carry_slots > 0 ? carry_slots : 1) * sizeof(cl_int), NULL, &clStatus);
+    cl_mem carryVal_d = clCreateBuffer(context, CL_MEM_READ_WRITE, (carry_slots > 0 ? carry_slots : 1) * sizeof(cl_float), NULL, &clStatus);
+
+    /*
+     * CREATE KERNELS
+     */
+
+    cl_kernel fixPROutput = clCreateKernel(program, "fixPROutput", &clStatus);
+    clStatus |= clSetKernelArg(fixPROutput, 1, sizeof(cl_int), (void *)&(mELL.num_cols));
+
+    cl_kernel normDiff = clCreateKernel(program, "normDiff", &clStatus);
+    clStatus |= clSetKernelArg(normDiff, 2, sizeof(cl_int), (void *)&(mELL.num_cols));
+    clStatus |= clSetKernelArg(normDiff, 3, WORKGROUP_SIZE*sizeof(cl_float), NULL);
+    clStatus |= clSetKernelArg(normDiff, 4, sizeof(cl_mem), (void *)&norm_diff_d);
+
+    // ELL part writes every row, the COO part and its carries are added afterwards
+    cl_kernel kernelELL = clCreateKernel(program, "mELL", &clStatus);
+    clStatus |= clSetKernelArg(kernelELL, 0, sizeof(cl_mem), (void *)&mELLcol_d);
+    clStatus |= clSetKernelArg(kernelELL, 1, sizeof(cl_mem), (void *)&mELLdata_d);
+    clStatus |= clSetKernelArg(kernelELL, 4, sizeof(cl_int), (void *)&rows);
+    clStatus |= clSetKernelArg(kernelELL, 5, sizeof(cl_int), (void *)&(mELL.num_elementsinrow));
+
+    cl_kernel kernelCOO = clCreateKernel(program, "mCOOtail", &clStatus);
+    clStatus |= clSetKernelArg(kernelCOO, 0, sizeof(cl_mem), (void *)&mCOOrow_d);
+    clStatus |= clSetKernelArg(kernelCOO, 1, sizeof(cl_mem), (void *)&mCOOcol_d);
+    clStatus |= clSetKernelArg(kernelCOO, 2, sizeof(cl_mem), (void *)&mCOOdata_d);
+    clStatus |= clSetKernelArg(kernelCOO, 5, sizeof(cl_mem), (void *)&carryRow_d);
+    clStatus |= clSetKernelArg(kernelCOO, 6, sizeof(cl_mem), (void *)&carryVal_d);
+    clStatus |= clSetKernelArg(kernelCOO, 7, sizeof(edge_t), (void *)&(mHYB.coo_nonzeros));
+    clStatus |= clSetKernelArg(kernelCOO, 8, sizeof(cl_int), (void *)&interval);
+
+    cl_kernel kernelCarry = clCreateKernel(program, "mCOOcarry", &clStatus);
+    clStatus |= clSetKernelArg(kernelCarry, 0, sizeof(cl_mem), (void *)&carryRow_d);
+    clStatus |= clSetKernelArg(kernelCarry, 1, sizeof(cl_mem), (void *)&carryVal_d);
+    clStatus |= clSetKernelArg(kernelCarry, 3, sizeof(cl_int), (void *)&carries);
+
+    struct rank_scaling scaling;
+    if(PATTERN_ONLY)
+        rank_scaling_init(&scaling, context, command_queue, program, mHYB.col_scale, mELL.num_cols);
+
+    /*
+     * LAUNCH COMPUTATION
+     */
+
+    size_t local_item_size = WORKGROUP_SIZE;
+
+    // Divide work
+    int num_groups = (mELL.num_cols - 1) / local_item_size + 1;
+    size_t global_item_size_helpers = num_groups * local_item_size;
+
+    num_groups = (coo_items - 1) / local_item_size + 1;
+    size_t global_item_size_COO = num_groups * local_item_size;
+
+    num_groups = (carries - 1) / local_item_size + 1;
+    size_t global_item_size_carry = num_groups * local_item_size;
+
+    // HYB write, execute, read
+    int iterations = 0;
+    cl_mem vec_current = vecIn_d, vec_next = vecOut_d;
+
+    start = omp_get_wtime();
+
+    while (1) {
+        clStatus |= clSetKernelArg(kernelELL, 2, sizeof(cl_mem), (void *)&vec_current);
+        clStatus |= clSetKernelArg(kernelELL, 3, sizeof(cl_mem), (void *)&vec_next);
+        clStatus |= clSetKernelArg(kernelCOO, 3, sizeof(cl_mem), (void *)&vec_current);
+        clStatus |= clSetKernelArg(kernelCOO, 4, sizeof(cl_mem), (void *)&vec_next);
+        clStatus |= clSetKernelArg(kernelCarry, 2, sizeof(cl_mem), (void *)&vec_next);
+        clStatus |= clSetKernelArg(fixPROutput, 0, sizeof(cl_mem), (void *)&vec_next);
+        if(PATTERN_ONLY) {
+            clStatus |= rank_scaling_run(&scaling, command_queue, vec_current, &kernelELL, 1, 2);
+            clStatus |= clSetKernelArg(kernelCOO, 3, sizeof(cl_mem), (void *)&scaling.scaled_d);
+        }
+
+        clStatus |= clEnqueueNDRangeKernel(command_queue, kernelELL, 1, NULL,
+                                        &global_item_size_helpers, &local_item_size, 0, NULL, NULL);
+        if(coo_items > 0) {
+            clStatus |= clEnqueueNDRangeKernel(command_queue, kernelCOO, 1, NULL,
+                                        &global_item_size_COO, &local_item_size, 0, NULL, NULL);
+            clStatus |= clEnqueueNDRangeKernel(command_queue, kernelCarry, 1, NULL,
+                                        &global_item_size_carry, &local_item_size, 0, NULL, NULL);
+        }
+        clStatus |= clEnqueueNDRangeKernel(command_queue, fixPROutput, 1, NULL,
+                                        &global_item_size_helpers, &local_item_size, 0, NULL, NULL);
+
+        iterations++;
+
+        // Check exit criteria
+        int done = MAX_ITER > 0 && iterations >= MAX_ITER;
+        if(!done && CHECK_CONVERGENCE) {
+            clStatus |= clSetKernelArg(normDiff, 0, sizeof(cl_mem), (void *)&vec_current);
+            clStatus |= clSetKernelArg(normDiff, 1, sizeof(cl_mem), (void *)&vec_next);
+            clStatus |= clEnqueueWriteBuffer(command_queue, norm_diff_d, CL_TRUE, 0,
+                                        sizeof(cl_float), &zero, 0, NULL, NULL);
+            clStatus |= clEnqueueNDRangeKernel(command_queue, normDiff, 1, NULL,
+                                        &global_item_size_helpers, &local_item_size, 0, NULL, NULL);
+            clStatus |= clEnqueueReadBuffer(command_queue, norm_diff_d, CL_TRUE, 0,
+                                        sizeof(cl_float), &norm, 0, NULL, NULL);
+            done = sqrt(norm) <= EPSILON;
+        }
+
+        cl_mem tmp = vec_current;
+        vec_current = vec_next;
+        vec_next = tmp;
+        if(done)
+            break;
+    }
+    clFinish(command_queue);
+
+    end = omp_get_wtime();
+    printf("Total number of iterations: %d\n", iterations);
+    printf("HYB average time per iteration: %f\n", (end - start) / iterations);
+    printf("HYB OCL total computation: %f\n", end - start);
+
+    clStatus |= clEnqueueReadBuffer(command_queue, vec_current, CL_TRUE, 0,
+                                    mELL.num_cols*sizeof(cl_float), pagerank_out, 0, NULL, NULL);
+
+    // Normalize output
+    double sum = 0.;
+    for(int i = 0; i < mELL.num_cols; i++)
+        sum += pagerank_out[i];
+    for(int i = 0; i < mELL.num_cols; i++)
+        pagerank_out[i] /= sum;
+
+    // Free memory structures
+    clStatus = clReleaseKernel(fixPROutput);
+    clStatus = clReleaseKernel(normDiff);
+    clStatus = clReleaseKernel(kernelELL);
+    clStatus = clReleaseKernel(kernelCOO);
+    clStatus = clReleaseKernel(kernelCarry);
+    if(PATTERN_ONLY)
+        rank_scaling_release(&scaling);
+
+    clStatus = clReleaseMemObject(vecIn_d);
+    clStatus = clReleaseMemObject(vecOut_d);
+    clStatus = clReleaseMemObject(mELLcol_d);
+    clStatus = clReleaseMemObject(mCOOrow_d);
+    clStatus = clReleaseMemObject(mCOOcol_d);
+    if(!PATTERN_ONLY) {
+        clStatus = clReleaseMemObject(mELLdata_d);
+        clStatus = clReleaseMemObject(mCOOdata_d);
+    }
+    clStatus = clReleaseMemObject(carryRow_d);
+    clStatus = clReleaseMemObject(carryVal_d);
+    clStatus = clReleaseMemObject(norm_diff_d);
+
+    ocl_destroy(command_queue, context, program);
+    free(pagerank_in);
+    return pagerank_out;
+}
+
+float * pagerank_BCSR(mtx_BCSR mBCSR) {
+    double start, end;
+    cl_command_queue command_queue;
+    cl_context context;
+    cl_program program;
+
+    int clStatus = ocl_init("kernels/sparse_matrix.cl", &command_queue, &context, &program);
+    if (clStatus != 0) {
+        printf("Initialization failed. Exiting OCL computation.\n");
+        exit(1);
+    }
+
+    /*
+     * DATA ALLOCATION
+     */
+
+    // allocate pagerank vectors and compute initial values
+    float * pagerank_in  = (float*) malloc(mBCSR.num_cols * sizeof(float));
+    float * pagerank_out = (float*) malloc(mBCSR.num_cols * sizeof(float));
+    for (int i = 0; i < mBCSR.num_cols; i++)
+        pagerank_in[i] = 1. / mBCSR.num_cols;
+
+    cl_mem vecIn_d = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                    mBCSR.num_cols * sizeof(cl_float), pagerank_in, &clStatus);
+    cl_mem vecOut_d = clCreateBuffer(context, CL_MEM_READ_WRITE,
+                                    mBCSR.num_cols * sizeof(cl_float), NULL, &clStatus);
+
+    // allocate float for norm
+    cl_mem norm_diff_d = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_float), NULL, &clStatus);
+    float zero = 0;
+    float norm;
+
+    // allocate memory on device and transfer data from host BCSR (an empty matrix gets 1-element buffers)
+    edge_t nonzeros = mBCSR.num_nonzeros > 0 ? mBCSR.num_nonzeros : 1;
+    cl_mem mBCSRsegptr_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (mBCSR.num_segments + 1) * sizeof(edge_t), mBCSR.seg_ptr, &clStatus);
+    cl_mem mBCSRsegrow_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (mBCSR.num_segments > 0 ? mBCSR.num_segments : 1) * sizeof(cl_int), mBCSR.seg_row, &clStatus);
+    cl_mem mBCSRcol_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    nonzeros * sizeof(cl_ushort), mBCSR.col, &clStatus);
+    cl_mem mBCSRdata_d = NULL; // no values with PATTERN_ONLY
+    if(!PATTERN_ONLY)
+        mBCSRdata_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    nonzeros * sizeof(cl_float), mBCSR.data, &clStatus);
+
+    /*
+     * CREATE KERNELS
+     */
+
+    cl_kernel fixPROutput = clCreateKernel(program, "fixPROutput", &clStatus);
+    clStatus |= clSetKernelArg(fixPROutput, 1, sizeof(cl_int), (void *)&(mBCSR.num_cols));
+
+    cl_kernel normDiff = clCreateKernel(program, "normDiff", &clStatus);
+    clStatus |= clSetKernelArg(normDiff, 2, sizeof(cl_int), (void *)&(mBCSR.num_cols));
+    clStatus |= clSetKernelArg(normDiff, 3, WORKGROUP_SIZE*sizeof(cl_float), NULL);
+    clStatus |= clSetKernelArg(normDiff, 4, sizeof(cl_mem), (void *)&norm_diff_d);
+
+    // the blocks add their partial sums into a zeroed output vector
+    cl_kernel zeroVector = clCreateKernel(program, "zeroVector", &clStatus);
+    clStatus |= clSetKernelArg(zeroVector, 1, sizeof(cl_int), (void *)&(mBCSR.num_rows));
+
+    cl_kernel kernelBCSR = clCreateKernel(program, "mBCSR", &clStatus);
+    clStatus |= clSetKernelArg(kernelBCSR, 0, sizeof(cl_mem), (void *)&mBCSRsegptr_d);
+    clStatus |= clSetKernelArg(kernelBCSR, 1, sizeof(cl_mem), (void *)&mBCSRsegrow_d);
+    clStatus |= clSetKernelArg(kernelBCSR, 2, sizeof(cl_mem), (void *)&mBCSRcol_d);
+    clStatus |= clSetKernelArg(kernelBCSR, 3, sizeof(cl_mem), (void *)&mBCSRdata_d);
+
+    struct rank_scaling scaling;
+    if(PATTERN_ONLY)
+        rank_scaling_init(&scaling, context, command_queue, program, mBCSR.col_scale, mBCSR.num_cols);
+
+    /*
+     * LAUNCH COMPUTATION
+     */
+
+    size_t local_item_size = WORKGROUP_SIZE;
+
+    // Divide work
+    int num_groups = (mBCSR.num_cols - 1) / local_item_size + 1;
+    size_t global_item_size_helpers = num_groups * local_item_size;
+
+    // one work item per segment of every block
+    size_t * global_item_size_blocks = (size_t *) malloc((mBCSR.num_blocks > 0 ? mBCSR.num_blocks : 1) * sizeof(size_t));
+    for (int b = 0; b < mBCSR.num_blocks; b++) {
+        edge_t segments = mBCSR.block_ptr[b+1] - mBCSR.block_ptr[b];
+        global_item_size_blocks[b] = ((segments + local_item_size - 1) / local_item_size) * local_item_size;
+    }
+
+    // BCSR write, execute, read
+    int iterations = 0;
+    cl_mem vec_current = vecIn_d, vec_next = vecOut_d;
+
+    start = omp_get_wtime();
+
+    while (1) {
+        clStatus |= clSetKernelArg(zeroVector, 0, sizeof(cl_mem), (void *)&vec_next);
+        clStatus |= clSetKernelArg(kernelBCSR, 4, sizeof(cl_mem), (void *)&vec_current);
+        clStatus |= clSetKernelArg(kernelBCSR, 5, sizeof(cl_mem), (void *)&vec_next);
+        clStatus |= clSetKernelArg(fixPROutput, 0, sizeof(cl_mem), (void *)&vec_next);
+        if(PATTERN_ONLY)
+            clStatus |= rank_scaling_run(&scaling, command_queue, vec_current, &kernelBCSR, 1, 4);
+
+        clStatus |= clEnqueueNDRangeKernel(command_queue, zeroVector, 1, NULL,
+                                        &global_item_size_helpers, &local_item_size, 0, NULL, NULL);
+        for (int b = 0; b < mBCSR.num_blocks; b++) {
+            if (global_item_size_blocks[b] == 0)
+                continue;
+            int col_base = b * BCSR_BLOCK_COLS;
+            clStatus |= clSetKernelArg(kernelBCSR, 6, sizeof(edge_t), (void *)&mBCSR.block_ptr[b]);
+            clStatus |= clSetKernelArg(kernelBCSR, 7, sizeof(edge_t), (void *)&mBCSR.block_ptr[b+1]);
+            clStatus |= clSetKernelArg(kernelBCSR, 8, sizeof(cl_int), (void *)&col_base);
+            clStatus |= clEnqueueNDRangeKernel(command_queue, kernelBCSR, 1, NULL,
+                                        &global_item_size_blocks[b], &local_item_size, 0, NULL, NULL);
+        }
+        clStatus |= clEnqueueNDRangeKernel(command_queue, fixPROutput, 1, NULL,
+                                        &global_item_size_helpers, &local_item_size, 0, NULL, NULL);
+
+        iterations++;
+
+        // Check exit criteria
+        int done = MAX_ITER > 0 && iterations >= MAX_ITER;
+        if(!done && CHECK_CONVERGENCE) {
+            clStatus |= clSetKernelArg(normDiff, 0, sizeof(cl_mem), (void *)&vec_current);
+            clStatus |= clSetKernelArg(normDiff, 1, sizeof(cl_mem), (void *)&vec_next);
+            clStatus |= clEnqueueWriteBuffer(command_queue, norm_diff_d, CL_TRUE, 0,
+                                        sizeof(cl_float), &zero, 0, NULL, NULL);
+            clStatus |= clEnqueueNDRangeKernel(command_queue, normDiff, 1, NULL,
+                                        &global_item_size_helpers, &local_item_size, 0, NULL, NULL);
+            clStatus |= clEnqueueReadBuffer(command_queue, norm_diff_d, CL_TRUE, 0,
+                                        sizeof(cl_float), &norm, 0, NULL, NULL);
+            done = sqrt(norm) <= EPSILON;
+        }
+
+        cl_mem tmp = vec_current;
+        vec_current = vec_next;
+        vec_next = tmp;
+        if(done)
+            break;
+    }
+    clFinish(command_queue);
+
+    end = omp_get_wtime();
+    printf("Total number of iterations: %d\n", iterations);
+    printf("BCSR average time per iteration: %f\n", (end - start) / iterations);
+    printf("BCSR OCL total computation: %f\n", end - start);
+    printf("BCSR matrix bandwidth: %.2f GB/s\n", mtx_BCSR_bytes(&mBCSR) * iterations / (end - start) / 1e9);
+
+    clStatus |= clEnqueueReadBuffer(command_queue, vec_current, CL_TRUE, 0,
+                                    mBCSR.num_cols*sizeof(cl_float), pagerank_out, 0, NULL, NULL);
+
+    // Normalize output
+    double sum = 0.;
+    for(int i = 0; i < mBCSR.num_cols; i++)
+        sum += pagerank_out[i];
+    for(int i = 0; i < mBCSR.num_cols; i++)
+        pagerank_out[i] /= sum;
+
+    // Free memory structures
+    clStatus = clReleaseKernel(fixPROutput);
+    clStatus = clReleaseKernel(normDiff);
+    clStatus = clReleaseKernel(zeroVector);
+    clStatus = clReleaseKernel(kernelBCSR);
+    if(PATTERN_ONLY)
+        rank_scaling_release(&scaling);
+
+    clStatus = clReleaseMemObject(vecIn_d);
+    clStatus = clReleaseMemObject(vecOut_d);
+    clStatus = clReleaseMemObject(mBCSRsegptr_d);
+    clStatus = clReleaseMemObject(mBCSRsegrow_d);
+    clStatus = clReleaseMemObject(mBCSRcol_d);
+    if(!PATTERN_ONLY)
+        clStatus = clReleaseMemObject(mBCSRdata_d);
+    clStatus = clReleaseMemObject(norm_diff_d);
+
+    ocl_destroy(command_queue, context, program);
+    free(global_item_size_blocks);
+    free(pagerank_in);
+    return pagerank_out;
+}
@@ -5,6 +5,8 @@
 #include <omp.h>
 #include "../helpers/helper.h"
 #include "../helpers/ocl_helper.h"
+#include "../helpers/simd_helper.h"
+#include "../readers/custom_matrix.h"
 #include "../global_config.h"
 
 /*
@@ -19,6 +21,12 @@ void update_sizes(size_t new_groups, size_t new_local_item_size,
     *num_groups = new_groups;
 }
 
+int push_iteration_done(float * pagerank_old, float * pagerank_new, int nodes_count, int iterations, double epsilon) {
+    if (MAX_ITER > 0 && iterations >= MAX_ITER)
+        return 1;
+    return CHECK_CONVERGENCE && get_norm_difference(pagerank_old, pagerank_new, nodes_count, true) <= epsilon;
+}
+
 float * pagerank_custom_out(int ** graph, int * out_degrees, int leaves_count, int * leaves, int nodes_count, double epsilon) {
     float *pagerank_old, *pagerank_new;
     init_pagerank(&pagerank_old, &pagerank_new, nodes_count);
@@ -48,14 +56,425 @@ float * pagerank_custom_out(int ** graph, int * out_degrees, int leaves_count, i
         }
         swap_pointers(&pagerank_old, &pagerank_new);
         iterations++;
-        if (iterations > 100) break;
-
-    } while (get_norm_difference(pagerank_old, pagerank_new, nodes_count, true) > epsilon);
+    } while (!push_iteration_done(pagerank_old, pagerank_new, nodes_count, iterations, epsilon));
     printf("Total pagerank iterations: %d\n", iterations);
     swap_pointers(&pagerank_old, &pagerank_new);
+    free(pagerank_old);
     return pagerank_new;
 }
 
+int * push_partition_destinations(int ** graph, int * out_degrees, int nodes_count, int parts,
+                edge_t ** piece_start, int ** piece_source, int ** piece_first) {
+    /*
+     * splits the destinations into `parts` ranges with about the same number of in-edges,
+     * counted from the out-lists (no in-matrix is needed). Part p is [range_start[p], range_start[p+1]).
+     * The sorted out-lists are cut into pieces, one for every part a list has neighbours in: the pieces
+     * of part p are [piece_start[p], piece_start[p+1]), in increasing order of source, and piece k
+     * starts at graph[piece_source[k]][piece_first[k]]. As in `scatter_edges`, the pieces are counted
+     * and written per chunk of sources, so a part only visits the sources with edges in its range
+     */
+    int * in_count = (int *) calloc(nodes_count > 0 ? nodes_count : 1, sizeof(int));
+    int * range_start = (int *) malloc((parts + 1) * sizeof(int));
+    int * chunk_start = (int *) malloc((parts + 1) * sizeof(int));
+    edge_t * cursors = (edge_t *) calloc((size_t) parts * parts, sizeof(edge_t));
+    *piece_start = (edge_t *) malloc((parts + 1) * sizeof(edge_t));
+    if (in_count == NULL || range_start == NULL || chunk_start == NULL || cursors == NULL || *piece_start == NULL) {
+        printf("Could not allocate space for the destination ranges.\n");
+        exit(1);
+    }
+
+    long long edges = 0;
+    #pragma omp parallel for schedule(guided) reduction(+ : edges)
+    for (int i = 0; i < nodes_count; i++) {
+        for (int j = 0; j < out_degrees[i]; j++) {
+            #pragma omp atomic
+            in_count[graph[i][j]]++;
+        }
+        edges += out_degrees[i];
+    }
+
+    balanced_ranges(range_start, in_count, nodes_count, edges, parts);
+    balanced_ranges(chunk_start, out_degrees, nodes_count, edges, parts);
+    free(in_count);
+
+    // count the pieces of every (chunk, part), then write them where the prefix sum puts them
+    for (int pass = 0; pass < 2; pass++) {
+        #pragma omp parallel for schedule(static, 1)
+        for (int c = 0; c < parts; c++) {
+            edge_t * cursor = &cursors[(size_t) c * parts];
+            for (int i = chunk_start[c]; i < chunk_start[c + 1]; i++) {
+                int j = 0;
+                while (j < out_degrees[i]) {
+                    int p = find_range(range_start, parts, graph[i][j]);
+                    if (pass == 1) {
+                        (*piece_source)[cursor[p]] = i;
+                        (*piece_first)[cursor[p]] = j;
+                    }
+                    cursor[p]++;
+                    while (j < out_degrees[i] && graph[i][j] < range_start[p + 1])
+                        j++;
+                }
+            }
+        }
+        if (pass == 0) {
+            edge_t pieces = prefix_sum_range_cursors(cursors, *piece_start, parts, parts);
+            *piece_source = (int *) malloc((pieces > 0 ? pieces : 1) * sizeof(int));
+            *piece_first = (int *) malloc((pieces > 0 ? pieces : 1) * sizeof(int));
+            if (*piece_source == NULL || *piece_first == NULL) {
+                printf("Could not allocate space for the destination ranges.\n");
+                exit(1);
+            }
+        }
+    }
+    free(chunk_start);
+    free(cursors);
+    return range_start;
+}
+
+float * pagerank_custom_out_parallel(int ** graph, int * out_degrees, int leaves_count, int * leaves,
+                int nodes_count, double epsilon, int strategy) {
+    /*
+     * multithreaded push on the out-matrix, the same iteration as `pagerank_custom_out`. The contributions
+     * DAMPENING * pr / out_degree are computed once per node, and the threads push them in one of three ways:
+     *  - PUSH_LOCAL_BUFFERS: every thread adds into its own vector, which are summed by a parallel merge
+     *  - PUSH_PARTITIONED: every part of `push_partition_destinations` is owned by one thread, which pushes
+     *    only the pieces of the out-lists in its range (out-lists are sorted, see `format_graph_out_from_in`)
+     *  - PUSH_ATOMIC: atomic float adds into the shared vector
+     */
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, nodes_count);
+    float * contribution = (float *) malloc(nodes_count * sizeof(float));
+    int max_threads = omp_get_max_threads();
+    float * buffers = NULL;
+    int * range_start = NULL, * piece_source = NULL, * piece_first = NULL;
+    edge_t * piece_start = NULL;
+    int parts = max_threads;
+    if (strategy == PUSH_LOCAL_BUFFERS)
+        buffers = (float *) malloc((long long) max_threads * nodes_count * sizeof(float));
+    else if (strategy == PUSH_PARTITIONED)
+        range_start = push_partition_destinations(graph, out_degrees, nodes_count, parts, &piece_start,
+                        &piece_source, &piece_first);
+    if (contribution == NULL || (strategy == PUSH_LOCAL_BUFFERS && buffers == NULL)) {
+        printf("Could not allocate space for the push pagerank.\n");
+        exit(1);
+    }
+
+    int iterations = 0;
+
+    do {
+        float leaked_pagerank = 0.;
+        #pragma omp parallel for schedule(static) reduction(+ : leaked_pagerank)
+        for (int i = 0; i < leaves_count; i++)
+            leaked_pagerank += pagerank_old[leaves[i]];
+        leaked_pagerank = leaked_pagerank + (1 - leaked_pagerank) * (1 - DAMPENING);
+        float init_pagerank = leaked_pagerank / (float)nodes_count;
+
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < nodes_count; i++)
+            contribution[i] = out_degrees[i] > 0 ? DAMPENING * pagerank_old[i] / (float)out_degrees[i] : 0.f;
+
+        if (strategy == PUSH_LOCAL_BUFFERS) {
+            #pragma omp parallel
+            {
+                int threads = omp_get_num_threads();
+                float * local = &buffers[(long long) omp_get_thread_num() * nodes_count];
+                memset(local, 0, nodes_count * sizeof(float));
+                #pragma omp for schedule(guided)
+                for (int i = 0; i < nodes_count; i++)
+                    for (int j = 0; j < out_degrees[i]; j++)
+                        local[graph[i][j]] += contribution[i];
+
+                #pragma omp for schedule(static)
+                for (int d = 0; d < nodes_count; d++) {
+                    float d_pr = init_pagerank;
+                    for (int t = 0; t < threads; t++)
+                        d_pr += buffers[(long long) t * nodes_count + d];
+                    pagerank_new[d] = d_pr;
+                }
+            }
+        } else if (strategy == PUSH_PARTITIONED) {
+            #pragma omp parallel for schedule(dynamic, 1)
+            for (int p = 0; p < parts; p++) {
+                int low = range_start[p], high = range_start[p+1];
+                for (int d = low; d < high; d++)
+                    pagerank_new[d] = init_pagerank;
+                for (edge_t k = piece_start[p]; k < piece_start[p + 1]; k++) {
+                    int i = piece_source[k];
+                    const int * out = graph[i];
+                    float i_contribution = contribution[i];
+                    for (int j = piece_first[k]; j < out_degrees[i] && out[j] < high; j++)
+                        pagerank_new[out[j]] += i_contribution;
+                }
+            }
+        } else {
+            #pragma omp parallel for schedule(static)
+            for (int d = 0; d < nodes_count; d++)
+                pagerank_new[d] = init_pagerank;
+
+            #pragma omp parallel for schedule(guided)
+            for (int i = 0; i < nodes_count; i++) {
+                float i_contribution = contribution[i];
+                for (int j = 0; j < out_degrees[i]; j++) {
+                    #pragma omp atomic
+                    pagerank_new[graph[i][j]] += i_contribution;
+                }
+            }
+        }
+
+        swap_pointers(&pagerank_old, &pagerank_new);
+        iterations++;
+    } while (!push_iteration_done(pagerank_old, pagerank_new, nodes_count, iterations, epsilon));
+    printf("Total pagerank iterations: %d\n", iterations);
+
+    free(pagerank_new);
+    free(contribution);
+    free(buffers);
+    free(range_start);
+    free(piece_start);
+    free(piece_source);
+    free(piece_first);
+    return pagerank_old;
+}
+
+float * pagerank_custom_out_blocked(int ** graph, int * out_degrees, int leaves_count, int * leaves,
+                int nodes_count, double epsilon) {
+    /*
+     * propagation blocking on the out-matrix, for rank vectors larger than the last-level cache. The
+     * destinations are split into bins of PB_BIN_NODES nodes. Every iteration first streams the sources
+     * in order and appends their contributions to the bins of their destinations (sequential writes,
+     * one stream per bin), then accumulates every bin while its slice of the vector stays in cache.
+     * The graph does not change, so the destination of every bin entry is stored once; an iteration
+     * only writes and reads the values. Sources are split into parts with about the same number of
+     * edges, and every part has its own region in every bin, so both phases need no synchronization
+     * and a destination receives its contributions in source order, as in `pagerank_custom_out`
+     */
+    int bins = (int) (((long long) nodes_count + PB_BIN_NODES - 1) / PB_BIN_NODES);
+    int parts = omp_get_max_threads();
+    long long edges = 0;
+    for (int i = 0; i < nodes_count; i++)
+        edges += out_degrees[i];
+
+    int * part_start = (int *) malloc((parts + 1) * sizeof(int));
+    edge_t * bin_start = (edge_t *) malloc((bins + 1) * sizeof(edge_t));
+    edge_t * offsets = (edge_t *) calloc((long long) parts * bins + 1, sizeof(edge_t));
+    edge_t * cursors = (edge_t *) malloc(((long long) parts * bins + 1) * sizeof(edge_t));
+    int * bin_dst = (int *) malloc((edges > 0 ? edges : 1) * sizeof(int));
+    float * bin_val = (float *) malloc((edges > 0 ? edges : 1) * sizeof(float));
+    if (part_start == NULL || bin_start == NULL || offsets == NULL || cursors == NULL || bin_dst == NULL || bin_val == NULL) {
+        printf("Could not allocate space for the propagation blocking bins.\n");
+        exit(1);
+    }
+    balanced_ranges(part_start, out_degrees, nodes_count, edges, parts);
+
+    // entries of every (part, bin), turned into offsets in (bin, part) order
+    #pragma omp parallel for schedule(static, 1)
+    for (int p = 0; p < parts; p++) {
+        edge_t * counts = &offsets[(long long) p * bins];
+        for (int i = part_start[p]; i < part_start[p+1]; i++)
+            for (int j = 0; j < out_degrees[i]; j++)
+                counts[graph[i][j] / PB_BIN_NODES]++;
+    }
+    edge_t sum = 0;
+    for (int b = 0; b < bins; b++) {
+        bin_start[b] = sum;
+        for (int p = 0; p < parts; p++) {
+            edge_t count = offsets[(long long) p * bins + b];
+            offsets[(long long) p * bins + b] = sum;
+            sum += count;
+        }
+    }
+    bin_start[bins] = sum;
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int p = 0; p < parts; p++) {
+        edge_t * cursor = &cursors[(long long) p * bins];
+        memcpy(cursor, &offsets[(long long) p * bins], bins * sizeof(edge_t));
+        for (int i = part_start[p]; i < part_start[p+1]; i++)
+            for (int j = 0; j < out_degrees[i]; j++)
+                bin_dst[cursor[graph[i][j] / PB_BIN_NODES]++] = graph[i][j];
+    }
+
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, nodes_count);
+    int iterations = 0;
+    double binning_time = 0., accumulate_time = 0.;
+
+    do {
+        float leaked_pagerank = 0.;
+        #pragma omp parallel for schedule(static) reduction(+ : leaked_pagerank)
+        for (int i = 0; i < leaves_count; i++)
+            leaked_pagerank += pagerank_old[leaves[i]];
+        leaked_pagerank = leaked_pagerank + (1 - leaked_pagerank) * (1 - DAMPENING);
+        float init_pagerank = leaked_pagerank / (float)nodes_count;
+
+        // binning: stream the sources, append the contributions to the bins of their destinations
+        double start = omp_get_wtime();
+        #pragma omp parallel for schedule(static, 1)
+        for (int p = 0; p < parts; p++) {
+            edge_t * cursor = &cursors[(long long) p * bins];
+            memcpy(cursor, &offsets[(long long) p * bins], bins * sizeof(edge_t));
+            for (int i = part_start[p]; i < part_start[p+1]; i++) {
+                if (out_degrees[i] == 0)
+                    continue;
+                float contribution = DAMPENING * pagerank_old[i] / (float)out_degrees[i];
+                for (int j = 0; j < out_degrees[i]; j++)
+                    bin_val[cursor[graph[i][j] / PB_BIN_NODES]++] = contribution;
+            }
+        }
+        double middle = omp_get_wtime();
+
+        // accumulation: every bin updates only its own slice of the vector
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int b = 0; b < bins; b++) {
+            int low = b * PB_BIN_NODES;
+            int high = nodes_count - low > PB_BIN_NODES ? low + PB_BIN_NODES : nodes_count;
+            for (int d = low; d < high; d++)
+                pagerank_new[d] = init_pagerank;
+            for (edge_t k = bin_start[b]; k < bin_start[b+1]; k++)
+                pagerank_new[bin_dst[k]] += bin_val[k];
+        }
+        binning_time += middle - start;
+        accumulate_time += omp_get_wtime() - middle;
+
+        swap_pointers(&pagerank_old, &pagerank_new);
+        iterations++;
+    } while (!push_iteration_done(pagerank_old, pagerank_new, nodes_count, iterations, epsilon));
+    printf("Total pagerank iterations: %d\n", iterations);
+    printf("Propagation blocking - %d bins of %d nodes, average binning time: %.4f, accumulation time: %.4f\n",
+            bins, PB_BIN_NODES, binning_time / iterations, accumulate_time / iterations);
+
+    free(pagerank_new);
+    free(part_start);
+    free(bin_start);
+    free(offsets);
+    free(cursors);
+    free(bin_dst);
+    free(bin_val);
+    return pagerank_old;
+}
+
+float * pagerank_custom_out_delta(int ** graph, int * out_degrees, int nodes_count, double epsilon) {
+    /*
+     * residual-push (delta) pagerank on the out-matrix. Every node keeps a residual, the pagerank it
+     * received and did not push on yet, and only the nodes whose residual reaches `threshold` push
+     * DAMPENING times it to their out-neighbours. The pagerank of the nodes without out-edges is not
+     * pushed: it is spread uniformly, which only scales the solution, so the ranks are normalized to
+     * sum 1 at the end. Pushes run in rounds over the frontier, a compact list of the active nodes:
+     * a node takes its residual when its turn comes (so it also pushes what it received earlier in
+     * the round), and the atomic add that lifts a residual over the threshold appends the node to the
+     * thread's part of the next frontier. The solve stops when the pagerank still to push is below
+     * `epsilon` in L1 (every residual below epsilon / nodes_count). Residuals are double: they are
+     * never recomputed, so the rounding of the adds into the hubs would stay in the result
+     */
+    float * rank = (float *) malloc(nodes_count * sizeof(float));
+    double * residual = (double *) malloc(nodes_count * sizeof(double));
+    int * frontier = (int *) malloc(nodes_count * sizeof(int));
+    int * next = (int *) malloc(nodes_count * sizeof(int));
+    int * part_start = (int *) malloc((omp_get_max_threads() + 1) * sizeof(int));
+    if (rank == NULL || residual == NULL || frontier == NULL || next == NULL || part_start == NULL) {
+        printf("Could not allocate space for the residual push pagerank.\n");
+        exit(1);
+    }
+
+    double threshold = epsilon / nodes_count;
+    long long edges_count = 0, edge_work = 0, pushes = 0;
+    int frontier_size = 0, rounds = 0;
+    for (int i = 0; i < nodes_count; i++) {
+        rank[i] = 0.f;
+        residual[i] = 1 / (double)nodes_count;
+        if (residual[i] >= threshold)
+            frontier[frontier_size++] = i;
+        edges_count += out_degrees[i];
+    }
+
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        int capacity = 1024;
+        int * found = (int *) malloc(capacity * sizeof(int));
+        if (found == NULL) {
+            printf("Could not allocate space for the residual push pagerank.\n");
+            exit(1);
+        }
+
+        while (frontier_size > 0) {
+            int count = 0;
+            #pragma omp for schedule(dynamic, 256) reduction(+ : edge_work) nowait
+            for (int k = 0; k < frontier_size; k++) {
+                int i = frontier[k];
+                double pushed;
+                #pragma omp atomic capture
+                { pushed = residual[i]; residual[i] = 0.; }
+                rank[i] += pushed;
+                if (out_degrees[i] == 0)
+                    continue;
+                double contribution = DAMPENING * pushed / out_degrees[i];
+                edge_work += out_degrees[i];
+                for (int j = 0; j < out_degrees[i]; j++) {
+                    int d = graph[i][j];
+                    double old;
+                    #pragma omp atomic capture
+                    { old = residual[d]; residual[d] += contribution; }
+                    if (old < threshold && old + contribution >= threshold) {
+                        if (count == capacity) {
+                            capacity *= 2;
+                            found = (int *) realloc(found, capacity * sizeof(int));
+                            if (found == NULL) {
+                                printf("Could not allocate space for the residual push pagerank.\n");
+                                exit(1);
+                            }
+                        }
+                        found[count++] = d;
+                    }
+                }
+            }
+            part_start[t + 1] = count;
+            #pragma omp barrier
+
+            #pragma omp single
+            {
+                part_start[0] = 0;
+                for (int p = 0; p < threads; p++)
+                    part_start[p + 1] += part_start[p];
+                pushes += frontier_size;
+                rounds++;
+            }
+            memcpy(&next[part_start[t]], found, count * sizeof(int));
+            #pragma omp barrier
+
+            #pragma omp single
+            {
+                int * tmp = frontier;
+                frontier = next;
+                next = tmp;
+                frontier_size = part_start[threads];
+            }
+        }
+        free(found);
+    }
+
+    // the residuals left are part of the ranks too
+    double sum = 0.;
+    #pragma omp parallel for schedule(static) reduction(+ : sum)
+    for (int i = 0; i < nodes_count; i++) {
+        rank[i] += residual[i];
+        sum += rank[i];
+    }
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < nodes_count; i++)
+        rank[i] = rank[i] / sum;
+
+    printf("Residual push - %d rounds, %lld pushes, %lld edges pushed (%.2f sweeps of the graph)\n",
+            rounds, pushes, edge_work, edges_count > 0 ? edge_work / (double) edges_count : 0.);
+
+    free(residual);
+    free(frontier);
+    free(next);
+    free(part_start);
+    return rank;
+}
+
 float * pagerank_custom_in(int ** graph, int * in_degrees, int * out_degrees,
                 int leaves_count, int * leaves, int nodes_count, double epsilon, bool parallel_for) {
     float *pagerank_old, *pagerank_new;
@@ -95,10 +514,680 @@ float * pagerank_custom_in(int ** graph, int * in_degrees, int * out_degrees,
     return pagerank_new;
 }
 
+int extrapolation_ring_size(int extrapolation) {
+    // iterates kept by the power iteration for the extrapolation method (2: just the old and new vectors)
+    if (extrapolation == EXTRAP_QUADRATIC)
+        return 4;
+    return extrapolation == EXTRAP_AITKEN ? 3 : 2;
+}
+
+int quadratic_extrapolation_weights(double * sums, double * weights) {
+    /*
+     * quadratic extrapolation of Kamvar et al. from the iterates x0..x3 (oldest first). With a = x1 - x0,
+     * b = x2 - x0 and c = x3 - x0, `sums` holds a.a, a.b, b.b, a.c, b.c and the sums of x1, x2 and x3.
+     * The least squares fit of c by a and b (normal equations) gives the weights of x1, x2 and x3 in the
+     * extrapolated vector, scaled so that it has the sum of x3 (in float the iteration does not keep the
+     * sum exactly 1, a jump to 1 would restart its convergence). Returns 1 if the fit is singular
+     */
+    double det = sums[0] * sums[2] - sums[1] * sums[1];
+    if (!(fabs(det) > 1e-12 * sums[0] * sums[2]))
+        return 1;
+    double gamma1 = -(sums[2] * sums[3] - sums[1] * sums[4]) / det;
+    double gamma2 = -(sums[0] * sums[4] - sums[1] * sums[3]) / det;
+    double beta[3] = {gamma1 + gamma2 + 1, gamma2 + 1, 1};
+    double total = beta[0] * sums[5] + beta[1] * sums[6] + beta[2] * sums[7];
+    if (!(fabs(total) > 0.))
+        return 1;
+    for (int k = 0; k < 3; k++)
+        weights[k] = beta[k] * sums[7] / total;
+    return 0;
+}
+
+int extrapolate_quadratic(float * x0, float * x1, float * x2, float * x3, int nodes_count) {
+    // replaces x3 by the quadratic extrapolation of x0..x3, returns 1 (and leaves x3) if it is singular
+    double s0 = 0., s1 = 0., s2 = 0., s3 = 0., s4 = 0., s5 = 0., s6 = 0., s7 = 0.;
+    #pragma omp parallel for schedule(static) reduction(+ : s0, s1, s2, s3, s4, s5, s6, s7)
+    for (int i = 0; i < nodes_count; i++) {
+        double a = x1[i] - x0[i], b = x2[i] - x0[i], c = x3[i] - x0[i];
+        s0 += a * a;
+        s1 += a * b;
+        s2 += b * b;
+        s3 += a * c;
+        s4 += b * c;
+        s5 += x1[i];
+        s6 += x2[i];
+        s7 += x3[i];
+    }
+    double sums[8] = {s0, s1, s2, s3, s4, s5, s6, s7}, weights[3];
+    if (quadratic_extrapolation_weights(sums, weights))
+        return 1;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < nodes_count; i++)
+        x3[i] = weights[0] * x1[i] + weights[1] * x2[i] + weights[2] * x3[i];
+    return 0;
+}
+
+float aitken_extrapolate(float x0, float x1, float x2) {
+    /*
+     * Aitken delta-squared on the last three values of a node, x2 + d2 * r / (1 - r) with the ratio
+     * r = d2 / d1 of the last two changes. Kept as x2 unless |r| < 0.99 (geometric convergence)
+     */
+    float d1 = x1 - x0, d2 = x2 - x1;
+    if (d1 == 0.f)
+        return x2;
+    float r = d2 / d1;
+    if (!(fabsf(r) < 0.99f))
+        return x2;
+    float x = x2 + d2 * r / (1 - r);
+    return x > 0.f ? x : x2;
+}
+
+void extrapolate_aitken(float * x0, float * x1, float * x2, int nodes_count) {
+    // replaces x2 by the Aitken extrapolation of every node, scaled to the sum of x2
+    double sum_before = 0., sum = 0.;
+    #pragma omp parallel for schedule(static) reduction(+ : sum_before, sum)
+    for (int i = 0; i < nodes_count; i++) {
+        sum_before += x2[i];
+        x2[i] = aitken_extrapolate(x0[i], x1[i], x2[i]);
+        sum += x2[i];
+    }
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < nodes_count; i++)
+        x2[i] = x2[i] * (sum_before / sum);
+}
+
+float * pagerank_custom_in_extrapolated(int ** graph, int * in_degrees, int * out_degrees,
+                int leaves_count, int * leaves, int nodes_count, double epsilon, int extrapolation) {
+    /*
+     * power iteration of `pagerank_custom_in` (in parallel) with an optional extrapolation stage. The
+     * iterates rotate in a ring of `extrapolation_ring_size` vectors, so the last ones are kept without
+     * copies (EXTRAP_AITKEN needs one vector more than the two of the power iteration, EXTRAP_QUADRATIC
+     * two). Every EXTRAPOLATION_PERIOD iterations the newest iterate is replaced by its extrapolation
+     * from the last ones, and the power iteration goes on from there
+     */
+    int ring_size = extrapolation_ring_size(extrapolation);
+    float * ring[4];
+    for (int r = 0; r < ring_size; r++) {
+        ring[r] = (float *) malloc(nodes_count * sizeof(float));
+        if (ring[r] == NULL) {
+            printf("Could not allocate space for the extrapolated pagerank.\n");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < nodes_count; i++)
+        ring[0][i] = 1 / (float)nodes_count;
+
+    int iterations = 0, since_extrapolation = 0, extrapolations = 0;
+    double extrapolation_time = 0.;
+    float *pagerank_old, *pagerank_new;
+
+    do {
+        pagerank_old = ring[iterations % ring_size];
+        pagerank_new = ring[(iterations + 1) % ring_size];
+
+        float leaked_pagerank = 0.;
+        for (int i = 0; i < leaves_count; i++)
+            leaked_pagerank += pagerank_old[leaves[i]];
+        leaked_pagerank = leaked_pagerank + (1 - leaked_pagerank) * (1 - DAMPENING);
+        float init_pagerank = leaked_pagerank / (float)nodes_count;
+
+        #pragma omp parallel for schedule(guided)
+        for (int i = 0; i < nodes_count; i++) {
+            float i_pr = init_pagerank;
+            for (int j = 0; j < in_degrees[i]; j++)
+                i_pr += DAMPENING * pagerank_old[graph[i][j]] / out_degrees[graph[i][j]];
+            pagerank_new[i] = i_pr;
+        }
+        iterations++;
+        since_extrapolation++;
+
+        // the iterates since the last extrapolation (included) are a power iteration sequence
+        if (extrapolation != EXTRAP_NONE && since_extrapolation >= EXTRAPOLATION_PERIOD
+                    && since_extrapolation >= ring_size - 1) {
+            double start = omp_get_wtime();
+            float * x0 = ring[(iterations - ring_size + 1) % ring_size];
+            float * x1 = ring[(iterations - ring_size + 2) % ring_size];
+            if (extrapolation == EXTRAP_AITKEN) {
+                extrapolate_aitken(x0, x1, pagerank_new, nodes_count);
+                extrapolations++;
+            } else if (!extrapolate_quadratic(x0, x1, ring[(iterations - 1) % ring_size], pagerank_new, nodes_count)) {
+                extrapolations++;
+            }
+            since_extrapolation = 0;
+            extrapolation_time += omp_get_wtime() - start;
+        }
+    } while (!(MAX_ITER > 0 && iterations >= MAX_ITER)
+                && !(CHECK_CONVERGENCE && get_norm_difference(pagerank_old, pagerank_new, nodes_count, true) <= epsilon));
+    printf("Total pagerank iterations: %d\n", iterations);
+    if (extrapolation != EXTRAP_NONE)
+        printf("Extrapolation - %d extrapolations, total time: %.4f\n", extrapolations, extrapolation_time);
+
+    for (int r = 0; r < ring_size; r++)
+        if (ring[r] != pagerank_new)
+            free(ring[r]);
+    return pagerank_new;
+}
+
+float * pagerank_custom_in_fused(int ** graph, int * in_degrees, int * out_degrees, int nodes_count, double epsilon) {
+    /*
+     * same iteration as `pagerank_custom_in`, in a single parallel region for the whole solve. The
+     * pull sweep gathers the pre-scaled contributions DAMPENING * pr / out_degree, and while it writes
+     * a node it also computes the node's contribution for the next iteration, its share of the leaked
+     * pagerank (nodes without out-edges) and of the squared norm difference. An iteration is then one
+     * pass over the nodes plus the gather (the kernel selected by `simd_init`); the per-thread partial
+     * sums are combined by one thread between the two barriers of the iteration
+     */
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, nodes_count);
+    float * contribution_old = (float *) malloc(nodes_count * sizeof(float));
+    float * contribution_new = (float *) malloc(nodes_count * sizeof(float));
+    int max_threads = omp_get_max_threads();
+    double * partial_leaked = (double *) malloc(max_threads * sizeof(double));
+    double * partial_norm = (double *) malloc(max_threads * sizeof(double));
+    if (contribution_old == NULL || contribution_new == NULL || partial_leaked == NULL || partial_norm == NULL) {
+        printf("Could not allocate space for the fused pagerank.\n");
+        exit(1);
+    }
+
+    float * result = NULL;
+    double leaked = 0.;
+    int iterations = 0, done = 0;
+
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        // every thread swaps its own copy of the pointers, in the same way
+        float * pr_old = pagerank_old, * pr_new = pagerank_new;
+        float * c_old = contribution_old, * c_new = contribution_new;
+
+        double local_leaked = 0.;
+        #pragma omp for schedule(static) nowait
+        for (int i = 0; i < nodes_count; i++) {
+            c_old[i] = out_degrees[i] > 0 ? DAMPENING * pr_old[i] / out_degrees[i] : 0.f;
+            if (out_degrees[i] == 0)
+                local_leaked += pr_old[i];
+        }
+        partial_leaked[t] = local_leaked;
+        #pragma omp barrier
+
+        #pragma omp single
+        for (int k = 0; k < threads; k++)
+            leaked += partial_leaked[k];
+
+        while (1) {
+            float leaked_pagerank = leaked + (1 - leaked) * (1 - DAMPENING);
+            float init_pagerank = leaked_pagerank / (float)nodes_count;
+
+            double local_norm = 0.;
+            local_leaked = 0.;
+            #pragma omp for schedule(guided) nowait
+            for (int i = 0; i < nodes_count; i++) {
+                float i_pr = init_pagerank + gather.sum(graph[i], c_old, in_degrees[i]);
+                pr_new[i] = i_pr;
+                if (CHECK_CONVERGENCE)
+                    local_norm += square(i_pr - pr_old[i]);
+                if (out_degrees[i] > 0)
+                    c_new[i] = DAMPENING * i_pr / out_degrees[i];
+                else {
+                    c_new[i] = 0.f;
+                    local_leaked += i_pr;
+                }
+            }
+            partial_leaked[t] = local_leaked;
+            partial_norm[t] = local_norm;
+            #pragma omp barrier
+
+            #pragma omp single
+            {
+                double norm = 0.;
+                leaked = 0.;
+                for (int k = 0; k < threads; k++) {
+                    leaked += partial_leaked[k];
+                    norm += partial_norm[k];
+                }
+                iterations++;
+                done = (MAX_ITER > 0 && iterations >= MAX_ITER) || (CHECK_CONVERGENCE && sqrt(norm) <= epsilon);
+                if (done)
+                    result = pr_new;
+            }
+
+            float * tmp = pr_old;
+            pr_old = pr_new;
+            pr_new = tmp;
+            tmp = c_old;
+            c_old = c_new;
+            c_new = tmp;
+            if (done)
+                break;
+        }
+    }
+    printf("Total pagerank iterations: %d\n", iterations);
+
+    free(result == pagerank_new ? pagerank_old : pagerank_new);
+    free(contribution_old);
+    free(contribution_new);
+    free(partial_leaked);
+    free(partial_norm);
+    return result;
+}
+
+float * pagerank_custom_in_gauss_seidel(int ** graph, int * in_degrees, int * out_degrees, int nodes_count, double epsilon) {
+    /*
+     * Gauss-Seidel counterpart of `pagerank_custom_in`: a single vector updated in place, so a node
+     * already gathers the ranks computed earlier in the same sweep. Sweeps are block-asynchronous:
+     * every thread owns a range of nodes with about the same number of in-edges and sweeps it in
+     * order, while the ranks of the other ranges are read as they are (before or after their update
+     * in this sweep). The pagerank leaked by the nodes without out-edges is the one of the previous
+     * sweep. The difference between two sweeps is computed while the ranks are overwritten, and the
+     * rows are summed in double: the hubs otherwise drift from the exact ranks sweep after sweep
+     */
+    float * pagerank = (float *) malloc(nodes_count * sizeof(float));
+    int max_threads = omp_get_max_threads();
+    int * range_start = (int *) malloc((max_threads + 1) * sizeof(int));
+    double * partial_leaked = (double *) malloc(max_threads * sizeof(double));
+    double * partial_norm = (double *) malloc(max_threads * sizeof(double));
+    if (pagerank == NULL || range_start == NULL || partial_leaked == NULL || partial_norm == NULL) {
+        printf("Could not allocate space for the Gauss-Seidel pagerank.\n");
+        exit(1);
+    }
+
+    double leaked = 0.;
+    long long edges_count = 0;
+    for (int i = 0; i < nodes_count; i++) {
+        pagerank[i] = 1 / (float)nodes_count;
+        edges_count += in_degrees[i];
+        if (out_degrees[i] == 0)
+            leaked += pagerank[i];
+    }
+
+    int iterations = 0, done = 0;
+
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        #pragma omp single
+        balanced_ranges(range_start, in_degrees, nodes_count, edges_count, threads);
+
+        while (!done) {
+            float leaked_pagerank = leaked + (1 - leaked) * (1 - DAMPENING);
+            float init_pagerank = leaked_pagerank / (float)nodes_count;
+
+            double local_norm = 0., local_leaked = 0.;
+            for (int i = range_start[t]; i < range_start[t + 1]; i++) {
+                double sum = 0.;
+                for (int j = 0; j < in_degrees[i]; j++) {
+                    // other threads may be writing the rank
+                    float pr_j;
+                    #pragma omp atomic read
+                    pr_j = pagerank[graph[i][j]];
+                    sum += pr_j / out_degrees[graph[i][j]];
+                }
+                float i_pr = init_pagerank + DAMPENING * sum;
+                local_norm += square(i_pr - pagerank[i]);
+                #pragma omp atomic write
+                pagerank[i] = i_pr;
+                if (out_degrees[i] == 0)
+                    local_leaked += i_pr;
+            }
+            partial_leaked[t] = local_leaked;
+            partial_norm[t] = local_norm;
+            #pragma omp barrier
+
+            #pragma omp single
+            {
+                double norm = 0.;
+                leaked = 0.;
+                for (int k = 0; k < threads; k++) {
+                    leaked += partial_leaked[k];
+                    norm += partial_norm[k];
+                }
+                iterations++;
+                done = (MAX_ITER > 0 && iterations >= MAX_ITER) || (CHECK_CONVERGENCE && sqrt(norm) <= epsilon);
+            }
+        }
+    }
+    printf("Total pagerank iterations: %d\n", iterations);
+
+    free(range_start);
+    free(partial_leaked);
+    free(partial_norm);
+    return pagerank;
+}
+
+struct adaptive_rows {
+    /*
+     * rows of the in-matrix that adaptive pagerank still computes. Row k belongs to node active[k] and
+     * holds its in-neighbours that were active at the last compaction, in cols[row_start[k]..row_start[k+1]);
+     * the in-neighbours frozen before it only add the constant frozen_sum[k] (sum of pr / out_degree)
+     */
+    int active_count;
+    int * active;
+    edge_t * row_start;
+    int * cols;
+    float * frozen_sum;
+    bool owns_cols; // before the first compaction the rows are the ones of the in-matrix
+};
+
+void adaptive_rows_init(struct adaptive_rows * rows, int ** graph, int * in_degrees, int nodes_count) {
+    rows->active_count = nodes_count;
+    rows->active = (int *) malloc(nodes_count * sizeof(int));
+    rows->row_start = (edge_t *) malloc((nodes_count + 1) * sizeof(edge_t));
+    rows->frozen_sum = (float *) malloc(nodes_count * sizeof(float));
+    if (rows->active == NULL || rows->row_start == NULL || rows->frozen_sum == NULL) {
+        printf("Could not allocate space for the adaptive rows.\n");
+        exit(1);
+    }
+    rows->cols = graph[0];
+    rows->owns_cols = false;
+    rows->row_start[0] = 0;
+    for (int i = 0; i < nodes_count; i++) {
+        rows->active[i] = i;
+        rows->row_start[i + 1] = rows->row_start[i] + in_degrees[i];
+        rows->frozen_sum[i] = 0.f;
+    }
+}
+
+void adaptive_rows_compact(struct adaptive_rows * rows, unsigned char * frozen, float * pagerank, int * out_degrees) {
+    /*
+     * drops the rows of the frozen nodes, and moves the in-neighbours frozen since the last compaction
+     * from the remaining rows into their frozen_sum. `pagerank` holds the (final) ranks of the frozen nodes
+     */
+    int count = rows->active_count;
+    int * kept = (int *) malloc((count + 1) * sizeof(int));
+    edge_t * new_start = (edge_t *) malloc((count + 1) * sizeof(edge_t));
+    if (kept == NULL || new_start == NULL) {
+        printf("Could not allocate space for the adaptive rows.\n");
+        exit(1);
+    }
+
+    // length of the compacted rows, the contributions of the frozen in-neighbours move to frozen_sum
+    #pragma omp parallel for schedule(guided)
+    for (int k = 0; k < count; k++) {
+        if (frozen[rows->active[k]]) {
+            kept[k] = -1;
+            continue;
+        }
+        double frozen_sum = rows->frozen_sum[k];
+        int length = 0;
+        for (edge_t e = rows->row_start[k]; e < rows->row_start[k + 1]; e++) {
+            int j = rows->cols[e];
+            if (frozen[j])
+                frozen_sum += pagerank[j] / out_degrees[j];
+            else
+                length++;
+        }
+        rows->frozen_sum[k] = frozen_sum;
+        kept[k] = length;
+    }
+
+    // positions of the kept rows (k is the old index of the row moved to `kept_count`)
+    int kept_count = 0;
+    new_start[0] = 0;
+    for (int k = 0; k < count; k++) {
+        if (kept[k] < 0)
+            continue;
+        new_start[kept_count + 1] = new_start[kept_count] + kept[k];
+        kept[kept_count++] = k;
+    }
+
+    int * new_active = (int *) malloc((kept_count > 0 ? kept_count : 1) * sizeof(int));
+    float * new_frozen_sum = (float *) malloc((kept_count > 0 ? kept_count : 1) * sizeof(float));
+    int * new_cols = (int *) malloc((new_start[kept_count] > 0 ? new_start[kept_count] : 1) * sizeof(int));
+    if (new_active == NULL || new_frozen_sum == NULL || new_cols == NULL) {
+        printf("Could not allocate space for the adaptive rows.\n");
+        exit(1);
+    }
+
+    #pragma omp parallel for schedule(guided)
+    for (int r = 0; r < kept_count; r++) {
+        int k = kept[r];
+        new_active[r] = rows->active[k];
+        new_frozen_sum[r] = rows->frozen_sum[k];
+        edge_t pos = new_start[r];
+        for (edge_t e = rows->row_start[k]; e < rows->row_start[k + 1]; e++)
+            if (!frozen[rows->cols[e]])
+                new_cols[pos++] = rows->cols[e];
+    }
+
+    free(rows->active);
+    free(rows->row_start);
+    free(rows->frozen_sum);
+    if (rows->owns_cols)
+        free(rows->cols);
+    free(kept);
+    rows->active_count = kept_count;
+    rows->active = new_active;
+    rows->row_start = new_start;
+    rows->frozen_sum = new_frozen_sum;
+    rows->cols = new_cols;
+    rows->owns_cols = true;
+}
+
+void adaptive_rows_free(struct adaptive_rows * rows) {
+    free(rows->active);
+    free(rows->row_start);
+    free(rows->frozen_sum);
+    if (rows->owns_cols)
+        free(rows->cols);
+}
+
+float * pagerank_custom_in_adaptive(int ** graph, int * in_degrees, int * out_degrees,
+                int leaves_count, int * leaves, int nodes_count, double epsilon) {
+    /*
+     * adaptive version of `pagerank_custom_in` (Kamvar, Haveliwala and Golub): a node whose rank changes
+     * by at most ADAPTIVE_TOLERANCE (relative) for ADAPTIVE_PERIOD iterations in a row is frozen, its rank
+     * is kept in both vectors and its row is no longer computed. Once ADAPTIVE_COMPACT_FRACTION of the
+     * active rows are frozen the rows are compacted (`adaptive_rows_compact`), so the frozen in-neighbours
+     * are neither read nor skipped anymore. The solve also ends when every node is frozen
+     */
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, nodes_count);
+    unsigned char * stable = (unsigned char *) calloc(nodes_count, sizeof(unsigned char));
+    unsigned char * frozen = (unsigned char *) calloc(nodes_count, sizeof(unsigned char));
+    if (stable == NULL || frozen == NULL) {
+        printf("Could not allocate space for the adaptive pagerank.\n");
+        exit(1);
+    }
+    struct adaptive_rows rows;
+    adaptive_rows_init(&rows, graph, in_degrees, nodes_count);
+
+    long long edges_count = rows.row_start[nodes_count], edge_work = 0;
+    int iterations = 0, compactions = 0, frozen_since = 0;
+    double norm;
+
+    do {
+        float leaked_pagerank = 0.;
+        for (int i = 0; i < leaves_count; i++)
+            leaked_pagerank += pagerank_old[leaves[i]];
+        leaked_pagerank = leaked_pagerank + (1 - leaked_pagerank) * (1 - DAMPENING);
+        float init_pagerank = leaked_pagerank / (float)nodes_count;
+
+        #pragma omp parallel for schedule(guided) reduction(+ : edge_work)
+        for (int k = 0; k < rows.active_count; k++) {
+            int i = rows.active[k];
+            if (frozen[i])
+                continue;
+            double sum = rows.frozen_sum[k];
+            for (edge_t e = rows.row_start[k]; e < rows.row_start[k + 1]; e++)
+                sum += pagerank_old[rows.cols[e]] / out_degrees[rows.cols[e]];
+            pagerank_new[i] = init_pagerank + DAMPENING * sum;
+            edge_work += rows.row_start[k + 1] - rows.row_start[k];
+        }
+
+        // nobody gathers in this loop, so the frozen ranks can be copied to the old vector
+        norm = 0.;
+        int newly_frozen = 0;
+        #pragma omp parallel for schedule(static) reduction(+ : norm, newly_frozen)
+        for (int k = 0; k < rows.active_count; k++) {
+            int i = rows.active[k];
+            if (frozen[i])
+                continue;
+            float change = fabsf(pagerank_new[i] - pagerank_old[i]);
+            norm += square(change);
+            stable[i] = change <= ADAPTIVE_TOLERANCE * pagerank_old[i] ? stable[i] + 1 : 0;
+            if (stable[i] >= ADAPTIVE_PERIOD) {
+                frozen[i] = 1;
+                pagerank_old[i] = pagerank_new[i];
+                newly_frozen++;
+            }
+        }
+        frozen_since += newly_frozen;
+
+        swap_pointers(&pagerank_old, &pagerank_new);
+        iterations++;
+
+        if (frozen_since > 0 && frozen_since >= ADAPTIVE_COMPACT_FRACTION * rows.active_count) {
+            adaptive_rows_compact(&rows, frozen, pagerank_old, out_degrees);
+            compactions++;
+            frozen_since = 0;
+        }
+    } while (rows.active_count > 0 && !(MAX_ITER > 0 && iterations >= MAX_ITER)
+                && !(CHECK_CONVERGENCE && sqrt(norm) <= epsilon));
+    printf("Total pagerank iterations: %d\n", iterations);
+    printf("Adaptive pagerank - %d compactions, %d active nodes at the end, %.2f sweeps of the graph\n",
+            compactions, rows.active_count, edges_count > 0 ? edge_work / (double) edges_count : 0.);
+
+    adaptive_rows_free(&rows);
+    free(stable);
+    free(frozen);
+    free(pagerank_new);
+    return pagerank_old;
+}
+
+float * pagerank_custom_in_compressed(struct custom_matrix_compressed * cgraph, int * in_degrees, int * out_degrees,
+                int leaves_count, int * leaves, double epsilon, bool parallel_for) {
+    // same as `pagerank_custom_in`, but the in-lists are decoded (see `compress_graph_in`)
+    // while the contributions are accumulated
+    int nodes_count = cgraph->nodes_count;
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, nodes_count);
+
+    int i, j;
+
+    int iterations = 0;
+
+    do {
+
+        float leaked_pagerank = 0.;
+        for (i = 0; i < leaves_count; i++) {
+            leaked_pagerank += pagerank_old[leaves[i]]; 
+        }
+        leaked_pagerank = leaked_pagerank + (1 - leaked_pagerank) * (1 - DAMPENING);
+        float init_pagerank = leaked_pagerank / (float)nodes_count;
+
+        #pragma omp parallel for if(parallel_for) schedule(guided) private(i,j) shared(out_degrees,cgraph,init_pagerank,nodes_count)
+        for (i = 0; i < nodes_count; i++) {
+            const unsigned char * p = &cgraph->data[cgraph->row_start[i]];
+            float i_pr = init_pagerank;
+            int from = i;
+            for (j = 0; j < in_degrees[i]; j++){
+                unsigned int code = decode_varint(&p);
+                from = j == 0 ? i + zigzag_decode(code) : from + (int) code;
+                i_pr += DAMPENING * pagerank_old[from] / out_degrees[from];
+            }
+            pagerank_new[i] = i_pr;
+        }
+
+        swap_pointers(&pagerank_old, &pagerank_new);
+        iterations++;
+        if (iterations > MAX_ITER) break;
+    } while (!(CHECK_CONVERGENCE && get_norm_difference(pagerank_old, pagerank_new, nodes_count, parallel_for) <= epsilon));
+    printf("Total pagerank iterations: %d\n", iterations);
+    swap_pointers(&pagerank_old, &pagerank_new);
+    return pagerank_new;
+}
+
+int ocl_extrapolate(cl_context context, cl_command_queue command_queue, cl_program program, cl_mem * ring_d, int ring_size,
+                int iterations, int extrapolation, cl_mem nodes_count_d) {
+    /*
+     * extrapolation stage of `pagerank_custom_in_ocl`, replaces the newest iterate in the ring by its
+     * extrapolation (as `extrapolate_quadratic` and `extrapolate_aitken` on the host). The work groups
+     * write their partial sums, which are added and turned into weights on the host.
+     * Returns 1 if the quadratic fit is singular (the iterate is kept)
+     */
+    size_t local_item_size, num_groups, global_item_size;
+    update_sizes(32, 256, &local_item_size, &global_item_size, &num_groups);
+    cl_int clStatus;
+    cl_mem sums_d = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 8 * num_groups * sizeof(double), NULL, &clStatus);
+    double * group_sums = (double *) malloc(8 * num_groups * sizeof(double));
+    cl_kernel kernel_combination = clCreateKernel(program, "linear_combination", &clStatus);
+    cl_mem newest = ring_d[iterations % ring_size];
+    cl_float weights[3];
+    int status = 0;
+
+    if (extrapolation == EXTRAP_QUADRATIC) {
+        cl_kernel kernel_sums = clCreateKernel(program, "extrapolation_sums_wg", &clStatus);
+        for (int k = 0; k < 4; k++)
+            clStatus = clSetKernelArg(kernel_sums, k, sizeof(cl_mem), (void *)&ring_d[(iterations - 3 + k) % ring_size]);
+        clStatus |= clSetKernelArg(kernel_sums, 4, sizeof(cl_mem), (void *)&sums_d);
+        clStatus |= clSetKernelArg(kernel_sums, 5, 8 * local_item_size * sizeof(double), NULL);
+        clStatus |= clSetKernelArg(kernel_sums, 6, sizeof(cl_mem), (void *)&nodes_count_d);
+        clStatus = clEnqueueNDRangeKernel(command_queue, kernel_sums, 1, NULL,
+                        &global_item_size, &local_item_size, 0, NULL, NULL);
+        clStatus = clEnqueueReadBuffer(command_queue, sums_d, CL_TRUE, 0,
+                        8 * num_groups * sizeof(double), group_sums, 0, NULL, NULL);
+        clReleaseKernel(kernel_sums);
+
+        double sums[8] = {0.}, w[3];
+        for (size_t g = 0; g < num_groups; g++)
+            for (int k = 0; k < 8; k++)
+                sums[k] += group_sums[8 * g + k];
+        status = quadratic_extrapolation_weights(sums, w);
+        for (int k = 0; k < 3; k++)
+            weights[k] = w[k];
+    } else {
+        cl_kernel kernel_aitken = clCreateKernel(program, "extrapolate_aitken_wg", &clStatus);
+        for (int k = 0; k < 3; k++)
+            clStatus = clSetKernelArg(kernel_aitken, k, sizeof(cl_mem), (void *)&ring_d[(iterations - 2 + k) % ring_size]);
+        clStatus |= clSetKernelArg(kernel_aitken, 3, sizeof(cl_mem), (void *)&sums_d);
+        clStatus |= clSetKernelArg(kernel_aitken, 4, 2 * local_item_size * sizeof(double), NULL);
+        clStatus |= clSetKernelArg(kernel_aitken, 5, sizeof(cl_mem), (void *)&nodes_count_d);
+        clStatus = clEnqueueNDRangeKernel(command_queue, kernel_aitken, 1, NULL,
+                        &global_item_size, &local_item_size, 0, NULL, NULL);
+        clStatus = clEnqueueReadBuffer(command_queue, sums_d, CL_TRUE, 0,
+                        2 * num_groups * sizeof(double), group_sums, 0, NULL, NULL);
+        clReleaseKernel(kernel_aitken);
+
+        // scale back to the sum of the iterate
+        double sum_before = 0., sum = 0.;
+        for (size_t g = 0; g < num_groups; g++) {
+            sum_before += group_sums[2 * g];
+            sum += group_sums[2 * g + 1];
+        }
+        weights[0] = 0.f;
+        weights[1] = 0.f;
+        weights[2] = sum_before / sum;
+    }
+
+    if (status == 0) {
+        cl_mem x1 = ring_d[(iterations - 2) % ring_size], x2 = ring_d[(iterations - 1) % ring_size];
+        clStatus  = clSetKernelArg(kernel_combination, 0, sizeof(cl_mem), (void *)&x1);
+        clStatus |= clSetKernelArg(kernel_combination, 1, sizeof(cl_mem), (void *)&x2);
+        clStatus |= clSetKernelArg(kernel_combination, 2, sizeof(cl_mem), (void *)&newest);
+        for (int k = 0; k < 3; k++)
+            clStatus |= clSetKernelArg(kernel_combination, 3 + k, sizeof(cl_float), (void *)&weights[k]);
+        clStatus |= clSetKernelArg(kernel_combination, 6, sizeof(cl_mem), (void *)&nodes_count_d);
+        clStatus = clEnqueueNDRangeKernel(command_queue, kernel_combination, 1, NULL,
+                        &global_item_size, &local_item_size, 0, NULL, NULL);
+        clFinish(command_queue);
+    }
+    clReleaseKernel(kernel_combination);
+    clReleaseMemObject(sums_d);
+    free(group_sums);
+    return status;
+}
+
 float * pagerank_custom_in_ocl(int ** graph, int * in_degrees, int * out_degrees,
-                int leaves_count, int * leaves, int nodes_count, int edges_count,
-                double epsilon, double * start_global, double * end_global, char * pr_step_kernel) {
-    // this function leverages the kernels implemented in `pr_custom_matrix_in.cl`
+                int leaves_count, int * leaves, int nodes_count, edge_t edges_count,
+                double epsilon, double * start_global, double * end_global, char * pr_step_kernel,
+                int extrapolation) {
+    /*
+     * this function leverages the kernels implemented in `pr_custom_matrix_in.cl`. The iterates rotate in
+     * a ring of `extrapolation_ring_size` buffers, and with an `extrapolation` method the newest one is
+     * extrapolated every EXTRAPOLATION_PERIOD iterations (`ocl_extrapolate`)
+     */
     bool expand_out_degrees = strstr(pr_step_kernel, "expand") != NULL;
     cl_command_queue command_queue;
     cl_context context;
@@ -125,7 +1214,7 @@ float * pagerank_custom_in_ocl(int ** graph, int * in_degrees, int * out_degrees
     cl_kernel kernel_norm_fin = clCreateKernel(program, "compute_norm_difference_fin", &clStatus);
 
     *start_global = omp_get_wtime();
-    int * CDF = (int *) malloc(nodes_count * sizeof(int));
+    edge_t * CDF = (edge_t *) malloc(nodes_count * sizeof(edge_t));
     start = omp_get_wtime();
     CDF[0] = 0;
     for (int i = 1; i < nodes_count; i++) {
@@ -154,11 +1243,11 @@ float * pagerank_custom_in_ocl(int ** graph, int * in_degrees, int * out_degrees
     cl_mem nodes_count_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
                                 sizeof(int), &nodes_count, &clStatus);
     cl_mem edges_count_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                sizeof(int), &edges_count, &clStatus);
-    cl_mem pagerank_old_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                sizeof(edge_t), &edges_count, &clStatus);
+    cl_mem pagerank_old_d = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
                                 nodes_count * sizeof(float), pagerank_old, &clStatus);
     cl_mem in_deg_CDF_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                nodes_count * sizeof(int), CDF, &clStatus);
+                                nodes_count * sizeof(edge_t), CDF, &clStatus);
     end = omp_get_wtime();
     printf("%s - Data transfer to GPU time: %.4f\n", pr_step_kernel, end - start);
 
@@ -189,6 +1278,12 @@ float * pagerank_custom_in_ocl(int ** graph, int * in_degrees, int * out_degrees
     cl_mem norm_d = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
                                 sizeof(float), NULL, &clStatus);
 
+    // the iterates kept for the extrapolation, the power iteration rotates through them
+    int ring_size = extrapolation_ring_size(extrapolation);
+    cl_mem ring_d[4] = {pagerank_old_d, pagerank_new_d, NULL, NULL};
+    for (int r = 2; r < ring_size; r++)
+        ring_d[r] = clCreateBuffer(context, CL_MEM_READ_WRITE, nodes_count * sizeof(float), NULL, &clStatus);
+
     // set constant arguments to kernels (cannot fix pageranks because pointers change during iterations, nor local mem)
     clStatus  = clSetKernelArg(kernel_leaked_pr, 0, sizeof(cl_mem), (void *)&leaves_count_d);
     clStatus |= clSetKernelArg(kernel_leaked_pr, 1, sizeof(cl_mem), (void *)&leaves_d);
@@ -204,12 +1299,16 @@ float * pagerank_custom_in_ocl(int ** graph, int * in_degrees, int * out_degrees
     float times_leaked_pr_kernel = 0.,
             times_pagerank_step_kernel = 0.,
             times_norm_wg_kernel = 0.,
-            times_norm_fin_kernel = 0.;
+            times_norm_fin_kernel = 0.,
+            times_extrapolation = 0.;
 
-    int iterations = 0;
+    int iterations = 0, since_extrapolation = 0, extrapolations = 0;
     float norm;
     start = omp_get_wtime();
     do {
+        pagerank_old_d = ring_d[iterations % ring_size];
+        pagerank_new_d = ring_d[(iterations + 1) % ring_size];
+
         // compute the pagerank that would be leaked in the next iteration
         update_sizes(kernel_leaked_pr_wg, kernel_leaked_pr_wi, &local_item_size, &global_item_size, &num_groups);
         clStatus |= clSetKernelArg(kernel_leaked_pr, 2, sizeof(cl_mem), (void *)&pagerank_old_d);
@@ -263,15 +1362,25 @@ float * pagerank_custom_in_ocl(int ** graph, int * in_degrees, int * out_degrees
         // check_status(clStatus, "reading value");
 
         iterations++;
-        ocl_swap_pointers(&pagerank_new_d, &pagerank_old_d);
+        since_extrapolation++;
+
+        // the iterates since the last extrapolation (included) are a power iteration sequence
+        if (extrapolation != EXTRAP_NONE && since_extrapolation >= EXTRAPOLATION_PERIOD
+                    && since_extrapolation >= ring_size - 1) {
+            double extrapolation_start = omp_get_wtime();
+            if (!ocl_extrapolate(context, command_queue, program, ring_d, ring_size, iterations, extrapolation,
+                        nodes_count_d))
+                extrapolations++;
+            since_extrapolation = 0;
+            times_extrapolation += omp_get_wtime() - extrapolation_start;
+        }
         if (iterations > MAX_ITER) break;
     } while (!(CHECK_CONVERGENCE && sqrt(norm) <= epsilon));
     end = omp_get_wtime();
     printf("Total number of iterations: %d\n", iterations);
 
-    // read the final data to CPU - read pagerank_old_d because we just swapped new and old,
-    // so the new values are actually in the _old vector
-    clEnqueueReadBuffer(command_queue, pagerank_old_d, CL_TRUE, 0, 
+    // read the final data to CPU, the newest iterate is the one after the last
+    clEnqueueReadBuffer(command_queue, ring_d[iterations % ring_size], CL_TRUE, 0,
                         nodes_count * sizeof(float), pagerank_new, 0, NULL, NULL);
     *end_global = omp_get_wtime();
 
@@ -280,8 +1389,14 @@ float * pagerank_custom_in_ocl(int ** graph, int * in_degrees, int * out_degrees
     printf("%s - Average time `Pagerank step kernel`: %.4f\n", pr_step_kernel, times_pagerank_step_kernel / iterations);
     printf("%s - Average time `Norm work group`: %.4f\n", pr_step_kernel, times_norm_wg_kernel / iterations);
     printf("%s - Average time `Norm final`: %.4f\n", pr_step_kernel, times_norm_fin_kernel / iterations);
+    if (extrapolation != EXTRAP_NONE)
+        printf("%s - %d extrapolations, total time: %.4f\n", pr_step_kernel, extrapolations, times_extrapolation);
     printf("%s - Average time per iteration: %.4f\n", pr_step_kernel, (end - start) / iterations);
     ocl_destroy(command_queue, context, program);
+    pagerank_old_d = ring_d[0];
+    pagerank_new_d = ring_d[1];
+    for (int r = 2; r < ring_size; r++)
+        clReleaseMemObject(ring_d[r]);
     ocl_release(13, graph_d,
             in_degrees_d,
             out_degrees_d,
@@ -296,4 +1411,252 @@ float * pagerank_custom_in_ocl(int ** graph, int * in_degrees, int * out_degrees
             wg_diffs_d,
             norm_d);
     return pagerank_new;
-}
\ No newline at end of file
+}
+void adaptive_rows_upload(cl_context context, struct adaptive_rows * rows, cl_mem * active_d, cl_mem * row_start_d,
+                cl_mem * cols_d, cl_mem * frozen_sum_d) {
+    // device copies of the active rows (at least one element each, the rows may all be gone)
+    cl_int clStatus;
+    int count = rows->active_count > 0 ? rows->active_count : 1;
+    edge_t edges = rows->row_start[rows->active_count] > 0 ? rows->row_start[rows->active_count] : 1;
+    *active_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                count * sizeof(int), rows->active, &clStatus);
+    *row_start_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                (rows->active_count + 1) * sizeof(edge_t), rows->row_start, &clStatus);
+    *cols_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                edges * sizeof(int), rows->cols, &clStatus);
+    *frozen_sum_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                count * sizeof(float), rows->frozen_sum, &clStatus);
+}
+
+float * pagerank_custom_in_ocl_adaptive(int ** graph, int * in_degrees, int * out_degrees,
+                int leaves_count, int * leaves, int nodes_count, double epsilon, double * start_global, double * end_global) {
+    /*
+     * OpenCL version of `pagerank_custom_in_adaptive`, with the kernels `pagerank_step_adaptive` and
+     * `adaptive_update` of `pr_custom_matrix_in.cl`. The leaked pagerank and the norm are computed by the
+     * kernels of `pagerank_custom_in_ocl`. The frozen counter is read back every iteration; the rows are
+     * compacted on the host (`adaptive_rows_compact`) and uploaded again
+     */
+    cl_command_queue command_queue;
+    cl_context context;
+    cl_program program;
+    cl_event event;
+
+    int status = ocl_init("kernels/pr_custom_matrix_in.cl", &command_queue, &context, &program);
+    if (status != 0) {
+        printf("Initialization failed. Exiting OCL computation...\n");
+        exit(1);
+    }
+
+    double start, end;
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, nodes_count);
+    unsigned char * frozen = (unsigned char *) calloc(nodes_count, sizeof(unsigned char));
+    if (frozen == NULL) {
+        printf("Could not allocate space for the adaptive pagerank.\n");
+        exit(1);
+    }
+    size_t local_item_size, num_groups, global_item_size;
+
+    // compile kernels
+    cl_int clStatus = 0;
+    cl_kernel kernel_leaked_pr = clCreateKernel(program, "compute_leaked_pagerank", &clStatus);
+    cl_kernel kernel_pagerank_step = clCreateKernel(program, "pagerank_step_adaptive", &clStatus);
+    cl_kernel kernel_update = clCreateKernel(program, "adaptive_update", &clStatus);
+    cl_kernel kernel_norm_wg = clCreateKernel(program, "compute_norm_difference_wg", &clStatus);
+    cl_kernel kernel_norm_fin = clCreateKernel(program, "compute_norm_difference_fin", &clStatus);
+
+    *start_global = omp_get_wtime();
+    struct adaptive_rows rows;
+    adaptive_rows_init(&rows, graph, in_degrees, nodes_count);
+    long long edges_count = rows.row_start[nodes_count], edge_work = 0;
+
+    // define parameters for executing the kernels (WI, WG)
+    int kernel_leaked_pr_wi = 1024, kernel_leaked_pr_wg = 1,
+            kernel_norm_wg_wi = 1024, kernel_norm_wg_wg = 32,
+            kernel_norm_fin_wi = 32, kernel_norm_fin_wg = 1,
+            kernel_pagerank_step_wi = 1024, kernel_pagerank_step_wg = 64;
+
+    // transfer all the required data to the GPU
+    start = omp_get_wtime();
+    cl_mem active_d, row_start_d, cols_d, frozen_sum_d;
+    adaptive_rows_upload(context, &rows, &active_d, &row_start_d, &cols_d, &frozen_sum_d);
+    cl_mem out_degrees_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                nodes_count * sizeof(int), out_degrees, &clStatus);
+    cl_mem leaves_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                (leaves_count > 0 ? leaves_count : 1) * sizeof(int), leaves, &clStatus);
+    cl_mem leaves_count_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                sizeof(int), &leaves_count, &clStatus);
+    cl_mem nodes_count_d = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                sizeof(int), &nodes_count, &clStatus);
+    cl_mem pagerank_old_d = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                nodes_count * sizeof(float), pagerank_old, &clStatus);
+    cl_mem stable_d = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                nodes_count * sizeof(unsigned char), frozen, &clStatus);
+    cl_mem frozen_d = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                nodes_count * sizeof(unsigned char), frozen, &clStatus);
+    end = omp_get_wtime();
+    printf("adaptive - Data transfer to GPU time: %.4f\n", end - start);
+
+    // allocate additional data we will need
+    int zero = 0;
+    cl_mem leaked_pr_d = clCreateBuffer(context, CL_MEM_READ_WRITE,
+                                sizeof(float), NULL, &clStatus);
+    cl_mem pagerank_new_d = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                nodes_count * sizeof(float), pagerank_old, &clStatus);
+    cl_mem wg_diffs_d = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+                                kernel_norm_wg_wg * sizeof(float), NULL, &clStatus);
+    cl_mem norm_d = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+                                sizeof(float), NULL, &clStatus);
+    cl_mem frozen_count_d = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                sizeof(int), &zero, &clStatus);
+
+    // set constant arguments to kernels (the rows change at every compaction)
+    float tolerance = ADAPTIVE_TOLERANCE;
+    int period = ADAPTIVE_PERIOD;
+    clStatus  = clSetKernelArg(kernel_leaked_pr, 0, sizeof(cl_mem), (void *)&leaves_count_d);
+    clStatus |= clSetKernelArg(kernel_leaked_pr, 1, sizeof(cl_mem), (void *)&leaves_d);
+
+    clStatus |= clSetKernelArg(kernel_pagerank_step, 4, sizeof(cl_mem), (void *)&frozen_d);
+    clStatus |= clSetKernelArg(kernel_pagerank_step, 5, sizeof(cl_mem), (void *)&out_degrees_d);
+    clStatus |= clSetKernelArg(kernel_pagerank_step, 9, sizeof(cl_mem), (void *)&nodes_count_d);
+
+    clStatus |= clSetKernelArg(kernel_update, 1, sizeof(cl_mem), (void *)&stable_d);
+    clStatus |= clSetKernelArg(kernel_update, 2, sizeof(cl_mem), (void *)&frozen_d);
+    clStatus |= clSetKernelArg(kernel_update, 5, sizeof(cl_mem), (void *)&frozen_count_d);
+    clStatus |= clSetKernelArg(kernel_update, 7, sizeof(cl_float), (void *)&tolerance);
+    clStatus |= clSetKernelArg(kernel_update, 8, sizeof(cl_int), (void *)&period);
+
+    // iterate the pagerank step
+    float times_leaked_pr_kernel = 0.,
+            times_pagerank_step_kernel = 0.,
+            times_update_kernel = 0.,
+            times_norm_kernels = 0.,
+            times_compaction = 0.;
+
+    int iterations = 0, compactions = 0, frozen_since = 0, newly_frozen;
+    float norm;
+    start = omp_get_wtime();
+    do {
+        // compute the pagerank that would be leaked in the next iteration
+        update_sizes(kernel_leaked_pr_wg, kernel_leaked_pr_wi, &local_item_size, &global_item_size, &num_groups);
+        clStatus |= clSetKernelArg(kernel_leaked_pr, 2, sizeof(cl_mem), (void *)&pagerank_old_d);
+        clStatus |= clSetKernelArg(kernel_leaked_pr, 3, sizeof(cl_mem), (void *)&leaked_pr_d);
+        clStatus |= clSetKernelArg(kernel_leaked_pr, 4, local_item_size * sizeof(float), NULL);
+        clStatus = clEnqueueNDRangeKernel(command_queue, kernel_leaked_pr, 1, NULL,
+                        &global_item_size, &local_item_size, 0, NULL, &event);
+        times_leaked_pr_kernel += print_ocl_time(event, command_queue, "leaked pagerank kernel");
+
+        // pagerank step on the active rows
+        update_sizes(kernel_pagerank_step_wg, kernel_pagerank_step_wi, &local_item_size, &global_item_size, &num_groups);
+        clStatus |= clSetKernelArg(kernel_pagerank_step, 0, sizeof(cl_mem), (void *)&active_d);
+        clStatus |= clSetKernelArg(kernel_pagerank_step, 1, sizeof(cl_mem), (void *)&row_start_d);
+        clStatus |= clSetKernelArg(kernel_pagerank_step, 2, sizeof(cl_mem), (void *)&cols_d);
+        clStatus |= clSetKernelArg(kernel_pagerank_step, 3, sizeof(cl_mem), (void *)&frozen_sum_d);
+        clStatus |= clSetKernelArg(kernel_pagerank_step, 6, sizeof(cl_mem), (void *)&pagerank_old_d);
+        clStatus |= clSetKernelArg(kernel_pagerank_step, 7, sizeof(cl_mem), (void *)&pagerank_new_d);
+        clStatus |= clSetKernelArg(kernel_pagerank_step, 8, sizeof(cl_mem), (void *)&leaked_pr_d);
+        clStatus |= clSetKernelArg(kernel_pagerank_step, 10, sizeof(cl_int), (void *)&rows.active_count);
+        clStatus = clEnqueueNDRangeKernel(command_queue, kernel_pagerank_step, 1, NULL,
+                        &global_item_size, &local_item_size, 0, NULL, &event);
+        times_pagerank_step_kernel += print_ocl_time(event, command_queue, "adaptive pagerank step kernel");
+        edge_work += rows.row_start[rows.active_count];
+
+        // the norm before the frozen ranks are copied to the old vector
+        update_sizes(kernel_norm_wg_wg, kernel_norm_wg_wi, &local_item_size, &global_item_size, &num_groups);
+        clStatus  = clSetKernelArg(kernel_norm_wg, 0, sizeof(cl_mem), (void *)&pagerank_old_d);
+        clStatus |= clSetKernelArg(kernel_norm_wg, 1, sizeof(cl_mem), (void *)&pagerank_new_d);
+        clStatus |= clSetKernelArg(kernel_norm_wg, 2, sizeof(cl_mem), (void *)&wg_diffs_d);
+        clStatus |= clSetKernelArg(kernel_norm_wg, 3, local_item_size * sizeof(float), NULL);
+        clStatus |= clSetKernelArg(kernel_norm_wg, 4, sizeof(cl_mem), (void *)&nodes_count_d);
+        clStatus = clEnqueueNDRangeKernel(command_queue, kernel_norm_wg, 1, NULL,
+                        &global_item_size, &local_item_size, 0, NULL, &event);
+        times_norm_kernels += print_ocl_time(event, command_queue, "norm step 1 kernel");
+
+        update_sizes(kernel_norm_fin_wg, kernel_norm_fin_wi, &local_item_size, &global_item_size, &num_groups);
+        clStatus  = clSetKernelArg(kernel_norm_fin, 0, sizeof(cl_mem), (void *)&wg_diffs_d);
+        clStatus |= clSetKernelArg(kernel_norm_fin, 1, sizeof(cl_mem), (void *)&norm_d);
+        clStatus |= clSetKernelArg(kernel_norm_fin, 2, local_item_size * sizeof(float), NULL);
+        clStatus |= clSetKernelArg(kernel_norm_fin, 3, sizeof(cl_int), &global_item_size);
+        clStatus = clEnqueueNDRangeKernel(command_queue, kernel_norm_fin, 1, NULL,
+                        &global_item_size, &local_item_size, 0, NULL, &event);
+        times_norm_kernels += print_ocl_time(event, command_queue, "norm final kernel");
+
+        // freeze the stable nodes
+        update_sizes(kernel_pagerank_step_wg, kernel_pagerank_step_wi, &local_item_size, &global_item_size, &num_groups);
+        clStatus  = clSetKernelArg(kernel_update, 0, sizeof(cl_mem), (void *)&active_d);
+        clStatus |= clSetKernelArg(kernel_update, 3, sizeof(cl_mem), (void *)&pagerank_old_d);
+        clStatus |= clSetKernelArg(kernel_update, 4, sizeof(cl_mem), (void *)&pagerank_new_d);
+        clStatus |= clSetKernelArg(kernel_update, 6, sizeof(cl_int), (void *)&rows.active_count);
+        clStatus = clEnqueueNDRangeKernel(command_queue, kernel_update, 1, NULL,
+                        &global_item_size, &local_item_size, 0, NULL, &event);
+        times_update_kernel += print_ocl_time(event, command_queue, "adaptive update kernel");
+
+        // read the norm and the frozen counter back to host
+        clStatus = clEnqueueReadBuffer(command_queue, norm_d, CL_TRUE, 0,
+                        1 * sizeof(float), &norm, 0, NULL, NULL);
+        clStatus = clEnqueueReadBuffer(command_queue, frozen_count_d, CL_TRUE, 0,
+                        sizeof(int), &newly_frozen, 0, NULL, NULL);
+        clStatus = clEnqueueWriteBuffer(command_queue, frozen_count_d, CL_TRUE, 0,
+                        sizeof(int), &zero, 0, NULL, NULL);
+        frozen_since += newly_frozen;
+
+        iterations++;
+        ocl_swap_pointers(&pagerank_new_d, &pagerank_old_d);
+
+        if (frozen_since > 0 && frozen_since >= ADAPTIVE_COMPACT_FRACTION * rows.active_count) {
+            double compaction_start = omp_get_wtime();
+            clEnqueueReadBuffer(command_queue, pagerank_old_d, CL_TRUE, 0,
+                        nodes_count * sizeof(float), pagerank_new, 0, NULL, NULL);
+            clEnqueueReadBuffer(command_queue, frozen_d, CL_TRUE, 0,
+                        nodes_count * sizeof(unsigned char), frozen, 0, NULL, NULL);
+            adaptive_rows_compact(&rows, frozen, pagerank_new, out_degrees);
+            clReleaseMemObject(active_d);
+            clReleaseMemObject(row_start_d);
+            clReleaseMemObject(cols_d);
+            clReleaseMemObject(frozen_sum_d);
+            adaptive_rows_upload(context, &rows, &active_d, &row_start_d, &cols_d, &frozen_sum_d);
+            times_compaction += omp_get_wtime() - compaction_start;
+            compactions++;
+            frozen_since = 0;
+        }
+    } while (rows.active_count > 0 && !(MAX_ITER > 0 && iterations >= MAX_ITER)
+                && !(CHECK_CONVERGENCE && sqrt(norm) <= epsilon));
+    end = omp_get_wtime();
+    printf("Total number of iterations: %d\n", iterations);
+    printf("adaptive - %d compactions, %d active nodes at the end, %.2f sweeps of the graph\n",
+            compactions, rows.active_count, edges_count > 0 ? edge_work / (double) edges_count : 0.);
+
+    // the new values are in the _old vector after the swap
+    clEnqueueReadBuffer(command_queue, pagerank_old_d, CL_TRUE, 0,
+                        nodes_count * sizeof(float), pagerank_new, 0, NULL, NULL);
+    *end_global = omp_get_wtime();
+
+    // print average times of the kernels
+    printf("adaptive - Average time `Leaked pagerank kernel`: %.4f\n", times_leaked_pr_kernel / iterations);
+    printf("adaptive - Average time `Pagerank step kernel`: %.4f\n", times_pagerank_step_kernel / iterations);
+    printf("adaptive - Average time `Adaptive update kernel`: %.4f\n", times_update_kernel / iterations);
+    printf("adaptive - Average time `Norm kernels`: %.4f\n", times_norm_kernels / iterations);
+    printf("adaptive - Total compaction time (host): %.4f\n", times_compaction);
+    printf("adaptive - Average time per iteration: %.4f\n", (end - start) / iterations);
+    ocl_destroy(command_queue, context, program);
+    ocl_release(16, active_d,
+            row_start_d,
+            cols_d,
+            frozen_sum_d,
+            out_degrees_d,
+            leaves_d,
+            leaves_count_d,
+            nodes_count_d,
+            pagerank_old_d,
+            stable_d,
+            frozen_d,
+            leaked_pr_d,
+            pagerank_new_d,
+            wg_diffs_d,
+            norm_d,
+            frozen_count_d);
+    adaptive_rows_free(&rows);
+    free(frozen);
+    free(pagerank_old);
+    return pagerank_new;
+}
@@ -0,0 +1,298 @@
+#ifndef PAGERANK_SPARSE_CPU
+#define PAGERANK_SPARSE_CPU
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "../global_config.h"
+#include "../readers/mtx_sparse.h"
+#include "../readers/mtx_hybrid.h"
+#include "../helpers/helper.h"
+#include "../helpers/simd_helper.h"
+
+/*
+ * CPU counterparts of the OCL matrix implementations in pagerank_OCL.h: every iteration
+ * computes vout = DAMPENING * M * vin + (1 - DAMPENING) / n, and the result is normalized
+ * at the end (which is equivalent to redistributing the pagerank of the leaves)
+ */
+
+float * scaled_rank_alloc(int nodes_count) {
+    // PATTERN_ONLY input of the products, the extra last entry is the 0 read by padding elements
+    if(!PATTERN_ONLY)
+        return NULL;
+    float * scaled = (float *) malloc((nodes_count + 1) * sizeof(float));
+    if(scaled == NULL) {
+        printf("Could not allocate space for the scaled pagerank.\n");
+        exit(1);
+    }
+    scaled[nodes_count] = 0.0f;
+    return scaled;
+}
+
+void scale_rank(float * scaled, float * pagerank, float * col_scale, int nodes_count) {
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < nodes_count; j++)
+        scaled[j] = pagerank[j] * col_scale[j];
+}
+
+int sparse_iteration_done(float * pagerank_old, float * pagerank_new, int nodes_count, int iterations) {
+    if (MAX_ITER > 0 && iterations >= MAX_ITER)
+        return 1;
+    return CHECK_CONVERGENCE && get_norm_difference(pagerank_old, pagerank_new, nodes_count, true) <= EPSILON;
+}
+
+void normalize_pagerank(float * pagerank, int nodes_count) {
+    double sum = 0.;
+    for (int i = 0; i < nodes_count; i++)
+        sum += pagerank[i];
+    for (int i = 0; i < nodes_count; i++)
+        pagerank[i] /= sum;
+}
+
+float * pagerank_CSR_cpu(mtx_CSR mCSR) {
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, mCSR.num_rows);
+    float adjustment = (1 - DAMPENING) / (float) mCSR.num_rows;
+    float * scaled = scaled_rank_alloc(mCSR.num_cols);
+    int iterations = 0;
+
+    double start = omp_get_wtime();
+    do {
+        if (PATTERN_ONLY)
+            scale_rank(scaled, pagerank_old, mCSR.col_scale, mCSR.num_cols);
+        // rows are summed by the gather kernels selected by `simd_init`
+        #pragma omp parallel for schedule(guided)
+        for (int i = 0; i < mCSR.num_rows; i++) {
+            edge_t begin = mCSR.rowptr[i];
+            float sum = PATTERN_ONLY ? gather.sum(&mCSR.col[begin], scaled, mCSR.rowptr[i+1] - begin)
+                    : gather.dot(&mCSR.col[begin], &mCSR.data[begin], pagerank_old, mCSR.rowptr[i+1] - begin);
+            pagerank_new[i] = DAMPENING * sum + adjustment;
+        }
+        swap_pointers(&pagerank_old, &pagerank_new);
+        iterations++;
+    } while (!sparse_iteration_done(pagerank_old, pagerank_new, mCSR.num_rows, iterations));
+    double end = omp_get_wtime();
+
+    printf("Total number of iterations: %d\n", iterations);
+    printf("CSR CPU (%s) average time per iteration: %f\n", simd_names[gather.level], (end - start) / iterations);
+    printf("CSR CPU matrix bandwidth: %.2f GB/s\n", mtx_CSR_bytes(&mCSR) * iterations / (end - start) / 1e9);
+    normalize_pagerank(pagerank_old, mCSR.num_rows);
+    free(pagerank_new);
+    free(scaled);
+    return pagerank_old;
+}
+
+float * pagerank_SELL_cpu(mtx_SELL mSELL) {
+    /*
+     * every chunk is processed by one thread: the lanes of a chunk are consecutive in memory
+     * for every column, so the inner loop over the lanes is vectorized (gathering from vin)
+     */
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, mSELL.num_rows);
+    float adjustment = (1 - DAMPENING) / (float) mSELL.num_rows;
+    int C = mSELL.chunk_size;
+    float * scaled = scaled_rank_alloc(mSELL.num_cols);
+    int iterations = 0;
+
+    double start = omp_get_wtime();
+    do {
+        if (PATTERN_ONLY)
+            scale_rank(scaled, pagerank_old, mSELL.col_scale, mSELL.num_cols);
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (int c = 0; c < mSELL.num_chunks; c++) {
+            float sums[C];
+            const int * col = &mSELL.col[mSELL.chunk_ptr[c]];
+            const int * rows = &mSELL.row_ind[(long long) c * C];
+            for (int lane = 0; lane < C; lane++)
+                sums[lane] = 0.0f;
+            if (PATTERN_ONLY) {
+                for (int j = 0; j < mSELL.chunk_width[c]; j++) {
+                    #pragma omp simd
+                    for (int lane = 0; lane < C; lane++)
+                        sums[lane] += scaled[col[j * C + lane]];
+                }
+            } else {
+                const float * data = &mSELL.data[mSELL.chunk_ptr[c]];
+                for (int j = 0; j < mSELL.chunk_width[c]; j++) {
+                    #pragma omp simd
+                    for (int lane = 0; lane < C; lane++)
+                        sums[lane] += data[j * C + lane] * pagerank_old[col[j * C + lane]];
+                }
+            }
+            for (int lane = 0; lane < C; lane++)
+                if (rows[lane] >= 0)
+                    pagerank_new[rows[lane]] = DAMPENING * sums[lane] + adjustment;
+        }
+        swap_pointers(&pagerank_old, &pagerank_new);
+        iterations++;
+    } while (!sparse_iteration_done(pagerank_old, pagerank_new, mSELL.num_rows, iterations));
+    double end = omp_get_wtime();
+
+    printf("Total number of iterations: %d\n", iterations);
+    printf("SELL-%d-%d CPU average time per iteration: %f\n", mSELL.chunk_size, mSELL.sigma, (end - start) / iterations);
+    normalize_pagerank(pagerank_old, mSELL.num_rows);
+    free(pagerank_new);
+    free(scaled);
+    return pagerank_old;
+}
+
+float * pagerank_HYB_cpu(mtx_HYB mHYB) {
+    /*
+     * the ELL part is processed in blocks of rows: for every ELL column the rows of a block are consecutive
+     * in memory, so the inner loop is vectorized. The COO part is split into one interval per thread, as in
+     * the mCOOtail kernel: rows that start and end inside an interval are added directly, the first and last
+     * row of every interval (which may continue in the neighbouring intervals) after the parallel region
+     */
+    mtx_ELL mELL = mHYB.ell;
+    int nodes_count = mELL.num_rows;
+    const int block_size = 256;
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, nodes_count);
+    float adjustment = (1 - DAMPENING) / (float) nodes_count;
+    float * scaled = scaled_rank_alloc(mELL.num_cols);
+    int intervals = omp_get_max_threads();
+    int * carry_row = (int *) malloc(2 * intervals * sizeof(int));
+    float * carry_val = (float *) malloc(2 * intervals * sizeof(float));
+    if (carry_row == NULL || carry_val == NULL) {
+        printf("Could not allocate space for the COO carries.\n");
+        exit(1);
+    }
+    int iterations = 0;
+
+    double start = omp_get_wtime();
+    do {
+        if (PATTERN_ONLY)
+            scale_rank(scaled, pagerank_old, mHYB.col_scale, mELL.num_cols);
+        const float * vin = PATTERN_ONLY ? scaled : pagerank_old;
+
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(static)
+            for (int block = 0; block < nodes_count; block += block_size) {
+                int block_end = block + block_size < nodes_count ? block + block_size : nodes_count;
+                for (int i = block; i < block_end; i++)
+                    pagerank_new[i] = 0.0f;
+                for (int j = 0; j < mELL.num_elementsinrow; j++) {
+                    const int * col = &mELL.col[(long long) j * nodes_count];
+                    if (PATTERN_ONLY) {
+                        #pragma omp simd
+                        for (int i = block; i < block_end; i++)
+                            pagerank_new[i] += vin[col[i]];
+                    } else {
+                        const float * data = &mELL.data[(long long) j * nodes_count];
+                        #pragma omp simd
+                        for (int i = block; i < block_end; i++)
+                            pagerank_new[i] += data[i] * vin[col[i]];
+                    }
+                }
+            }
+
+            // one interval per iteration, so that every interval is added whatever team OpenMP provides
+            #pragma omp for schedule(static, 1)
+            for (int t = 0; t < intervals; t++) {
+                edge_t begin = (long long) mHYB.coo_nonzeros * t / intervals;
+                edge_t end = (long long) mHYB.coo_nonzeros * (t + 1) / intervals;
+                carry_row[2*t] = carry_row[2*t + 1] = -1;
+                if (begin < end) {
+                    int first_row = mHYB.coo_row[begin];
+                    int current = first_row;
+                    float sum = 0.0f;
+                    for (edge_t idx = begin; idx < end; idx++) {
+                        if (mHYB.coo_row[idx] != current) {
+                            if (current == first_row)
+                                carry_val[2*t] = sum;
+                            else
+                                pagerank_new[current] += sum;
+                            current = mHYB.coo_row[idx];
+                            sum = 0.0f;
+                        }
+                        sum += PATTERN_ONLY ? vin[mHYB.coo_col[idx]] : mHYB.coo_data[idx] * vin[mHYB.coo_col[idx]];
+                    }
+                    carry_row[2*t] = first_row;
+                    if (current == first_row)
+                        carry_val[2*t] = sum;
+                    else {
+                        carry_row[2*t + 1] = current;
+                        carry_val[2*t + 1] = sum;
+                    }
+                }
+            }
+        }
+        for (int k = 0; k < 2 * intervals; k++)
+            if (carry_row[k] >= 0)
+                pagerank_new[carry_row[k]] += carry_val[k];
+
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < nodes_count; i++)
+            pagerank_new[i] = DAMPENING * pagerank_new[i] + adjustment;
+        swap_pointers(&pagerank_old, &pagerank_new);
+        iterations++;
+    } while (!sparse_iteration_done(pagerank_old, pagerank_new, nodes_count, iterations));
+    double end = omp_get_wtime();
+
+    printf("Total number of iterations: %d\n", iterations);
+    printf("HYB CPU average time per iteration: %f\n", (end - start) / iterations);
+    normalize_pagerank(pagerank_old, nodes_count);
+    free(pagerank_new);
+    free(scaled);
+    free(carry_row);
+    free(carry_val);
+    return pagerank_old;
+}
+
+float * pagerank_BCSR_cpu(mtx_BCSR mBCSR) {
+    /*
+     * the column blocks are processed one after the other, so the slice of the input vector read by
+     * a block (BCSR_BLOCK_COLS entries) stays in cache. The segments of a block belong to different
+     * rows and are split among the threads, each adds its partial sum to the row
+     */
+    int nodes_count = mBCSR.num_rows;
+    float *pagerank_old, *pagerank_new;
+    init_pagerank(&pagerank_old, &pagerank_new, nodes_count);
+    float adjustment = (1 - DAMPENING) / (float) nodes_count;
+    float * scaled = scaled_rank_alloc(mBCSR.num_cols);
+    int iterations = 0;
+
+    double start = omp_get_wtime();
+    do {
+        if (PATTERN_ONLY)
+            scale_rank(scaled, pagerank_old, mBCSR.col_scale, mBCSR.num_cols);
+        const float * vin = PATTERN_ONLY ? scaled : pagerank_old;
+
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(static)
+            for (int i = 0; i < nodes_count; i++)
+                pagerank_new[i] = 0.0f;
+
+            for (int b = 0; b < mBCSR.num_blocks; b++) {
+                const float * vin_block = &vin[(long long) b * BCSR_BLOCK_COLS];
+                #pragma omp for schedule(guided)
+                for (edge_t s = mBCSR.block_ptr[b]; s < mBCSR.block_ptr[b+1]; s++) {
+                    float sum = 0.0f;
+                    for (edge_t j = mBCSR.seg_ptr[s]; j < mBCSR.seg_ptr[s+1]; j++)
+                        sum += PATTERN_ONLY ? vin_block[mBCSR.col[j]] : mBCSR.data[j] * vin_block[mBCSR.col[j]];
+                    pagerank_new[mBCSR.seg_row[s]] += sum;
+                }
+            }
+
+            #pragma omp for schedule(static)
+            for (int i = 0; i < nodes_count; i++)
+                pagerank_new[i] = DAMPENING * pagerank_new[i] + adjustment;
+        }
+        swap_pointers(&pagerank_old, &pagerank_new);
+        iterations++;
+    } while (!sparse_iteration_done(pagerank_old, pagerank_new, nodes_count, iterations));
+    double end = omp_get_wtime();
+
+    printf("Total number of iterations: %d\n", iterations);
+    printf("BCSR CPU average time per iteration: %f\n", (end - start) / iterations);
+    printf("BCSR CPU matrix bandwidth: %.2f GB/s\n", mtx_BCSR_bytes(&mBCSR) * iterations / (end - start) / 1e9);
+    normalize_pagerank(pagerank_old, nodes_count);
+    free(pagerank_new);
+    free(scaled);
+    return pagerank_old;
+}
+
+#endif
@@ -0,0 +1,486 @@
+#ifndef COMPRESSED_GRAPH
+#define COMPRESSED_GRAPH
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "raw_graph.h"
+#include "../helpers/file_helper.h"
+#include "../global_config.h"
+#if ENABLE_GZIP
+#include <zlib.h>
+#endif
+#if ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+Gzip and zstd compressed graphs (prepared, SNAP or MatrixMarket) are read
+without decompressing them to disk. One thread decompresses the stream into a
+ring of DECOMPRESS_BUFFERS buffers, cut at line boundaries; all the other
+threads take the filled buffers in order and parse them, so decompression and
+parsing overlap. Every buffer yields its own array of arcs, which are
+concatenated in stream order at the end.
+*/
+
+#define COMPRESSION_NONE 0
+#define COMPRESSION_GZIP 1
+#define COMPRESSION_ZSTD 2
+
+struct decompressor
+{
+    int type;
+#if ENABLE_GZIP
+    gzFile gz;
+#endif
+#if ENABLE_ZSTD
+    FILE *fp;
+    ZSTD_DCtx *dctx;
+    ZSTD_inBuffer in;
+    char *in_data;
+    size_t in_capacity;
+    int in_eof;         // the whole file was read
+    size_t status;      // of the last ZSTD_decompressStream call, 0 once a frame is complete and flushed
+#endif
+};
+
+struct ring_slot
+{
+    char *data;     // DECOMPRESS_BUFFER_SIZE + 1 bytes, complete lines only
+    size_t begin;   // first byte to parse (after the header, for the first buffer)
+    size_t len;
+    int full;
+};
+
+struct parsed_piece  // arcs parsed from buffer `seq`
+{
+    long long seq;
+    long long *pairs;
+    long long count;
+};
+
+
+int get_compression(char * file_name) {
+    // detects the compression of `file_name` from its magic number
+    unsigned char magic[4] = {0};
+    FILE * fp = fopen(file_name, "rb");
+    if (fp == NULL)
+        return COMPRESSION_NONE;
+    size_t n = fread(magic, 1, sizeof(magic), fp);
+    fclose(fp);
+
+    if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        return COMPRESSION_GZIP;
+    if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+        return COMPRESSION_ZSTD;
+    return COMPRESSION_NONE;
+}
+
+int open_decompressor(struct decompressor * d, char * file_name, int type) {
+    // returns 1 upon failure (also if the support for `type` was not compiled in)
+    d->type = type;
+#if ENABLE_GZIP
+    if (type == COMPRESSION_GZIP) {
+        d->gz = gzopen(file_name, "rb");
+        if (d->gz == NULL)
+            return 1;
+        gzbuffer(d->gz, 1 << 20);
+        return 0;
+    }
+#endif
+#if ENABLE_ZSTD
+    if (type == COMPRESSION_ZSTD) {
+        d->fp = fopen(file_name, "rb");
+        if (d->fp == NULL)
+            return 1;
+        d->dctx = ZSTD_createDCtx();
+        d->in_capacity = ZSTD_DStreamInSize();
+        d->in_data = (char *) malloc(d->in_capacity);
+        d->in.src = d->in_data;
+        d->in.size = 0;
+        d->in.pos = 0;
+        d->in_eof = 0;
+        d->status = 1;
+        return 0;
+    }
+#endif
+    printf("ERROR: `%s` is compressed, but %s support is disabled in global_config.h\n", file_name,
+            type == COMPRESSION_GZIP ? "gzip (ENABLE_GZIP)" : "zstd (ENABLE_ZSTD)");
+    return 1;
+}
+
+long long decompress(struct decompressor * d, char * buffer, size_t capacity) {
+    // fills `buffer` with up to `capacity` bytes; returns the number of bytes (0 at the end), -1 upon failure
+    size_t filled = 0;
+#if ENABLE_GZIP
+    if (d->type == COMPRESSION_GZIP) {
+        while (filled < capacity) {
+            int n = gzread(d->gz, buffer + filled, capacity - filled);
+            if (n < 0) {
+                int error;
+                printf("ERROR while decompressing: %s\n", gzerror(d->gz, &error));
+                return -1;
+            }
+            if (n == 0) {
+                // end of the stream, gzread returns what it could decode of a truncated file
+                int error;
+                const char * message = gzerror(d->gz, &error);
+                if (error != Z_OK) {
+                    printf("ERROR while decompressing: %s\n", message);
+                    return -1;
+                }
+                break;
+            }
+            filled += n;
+        }
+    }
+#endif
+#if ENABLE_ZSTD
+    if (d->type == COMPRESSION_ZSTD) {
+        while (filled < capacity) {
+            if (d->in.pos == d->in.size && !d->in_eof) {
+                d->in.size = fread(d->in_data, 1, d->in_capacity, d->fp);
+                d->in.pos = 0;
+                if (ferror(d->fp)) {
+                    printf("ERROR while reading the compressed file\n");
+                    return -1;
+                }
+                d->in_eof = d->in.size == 0;
+            }
+            // once the input is over, the decoder is called without input until it has flushed everything
+            if (d->in_eof && d->status == 0)
+                break;
+            ZSTD_outBuffer out = {buffer, capacity, filled};
+            d->status = ZSTD_decompressStream(d->dctx, &out, &d->in);
+            if (ZSTD_isError(d->status)) {
+                printf("ERROR while decompressing: %s\n", ZSTD_getErrorName(d->status));
+                return -1;
+            }
+            if (d->in_eof && out.pos == filled) {
+                // no input and no progress: the last frame is incomplete
+                printf("ERROR while decompressing: the zstd stream is truncated\n");
+                return -1;
+            }
+            filled = out.pos;
+        }
+    }
+#endif
+    return filled;
+}
+
+void close_decompressor(struct decompressor * d) {
+#if ENABLE_GZIP
+    if (d->type == COMPRESSION_GZIP)
+        gzclose(d->gz);
+#endif
+#if ENABLE_ZSTD
+    if (d->type == COMPRESSION_ZSTD) {
+        ZSTD_freeDCtx(d->dctx);
+        free(d->in_data);
+        fclose(d->fp);
+    }
+#endif
+}
+
+int parse_stream_header(char * data, size_t len, int * format, long long * declared_nodes,
+            long long * declared_edges, int * undirected, size_t * body) {
+    /*
+        Parses the header of the decompressed graph, which is in the first buffer
+    `data`: detects the format and sets the number of nodes (-1 if the ids have
+    to be compacted), whether edges are undirected and where the edges start.
+        Returns 1 upon failure.
+    */
+    char * end = data + len;
+    *format = detect_format_from_text(data, len);
+    *declared_nodes = -1;
+    *declared_edges = -1;
+    *undirected = 0;
+    *body = 0;
+
+    if (*format == FORMAT_PREPARED) {
+        int ok0, ok1;
+        char * p = scan_int(data, end, declared_nodes, &ok0);
+        p = scan_int(p, end, declared_edges, &ok1);
+        if (!ok0 || !ok1 || *declared_nodes <= 0) {
+            printf("Error while reading first line...\n");
+            return 1;
+        }
+        *body = next_line(p, end) - data;
+    } else if (*format == FORMAT_MTX) {
+        struct edge_section section;
+        int sections_count;
+        if (find_mtx_sections(data, end, &section, &sections_count, declared_nodes))
+            return 1;
+        *undirected = section.undirected;
+        *body = section.begin - data;
+    } else if (*format == FORMAT_PAJEK) {
+        printf("ERROR: compressed Pajek files are not supported, decompress the file first\n");
+        return 1;
+    }
+    return 0;
+}
+
+long long parse_buffer(char * begin, char * end, int undirected, long long ** pairs) {
+    // parses the lines in [begin, end) as `parse_raw_sections` does for one chunk
+    long long lines = count_lines(begin, end) * (undirected ? 2 : 1);
+    *pairs = (long long *) malloc(2 * (lines > 0 ? lines : 1) * sizeof(long long));
+    long long valid = 0, from, to;
+    for (char * q = begin; q < end; ) {
+        char * line_end = next_line(q, end);
+        if (parse_raw_line(q, line_end, &from, &to) == 1) {
+            (*pairs)[2 * valid] = from;
+            (*pairs)[2 * valid + 1] = to;
+            valid++;
+            if (undirected && from != to) {
+                (*pairs)[2 * valid] = to;
+                (*pairs)[2 * valid + 1] = from;
+                valid++;
+            }
+        }
+        q = line_end;
+    }
+    return valid;
+}
+
+void parse_slot(struct ring_slot * slot, long long seq, int undirected, struct parsed_piece ** pieces,
+            long long * count, long long * capacity) {
+    // parses a filled slot into the next entry of `pieces`, which grows as needed
+    if (*count == *capacity) {
+        *capacity *= 2;
+        *pieces = (struct parsed_piece *) realloc(*pieces, *capacity * sizeof(struct parsed_piece));
+    }
+    (*pieces)[*count].seq = seq;
+    (*pieces)[*count].count = parse_buffer(slot->data + slot->begin, slot->data + slot->len, undirected,
+            &(*pieces)[*count].pairs);
+    (*count)++;
+}
+
+int read_compressed_edges(char * file_name, int compression, int *** edges, int ** out_degrees,
+            int ** in_degrees, int * nodes_count, edge_t * edges_count, long long ** node_ids) {
+    /*
+        Reads a gzip or zstd compressed graph and returns the same arrays as
+    `read_raw_edges` (`node_ids` is NULL for prepared edge lists).
+        Thread 0 decompresses, the other threads parse (at least one of them, so
+    two threads are requested even if OpenMP is limited to one). If OpenMP still
+    provides a single thread (OMP_THREAD_LIMIT, nested regions), it decompresses
+    and then parses every buffer itself.
+        Returns 1 upon failure.
+    */
+    double start = omp_get_wtime();
+    struct decompressor d;
+    if (open_decompressor(&d, file_name, compression)) {
+        printf("ERROR while reading graph `%s`\n", file_name);
+        return 1;
+    }
+
+    int threads = omp_get_max_threads() < 2 ? 2 : omp_get_max_threads();
+    struct ring_slot slots[DECOMPRESS_BUFFERS];
+    for (int i = 0; i < DECOMPRESS_BUFFERS; i++) {
+        slots[i].data = (char *) malloc(DECOMPRESS_BUFFER_SIZE + 1);
+        slots[i].full = 0;
+    }
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+    long long produced = 0, next = 0;
+    int done = 0, failed = 0;
+
+    int format = FORMAT_AUTO, undirected = 0;
+    long long declared_nodes = -1, declared_edges = -1;
+    long long decompressed_bytes = 0;
+    double decompress_time = 0, parse_time = 0;
+    struct parsed_piece ** thread_pieces = (struct parsed_piece **) calloc(threads, sizeof(struct parsed_piece *));
+    long long * thread_pieces_count = (long long *) calloc(threads, sizeof(long long));
+    int parsers = threads - 1;
+
+    #pragma omp parallel num_threads(threads) reduction(+:parse_time)
+    {
+        int t = omp_get_thread_num();
+        if (t == 0) {
+            // producer: fills the slots in order, moving the last incomplete line to the next buffer
+            int alone = omp_get_num_threads() < 2; // no consumer: parse every buffer right after filling it
+            parsers = alone ? 1 : omp_get_num_threads() - 1;
+            long long capacity = 16, count = 0;
+            struct parsed_piece * pieces = NULL;
+            if (alone)
+                pieces = (struct parsed_piece *) malloc(capacity * sizeof(struct parsed_piece));
+            char * carry = (char *) malloc(DECOMPRESS_BUFFER_SIZE);
+            size_t carry_len = 0;
+            int eof = 0;
+            for (long long seq = 0; !eof && !failed; seq++) {
+                struct ring_slot * slot = &slots[seq % DECOMPRESS_BUFFERS];
+                pthread_mutex_lock(&lock);
+                while (slot->full)
+                    pthread_cond_wait(&changed, &lock);
+                pthread_mutex_unlock(&lock);
+
+                double decompress_start = omp_get_wtime();
+                memcpy(slot->data, carry, carry_len);
+                size_t len = carry_len;
+                long long n = decompress(&d, slot->data + len, DECOMPRESS_BUFFER_SIZE - len);
+                if (n < 0) {
+                    failed = 1;
+                    break;
+                }
+                eof = n < (long long) (DECOMPRESS_BUFFER_SIZE - len);
+                len += n;
+                decompressed_bytes += n;
+
+                carry_len = 0;
+                if (!eof) {
+                    char * last_newline = slot->data + len - 1;
+                    while (last_newline >= slot->data && *last_newline != '\n')
+                        last_newline--;
+                    if (last_newline < slot->data) {
+                        printf("ERROR: line longer than DECOMPRESS_BUFFER_SIZE\n");
+                        failed = 1;
+                        break;
+                    }
+                    carry_len = slot->data + len - (last_newline + 1);
+                    memcpy(carry, last_newline + 1, carry_len);
+                    len -= carry_len;
+                }
+                slot->data[len] = '\0';
+                slot->len = len;
+                slot->begin = 0;
+                decompress_time += omp_get_wtime() - decompress_start;
+
+                if (seq == 0 && parse_stream_header(slot->data, len, &format, &declared_nodes, &declared_edges,
+                            &undirected, &slot->begin)) {
+                    failed = 1;
+                    break;
+                }
+
+                if (alone) {
+                    double parse_start = omp_get_wtime();
+                    parse_slot(slot, seq, undirected, &pieces, &count, &capacity);
+                    parse_time += omp_get_wtime() - parse_start;
+                    produced++;
+                    continue;
+                }
+                pthread_mutex_lock(&lock);
+                slot->full = 1;
+                produced++;
+                pthread_cond_broadcast(&changed);
+                pthread_mutex_unlock(&lock);
+            }
+            free(carry);
+            thread_pieces[0] = pieces;
+            thread_pieces_count[0] = count;
+
+            pthread_mutex_lock(&lock);
+            done = 1;
+            pthread_cond_broadcast(&changed);
+            pthread_mutex_unlock(&lock);
+        } else {
+            // consumers: take the filled slots in order and parse them
+            long long capacity = 16, count = 0;
+            struct parsed_piece * pieces = (struct parsed_piece *) malloc(capacity * sizeof(struct parsed_piece));
+            while (1) {
+                pthread_mutex_lock(&lock);
+                while (next >= produced && !done)
+                    pthread_cond_wait(&changed, &lock);
+                if (next >= produced || failed) {
+                    pthread_mutex_unlock(&lock);
+                    break;
+                }
+                long long seq = next++;
+                pthread_mutex_unlock(&lock);
+
+                double parse_start = omp_get_wtime();
+                struct ring_slot * slot = &slots[seq % DECOMPRESS_BUFFERS];
+                parse_slot(slot, seq, undirected, &pieces, &count, &capacity);
+                parse_time += omp_get_wtime() - parse_start;
+
+                pthread_mutex_lock(&lock);
+                slot->full = 0;
+                pthread_cond_broadcast(&changed);
+                pthread_mutex_unlock(&lock);
+            }
+            thread_pieces[t] = pieces;
+            thread_pieces_count[t] = count;
+        }
+    }
+    close_decompressor(&d);
+    for (int i = 0; i < DECOMPRESS_BUFFERS; i++)
+        free(slots[i].data);
+
+    // concatenate the pieces in stream order
+    struct parsed_piece * ordered = (struct parsed_piece *) calloc(produced + 1, sizeof(struct parsed_piece));
+    for (int t = 0; t < threads; t++) {
+        for (long long i = 0; i < thread_pieces_count[t]; i++)
+            ordered[thread_pieces[t][i].seq] = thread_pieces[t][i];
+        free(thread_pieces[t]);
+    }
+    free(thread_pieces);
+    free(thread_pieces_count);
+
+    long long * piece_offset = (long long *) calloc(produced + 1, sizeof(long long));
+    for (long long i = 0; i < produced; i++)
+        piece_offset[i + 1] = piece_offset[i] + ordered[i].count;
+    long long total = piece_offset[produced];
+    long long * pairs = failed ? NULL : (long long *) malloc(2 * (total > 0 ? total : 1) * sizeof(long long));
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long i = 0; i < produced; i++) {
+        if (pairs != NULL)
+            memcpy(&pairs[2 * piece_offset[i]], ordered[i].pairs, 2 * ordered[i].count * sizeof(long long));
+        free(ordered[i].pairs);
+    }
+    free(ordered);
+    free(piece_offset);
+
+    if (failed || pairs == NULL) {
+        free(pairs);
+        printf("ERROR while reading graph `%s`\n", file_name);
+        return 1;
+    }
+    if (format == FORMAT_PREPARED && total != declared_edges)
+        printf("WARNING: header states %lld edges, %lld were read\n", declared_edges, total);
+
+    int first_id = format == FORMAT_MTX ? 1 : 0;
+    if (build_raw_edges(pairs, total, declared_nodes, first_id, edges, out_degrees, in_degrees,
+                nodes_count, edges_count, node_ids))
+        return 1;
+
+    struct stat st;
+    stat(file_name, &st);
+    double elapsed = omp_get_wtime() - start;
+    printf("Decompressed %.1f MB into %.1f MB (%s) in %.4f s, parsed with %d threads (%.4f s per thread), "
+            "total %.4f s\n", st.st_size / 1e6, decompressed_bytes / 1e6, graph_format_name(format),
+            decompress_time, parsers, parse_time / parsers, elapsed);
+    return 0;
+}
+
+int read_graph_edges(char * file_name, int *** edges, int ** out_degrees, int ** in_degrees,
+            int * nodes_count, edge_t * edges_count, long long ** node_ids) {
+    /*
+        Reads the graph in `file_name`, in any of the supported formats (see
+    `raw_graph.h`), possibly compressed, and returns the arrays described in
+    `read_edges`. For raw formats `node_ids` receives the original id of every
+    node; it is set to NULL for prepared edge lists (where the ids are already
+    0..n-1). `node_ids` may be NULL if the ids are not needed.
+        Returns 1 upon failure.
+    */
+    int compression = get_compression(file_name);
+    int format = compression == COMPRESSION_NONE ? detect_graph_format(file_name) : FORMAT_AUTO;
+    long long * ids = NULL;
+    int status;
+    if (compression != COMPRESSION_NONE)
+        status = read_compressed_edges(file_name, compression, edges, out_degrees, in_degrees,
+                nodes_count, edges_count, &ids);
+    else if (format == FORMAT_PREPARED)
+        status = read_edges(file_name, edges, out_degrees, in_degrees, nodes_count, edges_count);
+    else
+        status = read_raw_edges(file_name, format, edges, out_degrees, in_degrees, nodes_count, edges_count, &ids);
+
+    if (node_ids != NULL)
+        *node_ids = ids;
+    else
+        free(ids);
+    return status;
+}
+
+#endif
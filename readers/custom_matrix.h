@@ -1,6 +1,11 @@
+#ifndef CUSTOM_MATRIX
+#define CUSTOM_MATRIX
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <omp.h>
+#include "../helpers/file_helper.h"
 
 void print_custom_matrix(int ** graph, int nodes_count) {
     for(int i = 0; i < nodes_count; i++) {
@@ -13,8 +18,128 @@ void print_custom_matrix(int ** graph, int nodes_count) {
     }
 }
 
+void balanced_ranges(int * range_start, int * weights, int nodes_count, long long total, int parts) {
+    // splits the nodes into `parts` ranges of about the same total weight (`total` is the sum of the weights)
+    int p = 1;
+    long long seen = 0;
+    range_start[0] = 0;
+    for (int i = 0; i < nodes_count && p < parts; i++) {
+        seen += weights[i];
+        while (p < parts && seen * parts >= total * p)
+            range_start[p++] = i + 1;
+    }
+    while (p <= parts)
+        range_start[p++] = nodes_count;
+}
+
+int find_range(int * range_start, int ranges, int node) {
+    // index of the range [range_start[r], range_start[r + 1]) containing `node`
+    int low = 0, high = ranges - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (range_start[middle] <= node)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    return low;
+}
+
+void scatter_range_pairs(int * pairs, edge_t * range_offset, int ranges, int ** graph, int * filled) {
+    // appends pairs[2 * p + 1] to the list of node pairs[2 * p], range by range: every
+    // range is scattered by a single thread, so the pairs of a node keep their order
+    #pragma omp parallel for schedule(static, 1)
+    for (int r = 0; r < ranges; r++) {
+        for (edge_t p = range_offset[r]; p < range_offset[r + 1]; p++) {
+            int key = pairs[2 * p];
+            graph[key][filled[key]++] = pairs[2 * p + 1];
+        }
+    }
+}
+
+edge_t prefix_sum_range_cursors(edge_t * cursors, edge_t * range_offset, int chunks, int ranges) {
+    // turns the per-chunk counts `cursors[chunk * ranges + range]` into write cursors: every
+    // range gets a segment starting at `range_offset[range]`, in which chunk `t` follows chunks 0..t-1
+    edge_t position = 0;
+    for (int r = 0; r < ranges; r++) {
+        range_offset[r] = position;
+        for (int t = 0; t < chunks; t++) {
+            edge_t count = cursors[(size_t) t * ranges + r];
+            cursors[(size_t) t * ranges + r] = position;
+            position += count;
+        }
+    }
+    range_offset[ranges] = position;
+    return position;
+}
+
+int scatter_edges(int ** edges, edge_t edges_count, int * degrees, int nodes_count, int key_column, int ** graph) {
+    /*
+    Appends edges[e][1 - key_column] to the list of node edges[e][key_column] for every
+    edge, keeping the edges of each node in input order (the result is the same as a serial
+    scatter). `degrees` are the lengths of the lists. The key nodes are split into one range
+    per thread with about the same number of edges, and the edge list into one chunk per thread:
+        1. every thread counts the edges of its chunk per range, and the counts are
+           prefix-summed so that each range gets a segment of a temporary array, in which
+           the edges of chunk `t` follow those of chunks 0..t-1;
+        2. every thread copies the edges of its chunk into the segments of their ranges;
+        3. every thread scatters the segment of its range into the lists of its nodes.
+    The temporary array takes two ints per edge, whatever the number of threads.
+    Return value: 0 if everything ok, 1 otherwise
+    */
+    int ranges = omp_get_max_threads();
+    edge_t * cursors = (edge_t *) calloc((size_t) ranges * ranges, sizeof(edge_t));
+    edge_t * range_offset = (edge_t *) malloc((ranges + 1) * sizeof(edge_t));
+    int * range_start = (int *) malloc((ranges + 1) * sizeof(int));
+    int * pairs = (int *) malloc(2 * (edges_count > 0 ? edges_count : 1) * sizeof(int));
+    int * filled = (int *) calloc(nodes_count > 0 ? nodes_count : 1, sizeof(int));
+    if (cursors == NULL || range_offset == NULL || range_start == NULL || pairs == NULL || filled == NULL) {
+        printf("Could not allocate space for the write cursors.\n");
+        free(cursors);
+        free(range_offset);
+        free(range_start);
+        free(pairs);
+        free(filled);
+        return 1;
+    }
+    int value_column = 1 - key_column;
+    balanced_ranges(range_start, degrees, nodes_count, edges_count, ranges);
+
+    // one chunk per iteration, so that every chunk is processed whatever team OpenMP provides
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < ranges; t++) {
+        edge_t begin = (long long) edges_count * t / ranges;
+        edge_t end = (long long) edges_count * (t + 1) / ranges;
+        edge_t * cursor = &cursors[(size_t) t * ranges];
+        for (edge_t e = begin; e < end; e++)
+            cursor[find_range(range_start, ranges, edges[e][key_column])]++;
+    }
+    prefix_sum_range_cursors(cursors, range_offset, ranges, ranges);
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < ranges; t++) {
+        edge_t begin = (long long) edges_count * t / ranges;
+        edge_t end = (long long) edges_count * (t + 1) / ranges;
+        edge_t * cursor = &cursors[(size_t) t * ranges];
+        for (edge_t e = begin; e < end; e++) {
+            int key = edges[e][key_column];
+            edge_t p = cursor[find_range(range_start, ranges, key)]++;
+            pairs[2 * p] = key;
+            pairs[2 * p + 1] = edges[e][value_column];
+        }
+    }
+    scatter_range_pairs(pairs, range_offset, ranges, graph, filled);
+
+    free(cursors);
+    free(range_offset);
+    free(range_start);
+    free(pairs);
+    free(filled);
+    return 0;
+}
+
 int format_graph_out(int ** edges, int * out_degrees, int * leaves_count, int ** leaves, 
-        int *** graph, int nodes_count, int edges_count) {
+        int *** graph, int nodes_count, edge_t edges_count) {
     /*
     Formats the edges contained in `edges` to the following format:
         [node]: neighbor1 | neighbor2 | ...
@@ -46,7 +171,8 @@ int format_graph_out(int ** edges, int * out_degrees, int * leaves_count, int **
     
     contiguous_space = (int*) malloc(edges_count * sizeof(int));
     *graph = (int**) malloc(nodes_count * sizeof(int *));
-    int CDF = 0, _leaves_count = 0;
+    edge_t CDF = 0;
+    int _leaves_count = 0;
 
     for (i = 0; i < nodes_count; i++) {
         if (out_degrees[i] == 0) {
@@ -55,24 +181,13 @@ int format_graph_out(int ** edges, int * out_degrees, int * leaves_count, int **
         }
         (*graph)[i] = &contiguous_space[CDF];
         CDF = CDF + out_degrees[i];
-        out_degrees[i] = 0;
     }
 
-    // int threads_count = omp_get_max_threads();
-    // printf("Running %d threads\n", threads_count);
-    // #pragma omp parallel for schedule(guided)
-    int from, to;
-    for (i = 0; i < edges_count; i++) {
-        from = edges[i][0];
-        to = edges[i][1];
-        (*graph)[from][out_degrees[from]] = to;
-        out_degrees[from]++;
-    }
-    return 0;
+    return scatter_edges(edges, edges_count, out_degrees, nodes_count, 0, *graph);
 }
 
 int format_graph_in(int ** edges, int * in_degrees, int * out_degrees, int * leaves_count, int ** leaves,
-        int *** graph, int nodes_count, int edges_count) {
+        int *** graph, int nodes_count, edge_t edges_count) {
     
     /*
     Formats the edges contained in `edges` to the following format:
@@ -106,7 +221,8 @@ int format_graph_in(int ** edges, int * in_degrees, int * out_degrees, int * lea
     
     contiguous_space = (int*) malloc(edges_count * sizeof(int));
     *graph = (int**) malloc(nodes_count * sizeof(int *));
-    int CDF = 0, _leaves_count = 0;
+    edge_t CDF = 0;
+    int _leaves_count = 0;
 
     for (i = 0; i < nodes_count; i++) {
         if (out_degrees[i] == 0) {
@@ -115,18 +231,356 @@ int format_graph_in(int ** edges, int * in_degrees, int * out_degrees, int * lea
         }
         (*graph)[i] = &contiguous_space[CDF];
         CDF = CDF + in_degrees[i];
-        in_degrees[i] = 0;
     }
 
-    // int threads_count = omp_get_max_threads();
-    // printf("Running %d threads\n", threads_count);
-    // #pragma omp parallel for schedule(guided)
-    int from, to;
-    for (i = 0; i < edges_count; i++) {
-        from = edges[i][0];
-        to = edges[i][1];
-        (*graph)[to][in_degrees[to]] = from;
-        in_degrees[to]++;
+    return scatter_edges(edges, edges_count, in_degrees, nodes_count, 1, *graph);
+}
+
+int node_compare(const void * a, const void * b) {
+    int n1 = *(int *) a;
+    int n2 = *(int *) b;
+    return (n1 > n2) - (n1 < n2);
+}
+
+void sort_graph_rows(int ** graph, int * degrees, int nodes_count) {
+    // sorts the neighbours of every node in increasing order. With sorted in-lists
+    // the custom matrix is exactly the CSR representation of the transposed graph
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < nodes_count; i++)
+        qsort(graph[i], degrees[i], sizeof(int), node_compare);
+}
+
+int format_graph_out_from_in(int ** graph_in, int * in_degrees, int * out_degrees,
+        int *** graph, int nodes_count, edge_t edges_count) {
+    /*
+    Builds the out-matrix (see `format_graph_out`) by transposing the in-matrix
+    produced by `format_graph_in`, so that the edge list is not needed anymore.
+    As in `scatter_edges`, the sources are split into one range per thread and the
+    in-lists into one chunk of destinations per thread: the edges of every chunk are
+    grouped by source range in a temporary array, chunks in order, and every thread
+    then fills the out-lists of its range. If the in-lists are sorted, the out-lists
+    are sorted as well.
+
+    Parameters:
+        - (in) graph_in, in_degrees, the in-matrix and the in-degrees of all nodes
+        - (in) out_degrees, array containing the number of outgoing edges for each node
+        - (out) graph, the structure where the final graph will be saved
+        - (in) nodes_count, edges_count
+    Return value: 0 if everything ok, 1 otherwise
+    */
+
+    int ranges = omp_get_max_threads();
+    int * contiguous_space = (int*) malloc((edges_count > 0 ? edges_count : 1) * sizeof(int));
+    *graph = (int**) malloc(nodes_count * sizeof(int *));
+    edge_t * cursors = (edge_t *) calloc((size_t) ranges * ranges, sizeof(edge_t));
+    edge_t * range_offset = (edge_t *) malloc((ranges + 1) * sizeof(edge_t));
+    int * range_start = (int *) malloc((ranges + 1) * sizeof(int));
+    int * chunk_start = (int *) malloc((ranges + 1) * sizeof(int));
+    int * pairs = (int *) malloc(2 * (edges_count > 0 ? edges_count : 1) * sizeof(int));
+    int * filled = (int *) calloc(nodes_count > 0 ? nodes_count : 1, sizeof(int));
+    int failed = 0;
+    if (contiguous_space == NULL || *graph == NULL || cursors == NULL || range_offset == NULL || range_start == NULL
+                || chunk_start == NULL || pairs == NULL || filled == NULL) {
+        printf("Could not allocate space for the out matrix.\n");
+        free(contiguous_space);
+        free(*graph);
+        *graph = NULL;
+        failed = 1;
+    }
+
+    if (!failed) {
+        edge_t CDF = 0;
+        for (int i = 0; i < nodes_count; i++) {
+            (*graph)[i] = &contiguous_space[CDF];
+            CDF = CDF + out_degrees[i];
+        }
+        balanced_ranges(range_start, out_degrees, nodes_count, edges_count, ranges);
+        balanced_ranges(chunk_start, in_degrees, nodes_count, edges_count, ranges);
+
+        // one chunk per iteration, so that every chunk is processed whatever team OpenMP provides
+        #pragma omp parallel for schedule(static, 1)
+        for (int t = 0; t < ranges; t++) {
+            edge_t * cursor = &cursors[(size_t) t * ranges];
+            for (int to = chunk_start[t]; to < chunk_start[t + 1]; to++)
+                for (int j = 0; j < in_degrees[to]; j++)
+                    cursor[find_range(range_start, ranges, graph_in[to][j])]++;
+        }
+        prefix_sum_range_cursors(cursors, range_offset, ranges, ranges);
+
+        #pragma omp parallel for schedule(static, 1)
+        for (int t = 0; t < ranges; t++) {
+            edge_t * cursor = &cursors[(size_t) t * ranges];
+            for (int to = chunk_start[t]; to < chunk_start[t + 1]; to++) {
+                for (int j = 0; j < in_degrees[to]; j++) {
+                    int from = graph_in[to][j];
+                    edge_t p = cursor[find_range(range_start, ranges, from)]++;
+                    pairs[2 * p] = from;
+                    pairs[2 * p + 1] = to;
+                }
+            }
+        }
+        scatter_range_pairs(pairs, range_offset, ranges, *graph, filled);
+    }
+
+    free(cursors);
+    free(range_offset);
+    free(range_start);
+    free(chunk_start);
+    free(pairs);
+    free(filled);
+    return failed;
+}
+
+int read_graph_in_streaming(char * file_name, int *** graph, edge_t ** offsets, int ** in_degrees,
+        int ** out_degrees, int * leaves_count, int ** leaves, int * nodes_count, edge_t * edges_count) {
+    /*
+    Builds the in-matrix (see `format_graph_in`) directly from the edge list in
+    `file_name`, without ever holding the whole edge list in memory:
+        1. the mapped file is split in one chunk per thread, and every thread counts
+           the in-degrees of the edges in its chunk (out-degrees are counted atomically);
+        2. the per-thread counts are turned into per-thread write cursors, so that
+           in the second pass every thread scatters the tails of its edges straight
+           into their final position.
+    Since chunk `t` precedes chunk `t + 1` in the file, the in-lists are in file
+    order, i.e. identical to `read_edges` + `format_graph_in`. Peak memory is the
+    final matrix plus one in-degree histogram per chunk: the chunks are capped at
+    the average degree (from the header), so the histograms never take more than
+    the matrix itself.
+
+    Parameters:
+        - (in) file_name, edge list in the format described in `read_edges`
+        - (out) graph, in_degrees, out_degrees, leaves_count, leaves, as in `format_graph_in`
+        - (out) offsets, `nodes_count + 1` entries stating where each in-list starts in `graph[0]`
+        - (out) nodes_count, edges_count
+    Return value: 0 if everything ok, 1 otherwise
+    */
+
+    size_t file_size;
+    char * body;
+    long long header[2];
+    char * data = map_edge_list(file_name, &file_size, &body, header);
+    if (data == NULL)
+        return 1;
+    int n = header[0];
+    *nodes_count = n;
+
+    int threads = omp_get_max_threads();
+    long long average_degree = n > 0 ? header[1] / n : 0;
+    if (threads > average_degree)
+        threads = average_degree > 1 ? (int) average_degree : 1;
+    char ** chunk_start = (char **) malloc((threads + 1) * sizeof(char *));
+    int * cursors = (int *) calloc((size_t) threads * n, sizeof(int));
+    *in_degrees = (int *) malloc(n * sizeof(int));
+    *out_degrees = (int *) calloc(n, sizeof(int));
+    *offsets = (edge_t *) malloc((n + 1) * sizeof(edge_t));
+    if (chunk_start == NULL || (cursors == NULL && n > 0) || *in_degrees == NULL || *out_degrees == NULL
+                || *offsets == NULL) {
+        printf("Could not allocate space for the in-degree histograms.\n");
+        free(chunk_start);
+        free(cursors);
+        free(*in_degrees);
+        free(*out_degrees);
+        free(*offsets);
+        unmap_file(data, file_size);
+        return 1;
+    }
+    split_in_chunks(body, data + file_size, threads, chunk_start);
+
+    // pass 1: per-chunk in-degree histograms (one chunk per thread, whatever team OpenMP provides)
+    #pragma omp parallel for num_threads(threads) schedule(static, 1)
+    for (int t = 0; t < threads; t++) {
+        int * histogram = &cursors[(size_t) t * n];
+        int from, to;
+        char * q = chunk_start[t], * chunk_end = chunk_start[t + 1];
+        while (q < chunk_end) {
+            char * line_end = next_line(q, chunk_end);
+            if (parse_edge_line(q, line_end, n, &from, &to, 1) == 1) {
+                histogram[to]++;
+                #pragma omp atomic
+                (*out_degrees)[from]++;
+            }
+            q = line_end;
+        }
     }
+
+    // turn the histograms into exclusive per-chunk cursors
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++) {
+        int sum = 0;
+        for (int t = 0; t < threads; t++) {
+            int count = cursors[(size_t) t * n + i];
+            cursors[(size_t) t * n + i] = sum;
+            sum += count;
+        }
+        (*in_degrees)[i] = sum;
+    }
+
+    (*offsets)[0] = 0;
+    for (int i = 0; i < n; i++)
+        (*offsets)[i + 1] = (*offsets)[i] + (*in_degrees)[i];
+    *edges_count = (*offsets)[n];
+    if (*edges_count != header[1])
+        printf("WARNING: header states %lld edges, %lld were read\n", header[1], (long long) *edges_count);
+
+    int * contiguous_space = (int *) malloc((*edges_count > 0 ? *edges_count : 1) * sizeof(int));
+    *graph = (int **) malloc(n * sizeof(int *));
+    if (contiguous_space == NULL || *graph == NULL) {
+        printf("Could not allocate space for the in matrix.\n");
+        free(contiguous_space);
+        free(*graph);
+        free(cursors);
+        free(chunk_start);
+        unmap_file(data, file_size);
+        return 1;
+    }
+    for (int i = 0; i < n; i++)
+        (*graph)[i] = &contiguous_space[(*offsets)[i]];
+
+    // pass 2: scatter the edges (invalid lines were already reported in pass 1)
+    #pragma omp parallel for num_threads(threads) schedule(static, 1)
+    for (int t = 0; t < threads; t++) {
+        int * my_cursor = &cursors[(size_t) t * n];
+        int from, to;
+        char * q = chunk_start[t], * chunk_end = chunk_start[t + 1];
+        while (q < chunk_end) {
+            char * line_end = next_line(q, chunk_end);
+            if (parse_edge_line(q, line_end, n, &from, &to, 0) == 1)
+                (*graph)[to][my_cursor[to]++] = from;
+            q = line_end;
+        }
+    }
+    free(cursors);
+
+    // leaves
+    *leaves_count = 0;
+    for (int i = 0; i < n; i++)
+        *leaves_count += (*out_degrees)[i] == 0;
+    *leaves = (int *) malloc(*leaves_count * sizeof(int));
+    int _leaves_count = 0;
+    for (int i = 0; i < n; i++)
+        if ((*out_degrees)[i] == 0)
+            (*leaves)[_leaves_count++] = i;
+
+    unmap_file(data, file_size);
+    free(chunk_start);
     return 0;
 }
+
+/*
+ * COMPRESSED IN-MATRIX
+ */
+
+struct custom_matrix_compressed  // in-matrix with gap-encoded, varint-compressed rows
+{
+    unsigned char *data;
+    long long *row_start;   // nodes_count + 1 byte offsets in `data`
+    int nodes_count;
+    edge_t edges_count;
+    long long size;         // bytes used by `data`
+};
+
+typedef struct custom_matrix_compressed custom_matrix_compressed;
+
+int varint_size(unsigned int value) {
+    int size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+unsigned char * encode_varint(unsigned char * p, unsigned int value) {
+    // LEB128: 7 bits per byte, the high bit states that more bytes follow
+    while (value >= 0x80) {
+        *p++ = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (unsigned char) value;
+    return p;
+}
+
+static inline unsigned int decode_varint(const unsigned char ** p) {
+    const unsigned char * q = *p;
+    unsigned int value = *q++;
+    if (value >= 0x80) { // multi-byte values are rare with gap encoding
+        value &= 0x7f;
+        int shift = 7;
+        unsigned int byte;
+        do {
+            byte = *q++;
+            value |= (byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte >= 0x80);
+    }
+    *p = q;
+    return value;
+}
+
+static inline unsigned int zigzag_encode(int value) {
+    return ((unsigned int) value << 1) ^ (unsigned int) (value >> 31);
+}
+
+static inline int zigzag_decode(unsigned int value) {
+    return (int) (value >> 1) ^ -(int) (value & 1);
+}
+
+unsigned int compressed_row_code(int node, int * row, int j) {
+    // the first neighbour is stored relative to the node itself (zig-zag encoded, since
+    // it can be smaller), the following ones as gaps from the previous neighbour
+    return j == 0 ? zigzag_encode(row[0] - node) : (unsigned int) (row[j] - row[j - 1]);
+}
+
+int compress_graph_in(struct custom_matrix_compressed * cgraph, int ** graph, int * in_degrees,
+        int nodes_count, edge_t edges_count) {
+    /*
+    Compresses the in-matrix `graph`, whose rows must be sorted (see `sort_graph_rows`),
+    in the spirit of WebGraph: every row is stored as a list of gaps between consecutive
+    neighbours, and every gap as a byte-aligned varint. On web graphs most gaps fit
+    in one byte, so the matrix takes 1-2 bytes per edge instead of 4.
+    Rows are encoded in parallel: a first pass computes the size of every row, a
+    second one writes them at the offsets obtained by prefix summing the sizes.
+    Return value: 0 if everything ok, 1 otherwise
+    */
+    cgraph->nodes_count = nodes_count;
+    cgraph->edges_count = edges_count;
+    cgraph->row_start = (long long *) malloc((nodes_count + 1) * sizeof(long long));
+    if (cgraph->row_start == NULL) {
+        printf("Could not allocate space for the compressed matrix.\n");
+        return 1;
+    }
+
+    cgraph->row_start[0] = 0;
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < nodes_count; i++) {
+        long long row_size = 0;
+        for (int j = 0; j < in_degrees[i]; j++)
+            row_size += varint_size(compressed_row_code(i, graph[i], j));
+        cgraph->row_start[i + 1] = row_size;
+    }
+    for (int i = 0; i < nodes_count; i++)
+        cgraph->row_start[i + 1] += cgraph->row_start[i];
+    cgraph->size = cgraph->row_start[nodes_count];
+
+    cgraph->data = (unsigned char *) malloc(cgraph->size > 0 ? cgraph->size : 1);
+    if (cgraph->data == NULL) {
+        printf("Could not allocate space for the compressed matrix.\n");
+        free(cgraph->row_start);
+        return 1;
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < nodes_count; i++) {
+        unsigned char * p = &cgraph->data[cgraph->row_start[i]];
+        for (int j = 0; j < in_degrees[i]; j++)
+            p = encode_varint(p, compressed_row_code(i, graph[i], j));
+    }
+    return 0;
+}
+
+void free_compressed_graph(struct custom_matrix_compressed * cgraph) {
+    free(cgraph->data);
+    free(cgraph->row_start);
+}
+
+#endif
@@ -0,0 +1,355 @@
+#ifndef GRAPH_CACHE
+#define GRAPH_CACHE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "custom_matrix.h"
+#include "compressed_graph.h"
+#include "../helpers/file_helper.h"
+#include "../global_config.h"
+
+/*
+The first time a graph is read, the formatted in-matrix (with sorted in-lists,
+i.e. the CSR representation of the transposed graph) is written to a binary
+file `<graph_file>.cache`. Later runs map that file and use the arrays in place,
+so neither the text parsing nor the formatting has to be repeated.
+
+File layout (all integers little endian, every section aligned to 64 bytes):
+    header | offsets (nodes + 1) | in_neighbors (edges) | in_degrees (nodes)
+           | out_degrees (nodes) | leaves (leaves_count) | node_ids (ids_count)
+Offsets are `edge_t` (64-bit with LARGE_GRAPHS), the header records their size
+and the INPUT_FORMAT the source was parsed with.
+`node_ids` (64-bit) is only present for graphs read from raw formats.
+*/
+
+#define GRAPH_CACHE_MAGIC 0x48434750    // "PGCH"
+#define GRAPH_CACHE_VERSION 4
+#define GRAPH_CACHE_ALIGN 64
+#define GRAPH_CACHE_SAMPLE (64 * 1024)  // bytes hashed at the beginning and at the end of the source
+
+struct graph_cache_header
+{
+    unsigned int magic;
+    unsigned short version;
+    unsigned short offset_size;    // sizeof(edge_t) of the writer
+    unsigned long long source_hash;
+    long long nodes_count;
+    long long edges_count;
+    long long leaves_count;
+    long long ids_count;    // 0 or nodes_count
+    int input_format;       // INPUT_FORMAT of the writer, the same file parses differently under another format
+    char padding[GRAPH_CACHE_ALIGN - 52];
+};
+
+struct graph_cache  // arrays point inside the mapped file
+{
+    int nodes_count;
+    edge_t edges_count;
+    int leaves_count;
+    edge_t *offsets;
+    int *in_neighbors;
+    int *in_degrees;
+    int *out_degrees;
+    int *leaves;
+    long long *node_ids;    // NULL if the ids are 0..n-1
+    char *mapping;
+    size_t mapping_size;
+};
+
+typedef struct graph_cache graph_cache;
+
+
+unsigned long long fnv1a(unsigned long long hash, const void * data, size_t len) {
+    const unsigned char * bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < len; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    return hash;
+}
+
+int hash_source_file(char * file_name, unsigned long long * hash) {
+    /*
+    Fingerprints the source graph: FNV-1a over its size, its modification time
+    and its first and last GRAPH_CACHE_SAMPLE bytes. Hashing the whole file would
+    cost as much as parsing it, which is exactly what the cache avoids.
+    Returns 1 if the file cannot be read.
+    */
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    char * sample = (char *) malloc(GRAPH_CACHE_SAMPLE);
+    unsigned long long h = 14695981039346656037ULL;
+    long long size = st.st_size;
+    long long mtime_ns = (long long) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    h = fnv1a(h, &size, sizeof(size));
+    h = fnv1a(h, &mtime_ns, sizeof(mtime_ns));
+
+    ssize_t n = pread(fd, sample, GRAPH_CACHE_SAMPLE, 0);
+    if (n > 0)
+        h = fnv1a(h, sample, n);
+    if (size > GRAPH_CACHE_SAMPLE) {
+        n = pread(fd, sample, GRAPH_CACHE_SAMPLE, size - GRAPH_CACHE_SAMPLE);
+        if (n > 0)
+            h = fnv1a(h, sample, n);
+    }
+
+    free(sample);
+    close(fd);
+    *hash = h;
+    return 0;
+}
+
+void get_cache_file_name(char * file_name, char * cache_name, size_t len) {
+    snprintf(cache_name, len, "%s.cache", file_name);
+}
+
+size_t cache_section_size(long long count, size_t element_size) {
+    // size of an array, padded to GRAPH_CACHE_ALIGN
+    size_t size = count * element_size;
+    return (size + GRAPH_CACHE_ALIGN - 1) / GRAPH_CACHE_ALIGN * GRAPH_CACHE_ALIGN;
+}
+
+int load_graph_cache(char * file_name, struct graph_cache * gc) {
+    /*
+    Maps the cache of `file_name` and points the arrays in `gc` inside the mapping.
+    The mapping is private and writable (copy on write), so callers may modify
+    the arrays without touching the file.
+    Returns 0 on a cache hit, 1 if the cache is missing, stale or corrupted.
+    */
+    char cache_name[4096];
+    get_cache_file_name(file_name, cache_name, sizeof(cache_name));
+
+    unsigned long long source_hash;
+    if (hash_source_file(file_name, &source_hash))
+        return 1;
+
+    int fd = open(cache_name, O_RDONLY);
+    if (fd < 0)
+        return 1;
+
+    struct stat st;
+    struct graph_cache_header header;
+    if (fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+        close(fd);
+        return 1;
+    }
+
+    if (header.magic != GRAPH_CACHE_MAGIC || header.version != GRAPH_CACHE_VERSION
+            || header.offset_size != sizeof(edge_t)) {
+        printf("Ignoring graph cache `%s` (unknown format or version, or other LARGE_GRAPHS mode)\n", cache_name);
+        close(fd);
+        return 1;
+    }
+    if (header.input_format != INPUT_FORMAT) {
+        printf("Ignoring graph cache `%s` (written with another INPUT_FORMAT)\n", cache_name);
+        close(fd);
+        return 1;
+    }
+    if (header.source_hash != source_hash) {
+        printf("Ignoring graph cache `%s` (source graph has changed)\n", cache_name);
+        close(fd);
+        return 1;
+    }
+
+    size_t expected_size = sizeof(header)
+        + cache_section_size(header.nodes_count + 1, sizeof(edge_t))
+        + cache_section_size(header.edges_count, sizeof(int))
+        + 2 * cache_section_size(header.nodes_count, sizeof(int))
+        + cache_section_size(header.leaves_count, sizeof(int))
+        + cache_section_size(header.ids_count, sizeof(long long));
+    if ((size_t) st.st_size != expected_size) {
+        printf("Ignoring graph cache `%s` (truncated file)\n", cache_name);
+        close(fd);
+        return 1;
+    }
+
+    char * data = (char *) mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 1;
+
+    gc->mapping = data;
+    gc->mapping_size = st.st_size;
+    gc->nodes_count = header.nodes_count;
+    gc->edges_count = header.edges_count;
+    gc->leaves_count = header.leaves_count;
+
+    char * p = data + sizeof(header);
+    gc->offsets = (edge_t *) p;
+    p += cache_section_size(header.nodes_count + 1, sizeof(edge_t));
+    gc->in_neighbors = (int *) p;
+    p += cache_section_size(header.edges_count, sizeof(int));
+    gc->in_degrees = (int *) p;
+    p += cache_section_size(header.nodes_count, sizeof(int));
+    gc->out_degrees = (int *) p;
+    p += cache_section_size(header.nodes_count, sizeof(int));
+    gc->leaves = (int *) p;
+    p += cache_section_size(header.leaves_count, sizeof(int));
+    gc->node_ids = header.ids_count > 0 ? (long long *) p : NULL;
+    return 0;
+}
+
+int write_section(FILE * fp, void * data, long long count, size_t element_size) {
+    static const char zeros[GRAPH_CACHE_ALIGN] = {0};
+    size_t size = count * element_size;
+    size_t padding = cache_section_size(count, element_size) - size;
+    return fwrite(data, 1, size, fp) != size || fwrite(zeros, 1, padding, fp) != padding;
+}
+
+int write_graph_cache(char * file_name, int ** graph, edge_t * offsets, int * in_degrees, int * out_degrees,
+            int leaves_count, int * leaves, long long * node_ids, int nodes_count, edge_t edges_count) {
+    /*
+    Writes the in-matrix `graph` (contiguous, with sorted rows) to the cache of
+    `file_name`. The file is written under a temporary name and then renamed, so
+    concurrent jobs never map a half-written cache.
+    Returns 1 upon failure (the caller can simply continue without the cache).
+    */
+    char cache_name[4096], tmp_name[4200];
+    get_cache_file_name(file_name, cache_name, sizeof(cache_name));
+    snprintf(tmp_name, sizeof(tmp_name), "%s.%d.tmp", cache_name, (int) getpid());
+
+    struct graph_cache_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = GRAPH_CACHE_MAGIC;
+    header.version = GRAPH_CACHE_VERSION;
+    header.offset_size = sizeof(edge_t);
+    header.nodes_count = nodes_count;
+    header.edges_count = edges_count;
+    header.leaves_count = leaves_count;
+    header.ids_count = node_ids != NULL ? nodes_count : 0;
+    header.input_format = INPUT_FORMAT;
+    if (hash_source_file(file_name, &header.source_hash))
+        return 1;
+
+    FILE * fp = fopen(tmp_name, "wb");
+    if (fp == NULL) {
+        printf("Could not write graph cache `%s`\n", tmp_name);
+        return 1;
+    }
+
+    int status = fwrite(&header, sizeof(header), 1, fp) != 1;
+    status |= write_section(fp, offsets, nodes_count + 1, sizeof(edge_t));
+    status |= write_section(fp, edges_count > 0 ? graph[0] : NULL, edges_count, sizeof(int));
+    status |= write_section(fp, in_degrees, nodes_count, sizeof(int));
+    status |= write_section(fp, out_degrees, nodes_count, sizeof(int));
+    status |= write_section(fp, leaves, leaves_count, sizeof(int));
+    status |= write_section(fp, node_ids, header.ids_count, sizeof(long long));
+    status |= fclose(fp) != 0;
+
+    if (status || rename(tmp_name, cache_name) != 0) {
+        printf("Could not write graph cache `%s`\n", cache_name);
+        unlink(tmp_name);
+        return 1;
+    }
+    return 0;
+}
+
+void free_graph_cache(struct graph_cache * gc) {
+    munmap(gc->mapping, gc->mapping_size);
+}
+
+int load_graph(char * file_name, int *** graph, edge_t ** offsets, int ** in_degrees, int ** out_degrees,
+            int * leaves_count, int ** leaves, long long ** node_ids, int * nodes_count, edge_t * edges_count,
+            int * mapped) {
+    /*
+    Returns the in-matrix of the graph in `file_name` (see `format_graph_in`), with
+    sorted in-lists. `offsets` contains `nodes_count + 1` entries and states where
+    the in-list of each node starts in the contiguous space `graph[0]`. The graph
+    may be in any of the formats in `raw_graph.h`, possibly compressed; `node_ids` receives the original
+    node ids (NULL for prepared edge lists), it may be NULL if they are not needed.
+    If USE_GRAPH_CACHE is enabled, the matrix is taken from the binary cache when it
+    is valid, and the cache is (re)written otherwise. With a cache hit, all the
+    arrays but `graph` itself point inside the mapped cache, which is never unmapped, and
+    `mapped` is set to 1 (0 if the arrays were allocated).
+    Return value: 0 if everything ok, 1 otherwise
+    */
+    double start = omp_get_wtime();
+    *mapped = 0;
+
+    struct graph_cache gc;
+    if (USE_GRAPH_CACHE && load_graph_cache(file_name, &gc) == 0) {
+        *nodes_count = gc.nodes_count;
+        *edges_count = gc.edges_count;
+        *leaves_count = gc.leaves_count;
+        *offsets = gc.offsets;
+        *in_degrees = gc.in_degrees;
+        *out_degrees = gc.out_degrees;
+        *leaves = gc.leaves;
+        *mapped = 1;
+        if (node_ids != NULL)
+            *node_ids = gc.node_ids;
+
+        // only the row pointers are built, the edges stay in the mapping
+        *graph = (int **) malloc(gc.nodes_count * sizeof(int *));
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < gc.nodes_count; i++)
+            (*graph)[i] = &gc.in_neighbors[gc.offsets[i]];
+
+        printf("Matrix reading time (graph cache): %.4f\n", omp_get_wtime() - start);
+        return 0;
+    }
+
+    long long * ids = NULL;
+    int streaming = STREAMING_INGEST && get_compression(file_name) == COMPRESSION_NONE
+            && detect_graph_format(file_name) == FORMAT_PREPARED;
+    if (STREAMING_INGEST && !streaming)
+        printf("Streaming ingestion needs an uncompressed prepared edge list, reading the graph in memory\n");
+
+    if (streaming) {
+        // two passes over the file, the edge list is never materialized
+        if (read_graph_in_streaming(file_name, graph, offsets, in_degrees, out_degrees, leaves_count, leaves,
+                    nodes_count, edges_count))
+            return 1;
+        printf("Matrix reading time (streaming): %.4f\n", omp_get_wtime() - start);
+
+        start = omp_get_wtime();
+        sort_graph_rows(*graph, *in_degrees, *nodes_count);
+        printf("Matrix formatting time: %.4f\n", omp_get_wtime() - start);
+    } else {
+        int ** edges;
+        if (read_graph_edges(file_name, &edges, out_degrees, in_degrees, nodes_count, edges_count, &ids))
+            return 1;
+        printf("Matrix reading time: %.4f\n", omp_get_wtime() - start);
+
+        start = omp_get_wtime();
+        if (format_graph_in(edges, *in_degrees, *out_degrees, leaves_count, leaves, graph, *nodes_count, *edges_count))
+            return 1;
+        sort_graph_rows(*graph, *in_degrees, *nodes_count);
+        if (*edges_count > 0)
+            free(edges[0]); // contiguous space allocated by `read_edges`
+        free(edges);
+
+        *offsets = (edge_t *) malloc((*nodes_count + 1) * sizeof(edge_t));
+        (*offsets)[0] = 0;
+        for (int i = 0; i < *nodes_count; i++)
+            (*offsets)[i + 1] = (*offsets)[i] + (*in_degrees)[i];
+        printf("Matrix formatting time: %.4f\n", omp_get_wtime() - start);
+    }
+
+    if (USE_GRAPH_CACHE) {
+        start = omp_get_wtime();
+        if (write_graph_cache(file_name, *graph, *offsets, *in_degrees, *out_degrees,
+                    *leaves_count, *leaves, ids, *nodes_count, *edges_count) == 0)
+            printf("Graph cache writing time: %.4f\n", omp_get_wtime() - start);
+    }
+
+    if (node_ids != NULL)
+        *node_ids = ids;
+    else
+        free(ids);
+    return 0;
+}
+
+#endif
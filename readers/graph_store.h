@@ -0,0 +1,289 @@
+#ifndef GRAPH_STORE
+#define GRAPH_STORE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "graph_cache.h"
+#include "reorder_graph.h"
+#include "mtx_hybrid.h"
+#include "../helpers/file_helper.h"
+#include "../global_config.h"
+
+struct graph_store {
+    // in-matrix as returned by `load_graph` (relabelled if REORDER_STRATEGY is set)
+    int ** in;
+    edge_t * offsets;
+    int * in_degrees;
+    int * out_degrees;
+    int * leaves;
+    int leaves_count;
+    int nodes_count;
+    edge_t edges_count;
+    long long * node_ids; // original ids, NULL for prepared graphs
+    int * order;          // original id of every node, NULL if not reordered
+    int in_mapped;        // the in-lists point inside the graph cache mapping
+
+    // representations derived from the in-matrix on first use, NULL until then
+    int ** out;
+    mtx_CSR * csr;
+    mtx_ELL * ell;
+    mtx_JDS * jds;
+    int * jds_dangling;
+    mtx_SELL * sell;
+    mtx_HYB * hyb;
+    mtx_BCSR * bcsr;
+    custom_matrix_compressed * compressed;
+};
+
+int graph_store_load(struct graph_store * g, char * file_name) {
+    /*
+    Reads the graph in `file_name` once (or maps it from the graph cache, see `load_graph`)
+    and applies REORDER_STRATEGY. Every other representation is then derived from the
+    in-matrix in memory by the graph_store_* getters, so the file is never read again.
+    Return value: 0 if everything ok, 1 otherwise
+    */
+    g->out = NULL;
+    g->csr = NULL;
+    g->ell = NULL;
+    g->jds = NULL;
+    g->jds_dangling = NULL;
+    g->sell = NULL;
+    g->hyb = NULL;
+    g->bcsr = NULL;
+    g->compressed = NULL;
+    g->order = NULL;
+
+    if (load_graph(file_name, &g->in, &g->offsets, &g->in_degrees, &g->out_degrees, &g->leaves_count,
+                &g->leaves, &g->node_ids, &g->nodes_count, &g->edges_count, &g->in_mapped))
+        return 1;
+
+    if (REORDER_STRATEGY != REORDER_NONE) {
+        if (reorder_graph(REORDER_STRATEGY, &g->in, &g->offsets, &g->in_degrees, &g->out_degrees, &g->leaves,
+                    g->leaves_count, g->nodes_count, g->edges_count, &g->order))
+            return 1;
+        g->in_mapped = 0; // the relabelled lists are allocated
+    }
+    return 0;
+}
+
+void graph_store_release_in(struct graph_store * g) {
+    /*
+    Releases the int in-lists, once the engines that run only need a representation derived
+    from them (e.g. the compressed matrix): allocated lists are freed, lists mapped from the
+    graph cache are dropped from memory (their pages are clean, they would be read back from
+    the cache file). The getters that derive from the in-matrix cannot be used afterwards
+    */
+    if (g->in == NULL)
+        return;
+    if (g->in_mapped) {
+        long page = sysconf(_SC_PAGESIZE);
+        char * begin = (char *) g->in[0], * end = begin + g->edges_count * sizeof(int);
+        begin = (char *) (((size_t) begin + page - 1) / page * page);
+        end = (char *) ((size_t) end / page * page);
+        if (end > begin)
+            madvise(begin, end - begin, MADV_DONTNEED);
+    } else if (g->nodes_count > 0) {
+        free(g->in[0]);
+    }
+    free(g->in);
+    g->in = NULL;
+}
+
+int ** graph_store_out(struct graph_store * g) {
+    // out-matrix (see `format_graph_out`), transposed from the in-matrix
+    if (g->out == NULL) {
+        double start = omp_get_wtime();
+        if (format_graph_out_from_in(g->in, g->in_degrees, g->out_degrees, &g->out, g->nodes_count, g->edges_count))
+            return NULL;
+        printf("Out-matrix formatting time: %.4f\n", omp_get_wtime() - start);
+    }
+    return g->out;
+}
+
+custom_matrix_compressed * graph_store_compressed(struct graph_store * g) {
+    // gap/varint-compressed in-matrix (see `compress_graph_in`), prints its size against the int lists
+    if (g->compressed == NULL) {
+        double start = omp_get_wtime();
+        g->compressed = (custom_matrix_compressed *) malloc(sizeof(custom_matrix_compressed));
+        if (g->compressed == NULL || compress_graph_in(g->compressed, g->in, g->in_degrees, g->nodes_count,
+                    g->edges_count)) {
+            free(g->compressed);
+            g->compressed = NULL;
+            return NULL;
+        }
+        printf("Compressed in-matrix formatting time: %.4f\n", omp_get_wtime() - start);
+        printf("Compressed in-lists size: %.1f MB (uncompressed %.1f MB, %.2f bytes per edge)\n",
+                g->compressed->size / 1e6, g->edges_count * sizeof(int) / 1e6,
+                g->edges_count > 0 ? (double) g->compressed->size / g->edges_count : 0.);
+    }
+    return g->compressed;
+}
+
+mtx_CSR * graph_store_csr(struct graph_store * g) {
+    // the in-matrix has sorted rows, so it already is the CSR matrix (only the values are computed)
+    if (g->csr == NULL) {
+        double start = omp_get_wtime();
+        g->csr = (mtx_CSR *) malloc(sizeof(mtx_CSR));
+        if (g->csr == NULL || get_CSR_from_custom_in(g->csr, g->in, g->offsets, g->out_degrees, g->nodes_count,
+                    g->edges_count)) {
+            free(g->csr);
+            g->csr = NULL;
+            return NULL;
+        }
+        printf("CSR formatting time: %.4f\n", omp_get_wtime() - start);
+    }
+    return g->csr;
+}
+
+mtx_ELL * graph_store_ell(struct graph_store * g) {
+    if (g->ell == NULL) {
+        mtx_CSR * csr = graph_store_csr(g);
+        if (csr == NULL)
+            return NULL;
+        double start = omp_get_wtime();
+        g->ell = (mtx_ELL *) malloc(sizeof(mtx_ELL));
+        if (g->ell == NULL || mtx_ELL_create_from_mtx_CSR(g->ell, csr)) {
+            free(g->ell);
+            g->ell = NULL;
+            return NULL;
+        }
+        printf("ELL formatting time: %.4f\n", omp_get_wtime() - start);
+    }
+    return g->ell;
+}
+
+mtx_JDS * graph_store_jds(struct graph_store * g, int max_pieces, long long memory_budget, long long max_piece_bytes) {
+    // pieces are chosen by `jds_choose_pieces`, the nodes without in-edges are returned in `g->jds_dangling`
+    if (g->jds == NULL) {
+        mtx_CSR * csr = graph_store_csr(g);
+        if (csr == NULL)
+            return NULL;
+        double start = omp_get_wtime();
+        g->jds = (mtx_JDS *) malloc(sizeof(mtx_JDS));
+        if (g->jds == NULL || mtx_JDS_create_from_mtx_CSR(g->jds, &g->jds_dangling, &max_pieces, csr, memory_budget,
+                    max_piece_bytes)) {
+            free(g->jds);
+            g->jds = NULL;
+            return NULL;
+        }
+        printf("JDS formatting time: %.4f\n", omp_get_wtime() - start);
+        mtx_JDS_print_stats(g->jds);
+    }
+    return g->jds;
+}
+
+mtx_SELL * graph_store_sell(struct graph_store * g) {
+    // SELL-C-sigma with SELL_C and SELL_SIGMA, prints its padding and memory against CSR
+    if (g->sell == NULL) {
+        mtx_CSR * csr = graph_store_csr(g);
+        if (csr == NULL)
+            return NULL;
+        double start = omp_get_wtime();
+        g->sell = (mtx_SELL *) malloc(sizeof(mtx_SELL));
+        if (g->sell == NULL || mtx_SELL_create_from_mtx_CSR(g->sell, csr, SELL_C, SELL_SIGMA)) {
+            free(g->sell);
+            g->sell = NULL;
+            return NULL;
+        }
+        printf("SELL-%d-%d formatting time: %.4f\n", SELL_C, SELL_SIGMA, omp_get_wtime() - start);
+        mtx_SELL_print_stats(g->sell);
+    }
+    return g->sell;
+}
+
+mtx_HYB * graph_store_hyb(struct graph_store * g) {
+    // ELL part with the width chosen by `hyb_choose_width`, the remaining entries in the COO tail
+    if (g->hyb == NULL) {
+        mtx_CSR * csr = graph_store_csr(g);
+        if (csr == NULL)
+            return NULL;
+        double start = omp_get_wtime();
+        int width = hyb_choose_width(csr);
+        g->hyb = (mtx_HYB *) malloc(sizeof(mtx_HYB));
+        if (g->hyb == NULL || width < 0 || mtx_HYB_create_from_mtx_CSR(g->hyb, csr, width)) {
+            free(g->hyb);
+            g->hyb = NULL;
+            return NULL;
+        }
+        printf("HYB formatting time: %.4f\n", omp_get_wtime() - start);
+        mtx_HYB_print_stats(g->hyb);
+    }
+    return g->hyb;
+}
+
+mtx_BCSR * graph_store_bcsr(struct graph_store * g) {
+    // column blocks of BCSR_BLOCK_COLS columns, prints the matrix traffic against CSR
+    if (g->bcsr == NULL) {
+        mtx_CSR * csr = graph_store_csr(g);
+        if (csr == NULL)
+            return NULL;
+        double start = omp_get_wtime();
+        g->bcsr = (mtx_BCSR *) malloc(sizeof(mtx_BCSR));
+        if (g->bcsr == NULL || mtx_BCSR_create_from_mtx_CSR(g->bcsr, csr)) {
+            free(g->bcsr);
+            g->bcsr = NULL;
+            return NULL;
+        }
+        printf("BCSR formatting time: %.4f\n", omp_get_wtime() - start);
+        mtx_BCSR_print_stats(g->bcsr);
+    }
+    return g->bcsr;
+}
+
+void graph_store_write_results(struct graph_store * g, char * file_name, float * pagerank) {
+    // writes per-node results (indexed like the in-matrix) with the original node ids
+    if (g->order != NULL)
+        pagerank = restore_order(pagerank, g->order, g->nodes_count);
+    write_results(file_name, pagerank, g->nodes_count, g->node_ids);
+    if (g->order != NULL)
+        free(pagerank);
+}
+
+void graph_store_free(struct graph_store * g) {
+    // frees the derived representations; the in-matrix may be mapped from the graph cache
+    if (g->out != NULL) {
+        free(g->out[0]);
+        free(g->out);
+    }
+    if (g->csr != NULL) {
+        mtx_CSR_free(g->csr);
+        free(g->csr);
+    }
+    if (g->ell != NULL) {
+        mtx_ELL_free(g->ell);
+        free(g->ell);
+    }
+    if (g->jds != NULL) {
+        mtx_JDS_free(g->jds);
+        free(g->jds);
+        free(g->jds_dangling);
+    }
+    if (g->sell != NULL) {
+        mtx_SELL_free(g->sell);
+        free(g->sell);
+    }
+    if (g->hyb != NULL) {
+        mtx_HYB_free(g->hyb);
+        free(g->hyb);
+    }
+    if (g->bcsr != NULL) {
+        mtx_BCSR_free(g->bcsr);
+        free(g->bcsr);
+    }
+    if (g->compressed != NULL) {
+        free_compressed_graph(g->compressed);
+        free(g->compressed);
+    }
+    g->out = NULL;
+    g->csr = NULL;
+    g->ell = NULL;
+    g->jds = NULL;
+    g->jds_dangling = NULL;
+    g->sell = NULL;
+    g->hyb = NULL;
+    g->bcsr = NULL;
+    g->compressed = NULL;
+}
+
+#endif
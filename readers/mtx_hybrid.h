@@ -1,20 +1,75 @@
 #ifndef MTX_HYBRID
 #define MTX_HYBRID
 
+#include <limits.h>
+#include <stdint.h>
 #include "mtx_sparse.h"
 
 struct mtx_JDS  // Jagged Diagonal Storage
 {
     int num_cols;
-    int num_nonzeros;
+    edge_t num_nonzeros;
     long long num_elements;
     int num_pieces;
-    mtx_ELL ** pieces;
+    mtx_ELL ** pieces;  // without col_scale, they share the one of the JDS matrix
     int ** row_ind;
+    float *col_scale;   // 1/out-degree of every column with PATTERN_ONLY, NULL otherwise
 };
 
 typedef struct mtx_JDS mtx_JDS;
 
+struct mtx_SELL  // Sliced ELLpack (SELL-C-sigma)
+{
+    int num_rows;
+    int num_cols;
+    edge_t num_nonzeros;
+    edge_t num_elements;    // nonzeros + padding
+    int chunk_size;         // C, rows per chunk
+    int sigma;              // rows are sorted by length within windows of sigma rows
+    int num_chunks;
+    edge_t *chunk_ptr;      // start of every chunk in col and data (num_chunks + 1 entries)
+    int *chunk_width;       // length of the longest row of every chunk
+    int *row_ind;           // row stored in every lane of every chunk, -1 for the lanes after the last row
+    int *col;
+    float *data;        // NULL with PATTERN_ONLY
+    float *col_scale;   // 1/out-degree of every column with PATTERN_ONLY, NULL otherwise
+};
+
+typedef struct mtx_SELL mtx_SELL;
+
+struct mtx_HYB  // HYBrid ELL + COO
+{
+    mtx_ELL ell;            // first ell.num_elementsinrow entries of every row (without col_scale)
+    edge_t coo_nonzeros;    // entries beyond the ELL width, sorted by row
+    int *coo_row;
+    int *coo_col;
+    float *coo_data;        // NULL with PATTERN_ONLY
+    float *col_scale;       // 1/out-degree of every column with PATTERN_ONLY, NULL otherwise
+};
+
+typedef struct mtx_HYB mtx_HYB;
+
+// columns of a block of the column-blocked CSR, local column indices fit in 16 bits
+#define BCSR_BLOCK_BITS 16
+#define BCSR_BLOCK_COLS (1 << BCSR_BLOCK_BITS)
+
+struct mtx_BCSR  // column-Blocked CSR
+{
+    int num_rows;
+    int num_cols;
+    edge_t num_nonzeros;
+    int num_blocks;         // block b holds the columns [b * BCSR_BLOCK_COLS, (b + 1) * BCSR_BLOCK_COLS)
+    edge_t num_segments;    // nonempty rows of every block
+    edge_t *block_ptr;      // first segment of every block (num_blocks + 1 entries)
+    int *seg_row;           // row of every segment, increasing within a block
+    edge_t *seg_ptr;        // first nonzero of every segment (num_segments + 1 entries)
+    uint16_t *col;          // column - block base
+    float *data;        // NULL with PATTERN_ONLY
+    float *col_scale;   // 1/out-degree of every column with PATTERN_ONLY, NULL otherwise
+};
+
+typedef struct mtx_BCSR mtx_BCSR;
+
 
 void mtx_JDS_print(struct mtx_JDS *mJDS) {
     for(int p = 0; p < mJDS->num_pieces; p++) {
@@ -22,9 +77,12 @@ void mtx_JDS_print(struct mtx_JDS *mJDS) {
         for(int i = 0; i < mJDS->pieces[p]->num_rows; i++) {
             printf("ROW %d:\t", mJDS->row_ind[p][i]);
             for(int j = 0; j < mJDS->pieces[p]->num_elementsinrow; j++) {
-                int ell_index = j * mJDS->pieces[p]->num_rows + i;
-                if(mJDS->pieces[p]->data[ell_index] != 0)
-                    printf("c%02d(%.3f), ", mJDS->pieces[p]->col[ell_index], mJDS->pieces[p]->data[ell_index]);
+                long long ell_index = j * mJDS->pieces[p]->num_rows + i;
+                int col = mJDS->pieces[p]->col[ell_index];
+                if(PATTERN_ONLY && col < mJDS->num_cols)
+                    printf("c%02d(%.3f), ", col, mJDS->col_scale[col]);
+                else if(!PATTERN_ONLY && mJDS->pieces[p]->data[ell_index] != 0)
+                    printf("c%02d(%.3f), ", col, mJDS->pieces[p]->data[ell_index]);
             }
             printf("\n");
         }
@@ -32,219 +90,630 @@ void mtx_JDS_print(struct mtx_JDS *mJDS) {
 }
 
 
-// generates up to <num_pieces> ELL matrices by grouping rows of similar lengths
-// the interval between smallest and largest row is split into <num_pieces>
-// consequently some pieces may be empty or very small, and empty pieces are removed
-// it also ignores empty rows, and the indices of corresponding nodes are returned as <dangling>
-int get_JDS_from_edges(struct mtx_JDS *mJDS, int** dangling, int* num_pieces, int *** edges, int ** out_degrees, int * nodes_count, int * edges_count) {
-    int row, prev_row, row_size, min_row_len, max_row_len, row_len_interval, empty_pieces, empty_rows;
-    int * row_len;
-    
-    // sort edges
-    qsort(*edges, *edges_count, 2 * sizeof(int), edge_compare);
-
-    // allocate space for JDS
-    mJDS->num_pieces = (*num_pieces);
-    mJDS->num_cols = (*nodes_count);
-    mJDS->num_nonzeros = 0;
-    mJDS->num_elements = 0;
-    mJDS->pieces = (mtx_ELL **) malloc((*num_pieces) * sizeof(mtx_ELL *));
-    mJDS->row_ind = (int **) malloc((*num_pieces)*sizeof(int *));
-    (*dangling) = (int *) calloc((*nodes_count), sizeof(int));
-    if(mJDS->pieces == NULL || mJDS->row_ind == NULL || (*dangling) == NULL)  {
+// device memory needed by a JDS piece: col and data (unless PATTERN_ONLY) for every element and the row indices
+long long jds_piece_bytes(long long rows, long long elements) {
+    return elements * MTX_ELEMENT_BYTES + rows * sizeof(int);
+}
+
+// padded elements of a piece holding the rows with the distinct lengths lengths[a..b],
+// or LLONG_MAX if the piece could not be allocated (or indexed by the kernel) on the device
+long long jds_piece_cost(long long * rows_prefix, int * lengths, int a, int b, long long max_piece_bytes) {
+    long long rows = rows_prefix[b+1] - rows_prefix[a];
+    long long elements = rows * lengths[b];
+    if(elements > EDGE_MAX || jds_piece_bytes(rows, elements) > max_piece_bytes)
+        return LLONG_MAX;
+    return elements;
+}
+
+// one step of the piece partitioning: cost[b] is the least padded size of `k` pieces covering lengths[0..b]
+// given prev_cost for k - 1 pieces. The piece cost is Monge, so the first length of the last piece is
+// nondecreasing in b and the range [first_lo, first_hi] of the candidates is halved with every recursion
+void jds_partition_step(long long * prev_cost, long long * cost, int * first, long long * rows_prefix, int * lengths,
+                        int lo, int hi, int first_lo, int first_hi, long long max_piece_bytes) {
+    if(lo > hi)
+        return;
+    int b = (lo + hi) / 2;
+    int last = first_hi < b ? first_hi : b;
+    long long best = LLONG_MAX;
+    int best_a = last; // if nothing fits, no larger b can use a first length below `last` either
+    for(int a = first_lo > 1 ? first_lo : 1; a <= last; a++) {
+        long long piece = jds_piece_cost(rows_prefix, lengths, a, b, max_piece_bytes);
+        if(prev_cost[a-1] == LLONG_MAX || piece == LLONG_MAX)
+            continue;
+        if(prev_cost[a-1] + piece < best) {
+            best = prev_cost[a-1] + piece;
+            best_a = a;
+        }
+    }
+    cost[b] = best;
+    first[b] = best_a;
+    jds_partition_step(prev_cost, cost, first, rows_prefix, lengths, lo, b - 1, first_lo, best_a, max_piece_bytes);
+    jds_partition_step(prev_cost, cost, first, rows_prefix, lengths, b + 1, hi, best_a, first_hi, max_piece_bytes);
+}
+
+int jds_choose_pieces(int * row_len, int nodes_count, int max_pieces, long long memory_budget,
+                      long long max_piece_bytes, int ** limits) {
+    /*
+     * Chooses the pieces of a JDS matrix from the row length histogram: piece p holds the rows with
+     * lengths in (limits[p-1], limits[p]] and is padded to limits[p]. For k = 1, 2, ... pieces the split
+     * with the fewest padded elements is computed (dynamic programming over the distinct row lengths),
+     * stopping at the first k whose padding is at most JDS_MAX_PADDING of the nonzeros, or at max_pieces.
+     * Pieces larger than max_piece_bytes are never chosen, so no piece fails to allocate or overflows
+     * the kernel indices, and pieces are never empty. Empty rows belong to no piece.
+     * Return value: number of pieces (limits allocated here), -1 if the matrix does not fit into memory_budget
+     */
+    if(max_pieces < 1)
+        max_pieces = 1;
+    int max_len = 0;
+    for(int i = 0; i < nodes_count; i++)
+        if(max_len < row_len[i])
+            max_len = row_len[i];
+
+    // histogram of the row lengths, compacted to the distinct nonzero lengths
+    long long * histogram = (long long *) calloc(max_len + 1, sizeof(long long));
+    if(histogram == NULL) {
         printf("Could not allocate space for JDS matrix.\n");
-        return 1;
+        return -1;
+    }
+    for(int i = 0; i < nodes_count; i++)
+        histogram[row_len[i]]++;
+    int distinct = 0;
+    for(int len = 1; len <= max_len; len++)
+        distinct += histogram[len] > 0;
+
+    int * lengths = (int *) malloc((distinct + 1) * sizeof(int));
+    long long * rows_prefix = (long long *) malloc((distinct + 1) * sizeof(long long));
+    (*limits) = (int *) malloc((max_pieces > 0 ? max_pieces : 1) * sizeof(int));
+    if(lengths == NULL || rows_prefix == NULL || (*limits) == NULL) {
+        printf("Could not allocate space for JDS matrix.\n");
+        return -1;
+    }
+    long long rows = 0, nonzeros = 0;
+    rows_prefix[0] = 0;
+    for(int len = 1, d = 0; len <= max_len; len++) {
+        if(histogram[len] == 0)
+            continue;
+        lengths[d] = len;
+        rows += histogram[len];
+        nonzeros += histogram[len] * len;
+        rows_prefix[++d] = rows;
+    }
+    free(histogram);
+    if(distinct == 0) {
+        free(lengths);
+        free(rows_prefix);
+        return 0;
     }
 
-    // compute row length distribution
-    row_len = (int *) calloc((*nodes_count), sizeof(int));
-    if(row_len == NULL)  {
+    int max_k = max_pieces < distinct ? max_pieces : distinct;
+    long long * cost = (long long *) malloc((long long) (max_k + 1) * distinct * sizeof(long long));
+    int * first = (int *) malloc((long long) (max_k + 1) * distinct * sizeof(int));
+    if(cost == NULL || first == NULL) {
         printf("Could not allocate space for JDS matrix.\n");
-        return 1;
+        return -1;
     }
 
-    prev_row = 0;
-    row_size = 0;
-    min_row_len = (*nodes_count);
-    max_row_len = 0;
-    for (int i = 0; i < (*edges_count); i++) {
-        row = (*edges)[i][1];
-        if(row > prev_row) {
-            row_len[prev_row] = row_size;
-            if(row_size > 0) {
-                if(max_row_len < row_size)
-                    max_row_len = row_size;
-                if(min_row_len > row_size)
-                    min_row_len = row_size;
-            }
-            row_size = 1;
-            prev_row = row;
-        } else
-            row_size++;
+    // row k of cost and first holds the best split into k pieces
+    int k = 1;
+    for(int b = 0; b < distinct; b++) {
+        cost[distinct + b] = jds_piece_cost(rows_prefix, lengths, 0, b, max_piece_bytes);
+        first[distinct + b] = 0;
+    }
+    int best_k = 1;
+    while(k < max_k && (cost[(long long) k * distinct + distinct - 1] == LLONG_MAX
+            || cost[(long long) k * distinct + distinct - 1] > (1 + JDS_MAX_PADDING) * nonzeros)) {
+        k++;
+        jds_partition_step(&cost[(long long) (k - 1) * distinct], &cost[(long long) k * distinct],
+                &first[(long long) k * distinct], rows_prefix, lengths, 0, distinct - 1, 0, distinct - 1, max_piece_bytes);
+        if(cost[(long long) k * distinct + distinct - 1] < cost[(long long) best_k * distinct + distinct - 1])
+            best_k = k;
+    }
+
+    long long elements = cost[(long long) best_k * distinct + distinct - 1];
+    // the pagerank vectors and dangling flags, with PATTERN_ONLY also the column scales and the scaled vector
+    long long vector_bytes = (PATTERN_ONLY ? 5LL : 3LL) * nodes_count * sizeof(float);
+    if(elements == LLONG_MAX || jds_piece_bytes(rows, elements) + vector_bytes > memory_budget) {
+        if(elements == LLONG_MAX)
+            printf("JDS matrix cannot be split into %d pieces that fit into device allocations of %lld bytes.\n",
+                    max_pieces, max_piece_bytes);
+        else
+            printf("JDS matrix (%lld elements in %d pieces) does not fit into %lld bytes of device memory.\n",
+                    elements, best_k, memory_budget);
+        free(cost);
+        free(first);
+        free(lengths);
+        free(rows_prefix);
+        free(*limits);
+        return -1;
     }
-    row_len[row] = row_size;
-    if(row_size > 0) {
-        if(max_row_len < row_size)
-             max_row_len = row_size;
-        if(min_row_len > row_size)
-            min_row_len = row_size;
+
+    // walk the split back from the longest rows
+    for(int p = best_k, b = distinct - 1; p >= 1; p--) {
+        (*limits)[p-1] = lengths[b];
+        b = first[(long long) p * distinct + b] - 1;
+    }
+
+    free(cost);
+    free(first);
+    free(lengths);
+    free(rows_prefix);
+    return best_k;
+}
+
+// generates from the rows of a CSR matrix up to <num_pieces> ELL matrices by grouping rows of similar lengths
+// the pieces are chosen from the row length histogram by `jds_choose_pieces` (fewest padded elements
+// that fit into <memory_budget> bytes, no piece larger than <max_piece_bytes>), <num_pieces> is set to their number
+// it also ignores empty rows, and the indices of corresponding nodes are returned as <dangling>
+int mtx_JDS_create_from_mtx_CSR(struct mtx_JDS *mJDS, int** dangling, int* num_pieces, struct mtx_CSR *mCSR,
+                                long long memory_budget, long long max_piece_bytes) {
+    int nodes_count = mCSR->num_rows;
+    int * limits;
+
+    mJDS->num_cols = mCSR->num_cols;
+    mJDS->num_nonzeros = 0;
+    mJDS->num_elements = 0;
+    mJDS->col_scale = NULL;
+    (*dangling) = (int *) calloc(nodes_count, sizeof(int));
+    if(PATTERN_ONLY && (mJDS->col_scale = copy_col_scale(mCSR->col_scale, mCSR->num_cols)) == NULL)
+        return 1;
+    int * row_len = (int *) malloc((nodes_count > 0 ? nodes_count : 1) * sizeof(int));
+    if((*dangling) == NULL || row_len == NULL)  {
+        printf("Could not allocate space for JDS matrix.\n");
+        return 1;
     }
 
-    for(int i = 0; i < (*nodes_count); i++)
+    // compute row length distribution (empty rows are ignored)
+    for(int i = 0; i < nodes_count; i++) {
+        row_len[i] = mCSR->rowptr[i+1] - mCSR->rowptr[i];
         (*dangling)[i] = (row_len[i] == 0);
+    }
 
-    row_len_interval = max_row_len - min_row_len + 1;
+    // choose the pieces and allocate space for JDS
+    (*num_pieces) = jds_choose_pieces(row_len, nodes_count, *num_pieces, memory_budget, max_piece_bytes, &limits);
+    if((*num_pieces) < 0)
+        return 1;
+    mJDS->num_pieces = (*num_pieces);
+    mJDS->pieces = (mtx_ELL **) malloc(((*num_pieces) > 0 ? (*num_pieces) : 1) * sizeof(mtx_ELL *));
+    mJDS->row_ind = (int **) malloc(((*num_pieces) > 0 ? (*num_pieces) : 1) * sizeof(int *));
+    if(mJDS->pieces == NULL || mJDS->row_ind == NULL)  {
+        printf("Could not allocate space for JDS matrix.\n");
+        return 1;
+    }
 
-    int min_row_limit_p, max_row_limit_p, max_row_len_p, row_count_p, el_count_p, r_ind;
-    long long ell_index;
-    int * row_ind_p;
-    mtx_ELL * mELL_p;
-    empty_pieces = 0;
     for(int p = 0; p < (*num_pieces); p++) {
-        min_row_limit_p = min_row_len + (p*row_len_interval)/(*num_pieces);
-        if(min_row_limit_p == 0)
-            min_row_limit_p = 1; // ignore empty rows
-        max_row_limit_p = min_row_len + ((p+1)*row_len_interval)/(*num_pieces) - 1;
-
-        row_count_p = 0;
-        el_count_p = 0;
-        max_row_len_p = 0;
-        // count number of rows, elements, and maximum row length for piece
-        for(int i = 0; i < (*nodes_count); i++) {
+        int min_row_limit_p = p == 0 ? 1 : limits[p-1] + 1; // ignore empty rows
+        int max_row_limit_p = limits[p];
+
+        int row_count_p = 0;
+        edge_t el_count_p = 0;
+        // count number of rows and elements for piece (its longest row is max_row_limit_p)
+        for(int i = 0; i < nodes_count; i++) {
             if(row_len[i] >= min_row_limit_p && row_len[i] <= max_row_limit_p) {
                 row_count_p++;
                 el_count_p += row_len[i];
-                if(max_row_len_p < row_len[i])
-                    max_row_len_p = row_len[i];
             }
         }
 
-
-        mELL_p = (mtx_ELL *) malloc(sizeof(mtx_ELL));
+        mtx_ELL * mELL_p = (mtx_ELL *) malloc(sizeof(mtx_ELL));
         mELL_p->num_nonzeros = el_count_p;
         mELL_p->num_rows = row_count_p;
-        mELL_p->num_cols = (*nodes_count);
-        mELL_p->num_elementsinrow = max_row_len_p;
-        mELL_p->num_elements = mELL_p->num_rows * mELL_p->num_elementsinrow;
+        mELL_p->num_cols = mCSR->num_cols;
+        mELL_p->num_elementsinrow = max_row_limit_p;
+        mELL_p->num_elements = (long long) mELL_p->num_rows * mELL_p->num_elementsinrow;
         mJDS->pieces[p] = mELL_p;
         mJDS->num_nonzeros += el_count_p;
         mJDS->num_elements += mELL_p->num_elements;
 
-        if(el_count_p == 0) { // empty section
-            empty_pieces++;
-            continue;
-        }
-
         // allocate ELL piece and row vector
-        mELL_p->data = (float *) calloc(mELL_p->num_elements, sizeof(float));
-        mELL_p->col = (int *) calloc(mELL_p->num_elements, sizeof(int));
-        row_ind_p = (int *) calloc(mELL_p->num_rows, sizeof(int));
-
-        if(mELL_p->data == NULL || mELL_p->col == NULL || row_ind_p == NULL)  {
+        mELL_p->data = PATTERN_ONLY ? NULL : (float *) calloc(mELL_p->num_elements, sizeof(float));
+        mELL_p->col_scale = NULL;
+        mELL_p->col = (int *) malloc(mELL_p->num_elements * sizeof(int));
+        int * row_ind_p = (int *) calloc(mELL_p->num_rows, sizeof(int));
+        if((!PATTERN_ONLY && mELL_p->data == NULL) || mELL_p->col == NULL || row_ind_p == NULL)  {
             printf("Could not allocate space for JDS matrix.\n");
             return 1;
         }
+        for(long long i = 0; i < mELL_p->num_elements; i++)
+            mELL_p->col[i] = MTX_PADDING_COL(mJDS->num_cols);
         mJDS->row_ind[p] = row_ind_p;
 
-        
-        prev_row = 0;
-        row_size = 0;
-        r_ind = -1;
-        // copy edges from corresponding rows to ELL structures and compute values
-        for (int i = 0; i < (*edges_count); i++) {
-            row  = (*edges)[i][1];
-            
-            if(row_len[row] >= min_row_limit_p && row_len[row] <= max_row_limit_p) {
-
-                if(row > prev_row) {
-                    row_size = 1;
-                    prev_row = row;
-                    r_ind++; // Increments from -1 when switching to first relevant row
-                    row_ind_p[r_ind] = row;
-                } else
-                    row_size++;
-
-                if(r_ind == -1) {
-                    r_ind = 0; // This fixes the piece with the first row (if any)
-                    row_ind_p[r_ind] = row;
-                }
-
-                ell_index = (row_size - 1) * mELL_p->num_rows + r_ind;
-
-                mELL_p->col[ell_index] = (*edges)[i][0];
-
-                // If no outgoing links, return error (current edge is outgoing)
-                if((*out_degrees)[(*edges)[i][0]] == 0) {
-                    printf("Inconsistency in data: outgoing edge for node %d with 0 out-degree.\n", (*edges)[i][0]);
-                    return 1;
-                } else // Otherwise transition to one of outgoing links randomly                          
-                    mELL_p->data[ell_index] = 1./(*out_degrees)[(*edges)[i][0]];
-
-            } else if(row > prev_row) {
-                row_size = 1;
-                prev_row = row;
-            } else
-                row_size++;
+        // copy the rows of the piece to the ELL structures
+        int r_ind = 0;
+        for(int i = 0; i < nodes_count; i++) {
+            if(row_len[i] < min_row_limit_p || row_len[i] > max_row_limit_p)
+                continue;
+            row_ind_p[r_ind] = i;
+            for(int j = 0; j < row_len[i]; j++) {
+                long long ell_index = (long long) j * mELL_p->num_rows + r_ind;
+                mELL_p->col[ell_index] = mCSR->col[mCSR->rowptr[i] + j];
+                if(!PATTERN_ONLY)
+                    mELL_p->data[ell_index] = mCSR->data[mCSR->rowptr[i] + j];
+            }
+            r_ind++;
         }
     }
 
     free(row_len);
+    free(limits);
+    return 0;
+}
 
-    // remove empty pieces
-    if(empty_pieces > 0) {
+// builds SELL-C-sigma from CSR: rows are sorted by decreasing length within windows of <sigma> rows,
+// then every <chunk_size> consecutive rows form a chunk stored column-major and padded to its longest row
+int mtx_SELL_create_from_mtx_CSR(struct mtx_SELL *mSELL, struct mtx_CSR *mCSR, int chunk_size, int sigma) {
+    int nodes_count = mCSR->num_rows;
+    mSELL->num_rows = nodes_count;
+    mSELL->num_cols = mCSR->num_cols;
+    mSELL->num_nonzeros = mCSR->num_nonzeros;
+    mSELL->chunk_size = chunk_size;
+    mSELL->sigma = sigma;
+    mSELL->num_chunks = (nodes_count + chunk_size - 1) / chunk_size;
+    long long slots = (long long) mSELL->num_chunks * chunk_size;
+
+    long long * keys = (long long *) malloc((nodes_count > 0 ? nodes_count : 1) * sizeof(long long));
+    mSELL->row_ind = (int *) malloc((slots > 0 ? slots : 1) * sizeof(int));
+    mSELL->chunk_width = (int *) malloc((mSELL->num_chunks > 0 ? mSELL->num_chunks : 1) * sizeof(int));
+    mSELL->chunk_ptr = (edge_t *) malloc((mSELL->num_chunks + 1) * sizeof(edge_t));
+    if(keys == NULL || mSELL->row_ind == NULL || mSELL->chunk_width == NULL || mSELL->chunk_ptr == NULL)  {
+        printf("Could not allocate space for SELL matrix.\n");
+        return 1;
+    }
 
-        mtx_ELL ** pieces2 = (mtx_ELL **) malloc(((*num_pieces) - empty_pieces) * sizeof(mtx_ELL *));
-        int ** row_ind2 = (int **) malloc(((*num_pieces) - empty_pieces) * sizeof(int *));
-        if(pieces2 == NULL || row_ind2 == NULL)  {
-            printf("Could not allocate space for JDS matrix.\n");
+    // sort the rows of every window by decreasing length (ties by row)
+    #pragma omp parallel for schedule(static)
+    for(int i = 0; i < nodes_count; i++)
+        keys[i] = ((long long) (INT_MAX - (int) (mCSR->rowptr[i+1] - mCSR->rowptr[i])) << 32) | i;
+    #pragma omp parallel for schedule(dynamic, 16)
+    for(long long w = 0; w < nodes_count; w += sigma) {
+        long long window = nodes_count - w < sigma ? nodes_count - w : sigma;
+        qsort(&keys[w], window, sizeof(long long), long_long_compare);
+    }
+    #pragma omp parallel for schedule(static)
+    for(long long slot = 0; slot < slots; slot++)
+        mSELL->row_ind[slot] = slot < nodes_count ? (int) (keys[slot] & 0xffffffffLL) : -1;
+    free(keys);
+
+    // chunk widths (a chunk may straddle two windows if sigma is not a multiple of chunk_size)
+    #pragma omp parallel for schedule(static)
+    for(int c = 0; c < mSELL->num_chunks; c++) {
+        mSELL->chunk_width[c] = 0;
+        for(int lane = 0; lane < chunk_size; lane++) {
+            int row = mSELL->row_ind[(long long) c * chunk_size + lane];
+            if(row >= 0 && mSELL->chunk_width[c] < mCSR->rowptr[row+1] - mCSR->rowptr[row])
+                mSELL->chunk_width[c] = mCSR->rowptr[row+1] - mCSR->rowptr[row];
+        }
+    }
+
+    long long total = 0;
+    mSELL->chunk_ptr[0] = 0;
+    for(int c = 0; c < mSELL->num_chunks; c++) {
+        total += (long long) mSELL->chunk_width[c] * chunk_size;
+        if(total > EDGE_MAX) {
+            printf("SELL matrix has more than %lld elements, enable LARGE_GRAPHS in global_config.h\n", (long long) EDGE_MAX);
             return 1;
         }
+        mSELL->chunk_ptr[c+1] = total;
+    }
+    mSELL->num_elements = total;
 
-        int i = 0;
-        for(int p = 0; p < mJDS->num_pieces; p++) {
-            if(mJDS->pieces[p]->num_nonzeros > 0) {
-                pieces2[i] = mJDS->pieces[p];
-                row_ind2[i] = mJDS->row_ind[p];
-                i++;
+    mSELL->col = (int *) malloc((total > 0 ? total : 1) * sizeof(int));
+    mSELL->data = PATTERN_ONLY ? NULL : (float *) calloc(total > 0 ? total : 1, sizeof(float));
+    mSELL->col_scale = PATTERN_ONLY ? copy_col_scale(mCSR->col_scale, mCSR->num_cols) : NULL;
+    if(mSELL->col == NULL || (mSELL->data == NULL && mSELL->col_scale == NULL))  {
+        printf("Could not allocate space for SELL matrix.\n");
+        return 1;
+    }
+
+    // copy the rows lane by lane (padding keeps column MTX_PADDING_COL and value 0)
+    #pragma omp parallel for schedule(static)
+    for(long long i = 0; i < total; i++)
+        mSELL->col[i] = MTX_PADDING_COL(mSELL->num_cols);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(int c = 0; c < mSELL->num_chunks; c++) {
+        for(int lane = 0; lane < chunk_size; lane++) {
+            int row = mSELL->row_ind[(long long) c * chunk_size + lane];
+            if(row < 0)
+                continue;
+            edge_t begin = mCSR->rowptr[row];
+            int row_len = mCSR->rowptr[row+1] - begin;
+            for(int j = 0; j < row_len; j++) {
+                edge_t idx = mSELL->chunk_ptr[c] + (edge_t) j * chunk_size + lane;
+                mSELL->col[idx] = mCSR->col[begin + j];
+                if(!PATTERN_ONLY)
+                    mSELL->data[idx] = mCSR->data[begin + j];
             }
         }
+    }
 
-        free(mJDS->pieces);
-        free(mJDS->row_ind);
-        mJDS->num_pieces -= empty_pieces;
-        mJDS->pieces = pieces2;
-        mJDS->row_ind = row_ind2;
+    return 0;
+}
+
+void mtx_SELL_print_stats(struct mtx_SELL *mSELL) {
+    // padding overhead and memory footprint compared with the CSR matrix of the same graph
+    double sell_bytes = mSELL->num_elements * MTX_ELEMENT_BYTES
+            + mSELL->num_chunks * (sizeof(edge_t) + sizeof(int)) + (double) mSELL->num_chunks * mSELL->chunk_size * sizeof(int);
+    double csr_bytes = mSELL->num_nonzeros * MTX_ELEMENT_BYTES + (mSELL->num_rows + 1.) * sizeof(edge_t);
+    printf("SELL-%d-%d - padding: %.2f%% (%lld elements for %lld nonzeros)\n", mSELL->chunk_size, mSELL->sigma,
+            mSELL->num_nonzeros > 0 ? 100. * (mSELL->num_elements - mSELL->num_nonzeros) / mSELL->num_nonzeros : 0.,
+            (long long) mSELL->num_elements, (long long) mSELL->num_nonzeros);
+    printf("SELL-%d-%d - memory: %.1f MB (CSR %.1f MB)\n", mSELL->chunk_size, mSELL->sigma, sell_bytes / 1e6, csr_bytes / 1e6);
+}
 
+void mtx_JDS_print_stats(struct mtx_JDS *mJDS) {
+    // chosen pieces with their padding, and the device memory of the matrix
+    long long rows = 0;
+    for(int p = 0; p < mJDS->num_pieces; p++) {
+        printf("JDS piece %d - rows: %lld, row length: %d, padding: %.2f%%\n", p, mJDS->pieces[p]->num_rows,
+                mJDS->pieces[p]->num_elementsinrow,
+                100. * (mJDS->pieces[p]->num_elements - mJDS->pieces[p]->num_nonzeros) / mJDS->pieces[p]->num_nonzeros);
+        rows += mJDS->pieces[p]->num_rows;
+    }
+    printf("JDS - %d pieces, padding: %.2f%%, memory: %.1f MB\n", mJDS->num_pieces,
+            mJDS->num_nonzeros > 0 ? 100. * (mJDS->num_elements - mJDS->num_nonzeros) / mJDS->num_nonzeros : 0.,
+            jds_piece_bytes(rows, mJDS->num_elements) / 1e6);
+}
+
+int hyb_choose_width(struct mtx_CSR *mCSR) {
+    /*
+     * ELL width of a HYB matrix from the row length histogram: the largest K such that at least
+     * 1/HYB_ELL_FRACTION of the rows have K entries or more. A column of the ELL part is then at least
+     * that full, and the entries of the few long rows (hubs) go to the COO part instead of padding
+     */
+    int nodes_count = mCSR->num_rows;
+    int max_len = 0;
+    for(int i = 0; i < nodes_count; i++)
+        if(max_len < mCSR->rowptr[i+1] - mCSR->rowptr[i])
+            max_len = mCSR->rowptr[i+1] - mCSR->rowptr[i];
+
+    edge_t * histogram = (edge_t *) calloc(max_len + 2, sizeof(edge_t));
+    if(histogram == NULL) {
+        printf("Could not allocate space for HYB matrix.\n");
+        return -1;
+    }
+    for(int i = 0; i < nodes_count; i++)
+        histogram[mCSR->rowptr[i+1] - mCSR->rowptr[i]]++;
+
+    int width = max_len;
+    long long rows_at_least = histogram[max_len];
+    while(width > 0 && rows_at_least * HYB_ELL_FRACTION < nodes_count) {
+        width--;
+        rows_at_least += histogram[width];
+    }
+    free(histogram);
+    return width;
+}
+
+// builds HYB from CSR: the first <width> entries of every row are stored in ELL (padded with
+// MTX_PADDING_COL), the remaining ones in COO, in the order of the CSR matrix
+int mtx_HYB_create_from_mtx_CSR(struct mtx_HYB *mHYB, struct mtx_CSR *mCSR, int width) {
+    int nodes_count = mCSR->num_rows;
+    mtx_ELL * mELL = &mHYB->ell;
+    mELL->num_rows = nodes_count;
+    mELL->num_cols = mCSR->num_cols;
+    mELL->num_elementsinrow = width;
+    mELL->num_elements = (long long) nodes_count * width;
+    mELL->col_scale = NULL;
+
+    // offsets of the rows in the COO part
+    edge_t * coo_ptr = (edge_t *) malloc((nodes_count + 1) * sizeof(edge_t));
+    if(coo_ptr == NULL) {
+        printf("Could not allocate space for HYB matrix.\n");
+        return 1;
+    }
+    coo_ptr[0] = 0;
+    for(int i = 0; i < nodes_count; i++) {
+        edge_t row_len = mCSR->rowptr[i+1] - mCSR->rowptr[i];
+        coo_ptr[i+1] = coo_ptr[i] + (row_len > width ? row_len - width : 0);
+    }
+    mHYB->coo_nonzeros = coo_ptr[nodes_count];
+    mELL->num_nonzeros = mCSR->num_nonzeros - mHYB->coo_nonzeros;
+
+    mELL->col = (int *) malloc((mELL->num_elements > 0 ? mELL->num_elements : 1) * sizeof(int));
+    mELL->data = PATTERN_ONLY ? NULL : (float *) calloc(mELL->num_elements > 0 ? mELL->num_elements : 1, sizeof(float));
+    mHYB->coo_row = (int *) malloc((mHYB->coo_nonzeros > 0 ? mHYB->coo_nonzeros : 1) * sizeof(int));
+    mHYB->coo_col = (int *) malloc((mHYB->coo_nonzeros > 0 ? mHYB->coo_nonzeros : 1) * sizeof(int));
+    mHYB->coo_data = PATTERN_ONLY ? NULL : (float *) malloc((mHYB->coo_nonzeros > 0 ? mHYB->coo_nonzeros : 1) * sizeof(float));
+    mHYB->col_scale = PATTERN_ONLY ? copy_col_scale(mCSR->col_scale, mCSR->num_cols) : NULL;
+    if(mELL->col == NULL || mHYB->coo_row == NULL || mHYB->coo_col == NULL
+            || (PATTERN_ONLY ? mHYB->col_scale == NULL : mELL->data == NULL || mHYB->coo_data == NULL))  {
+        printf("Could not allocate space for HYB matrix.\n");
+        return 1;
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for(int i = 0; i < nodes_count; i++) {
+        edge_t begin = mCSR->rowptr[i];
+        int row_len = mCSR->rowptr[i+1] - begin;
+        for(int j = 0; j < width; j++) {
+            long long ell_index = (long long) j * nodes_count + i;
+            mELL->col[ell_index] = j < row_len ? mCSR->col[begin + j] : MTX_PADDING_COL(mCSR->num_cols);
+            if(!PATTERN_ONLY && j < row_len)
+                mELL->data[ell_index] = mCSR->data[begin + j];
+        }
+        for(int j = width; j < row_len; j++) {
+            edge_t coo_index = coo_ptr[i] + (j - width);
+            mHYB->coo_row[coo_index] = i;
+            mHYB->coo_col[coo_index] = mCSR->col[begin + j];
+            if(!PATTERN_ONLY)
+                mHYB->coo_data[coo_index] = mCSR->data[begin + j];
+        }
     }
 
+    free(coo_ptr);
     return 0;
 }
 
-int get_JDS_from_file(struct mtx_JDS * mJDS, int ** dangling, int * num_pieces, char * file_name) {
+void mtx_HYB_print_stats(struct mtx_HYB *mHYB) {
+    // split between the ELL and COO parts, and the memory compared with ELL alone and with CSR
+    mtx_ELL * mELL = &mHYB->ell;
+    edge_t nonzeros = mELL->num_nonzeros + mHYB->coo_nonzeros;
+    double hyb_bytes = mELL->num_elements * MTX_ELEMENT_BYTES + mHYB->coo_nonzeros * (MTX_ELEMENT_BYTES + sizeof(int));
+    double csr_bytes = nonzeros * MTX_ELEMENT_BYTES + (mELL->num_rows + 1.) * sizeof(edge_t);
+    printf("HYB - ELL width: %d, ELL padding: %.2f%%, %.2f%% of the nonzeros in COO\n", mELL->num_elementsinrow,
+            mELL->num_nonzeros > 0 ? 100. * (mELL->num_elements - mELL->num_nonzeros) / mELL->num_nonzeros : 0.,
+            nonzeros > 0 ? 100. * mHYB->coo_nonzeros / nonzeros : 0.);
+    printf("HYB - memory: %.1f MB (CSR %.1f MB)\n", hyb_bytes / 1e6, csr_bytes / 1e6);
+}
+
+// builds the column-blocked CSR from CSR (rows with sorted columns): every block keeps its nonempty
+// rows in row order, and the nonzeros of a block are contiguous
+int mtx_BCSR_create_from_mtx_CSR(struct mtx_BCSR *mBCSR, struct mtx_CSR *mCSR) {
+    int nodes_count = mCSR->num_rows;
+    int num_blocks = (int) (((long long) mCSR->num_cols + BCSR_BLOCK_COLS - 1) / BCSR_BLOCK_COLS);
+    mBCSR->num_rows = nodes_count;
+    mBCSR->num_cols = mCSR->num_cols;
+    mBCSR->num_nonzeros = mCSR->num_nonzeros;
+    mBCSR->num_blocks = num_blocks;
+    mBCSR->seg_row = NULL;
+    mBCSR->seg_ptr = NULL;
+    mBCSR->col = NULL;
+    mBCSR->data = NULL;
+    mBCSR->col_scale = PATTERN_ONLY ? copy_col_scale(mCSR->col_scale, mCSR->num_cols) : NULL;
+
     /*
-    ** File should be formated as edge list with first line containing
-    ** [node_count]\t[edge_count] and every line aferwards containing
-    ** [arc_tail]\t[arc_head] for directed graphs (or endpoints for undirected)
-    */
-
-    // read edges
-    int nodes_count, edges_count, i;
-    int ** edges;
-    int * out_degrees;
-    int * in_degrees;
-    if(read_edges(file_name, &edges, &out_degrees, &in_degrees, &nodes_count, &edges_count))
+     * every thread counts the segments and nonzeros of every block in its own range of rows, the
+     * counts are prefix-summed in (block, thread) order and each thread fills its rows again at the
+     * resulting positions, which keeps the segments of a block in row order
+     */
+    int max_threads = omp_get_max_threads();
+    edge_t * seg_offsets = (edge_t *) calloc((long long) max_threads * num_blocks + 1, sizeof(edge_t));
+    edge_t * nz_offsets = (edge_t *) calloc((long long) max_threads * num_blocks + 1, sizeof(edge_t));
+    mBCSR->block_ptr = (edge_t *) malloc((num_blocks + 1) * sizeof(edge_t));
+    if(seg_offsets == NULL || nz_offsets == NULL || mBCSR->block_ptr == NULL || (PATTERN_ONLY && mBCSR->col_scale == NULL)) {
+        printf("Could not allocate space for BCSR matrix.\n");
+        free(seg_offsets);
+        free(nz_offsets);
+        return 1;
+    }
+
+    int failed = 0;
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        int begin = (long long) nodes_count * t / threads;
+        int end = (long long) nodes_count * (t + 1) / threads;
+        edge_t * segs = &seg_offsets[(long long) t * num_blocks];
+        edge_t * nzs = &nz_offsets[(long long) t * num_blocks];
+
+        for(int i = begin; i < end; i++) {
+            int last_block = -1;
+            for(edge_t j = mCSR->rowptr[i]; j < mCSR->rowptr[i+1]; j++) {
+                int block = mCSR->col[j] >> BCSR_BLOCK_BITS;
+                if(block != last_block)
+                    segs[block]++;
+                nzs[block]++;
+                last_block = block;
+            }
+        }
+        #pragma omp barrier
+
+        #pragma omp single
+        {
+            edge_t seg_sum = 0, nz_sum = 0;
+            for(int b = 0; b < num_blocks; b++) {
+                mBCSR->block_ptr[b] = seg_sum;
+                for(int other = 0; other < threads; other++) {
+                    edge_t value = seg_offsets[(long long) other * num_blocks + b];
+                    seg_offsets[(long long) other * num_blocks + b] = seg_sum;
+                    seg_sum += value;
+                    value = nz_offsets[(long long) other * num_blocks + b];
+                    nz_offsets[(long long) other * num_blocks + b] = nz_sum;
+                    nz_sum += value;
+                }
+            }
+            mBCSR->block_ptr[num_blocks] = seg_sum;
+            mBCSR->num_segments = seg_sum;
+
+            mBCSR->seg_row = (int *) malloc((seg_sum > 0 ? seg_sum : 1) * sizeof(int));
+            mBCSR->seg_ptr = (edge_t *) malloc((seg_sum + 1) * sizeof(edge_t));
+            mBCSR->col = (uint16_t *) malloc((nz_sum > 0 ? nz_sum : 1) * sizeof(uint16_t));
+            if(!PATTERN_ONLY)
+                mBCSR->data = (float *) malloc((nz_sum > 0 ? nz_sum : 1) * sizeof(float));
+            if(mBCSR->seg_row == NULL || mBCSR->seg_ptr == NULL || mBCSR->col == NULL || (!PATTERN_ONLY && mBCSR->data == NULL))
+                failed = 1;
+            else
+                mBCSR->seg_ptr[seg_sum] = nz_sum;
+        }
+
+        if(!failed) {
+            for(int i = begin; i < end; i++) {
+                int last_block = -1;
+                for(edge_t j = mCSR->rowptr[i]; j < mCSR->rowptr[i+1]; j++) {
+                    int block = mCSR->col[j] >> BCSR_BLOCK_BITS;
+                    if(block != last_block) {
+                        edge_t seg = segs[block]++;
+                        mBCSR->seg_row[seg] = i;
+                        mBCSR->seg_ptr[seg] = nzs[block];
+                        last_block = block;
+                    }
+                    edge_t index = nzs[block]++;
+                    mBCSR->col[index] = (uint16_t) (mCSR->col[j] & (BCSR_BLOCK_COLS - 1));
+                    if(!PATTERN_ONLY)
+                        mBCSR->data[index] = mCSR->data[j];
+                }
+            }
+        }
+    }
+
+    free(seg_offsets);
+    free(nz_offsets);
+    if(failed) {
+        printf("Could not allocate space for BCSR matrix.\n");
         return 1;
+    }
+    return 0;
+}
 
-    int status = get_JDS_from_edges(mJDS, dangling, num_pieces, &edges, &out_degrees, &nodes_count, &edges_count);
+double mtx_BCSR_bytes(struct mtx_BCSR *mBCSR) {
+    // matrix bytes streamed by one product (the rank vector is not counted)
+    return mBCSR->num_nonzeros * (sizeof(uint16_t) + (PATTERN_ONLY ? 0 : sizeof(float)))
+            + mBCSR->num_segments * (sizeof(int) + sizeof(edge_t)) + (mBCSR->num_blocks + 1.) * sizeof(edge_t);
+}
 
-    // NOTE: contiguous_space from read_edges is not freed (memory leak)
-    free(edges);
-    free(out_degrees);
-    free(in_degrees);
+void mtx_BCSR_print_stats(struct mtx_BCSR *mBCSR) {
+    // segments per row and the matrix traffic of one product compared with CSR
+    double csr_bytes = mBCSR->num_nonzeros * MTX_ELEMENT_BYTES + (mBCSR->num_rows + 1.) * sizeof(edge_t);
+    printf("BCSR - %d blocks of %d columns, %.2f segments per row, %.2f nonzeros per segment\n",
+            mBCSR->num_blocks, BCSR_BLOCK_COLS, mBCSR->num_rows > 0 ? (double) mBCSR->num_segments / mBCSR->num_rows : 0.,
+            mBCSR->num_segments > 0 ? (double) mBCSR->num_nonzeros / mBCSR->num_segments : 0.);
+    printf("BCSR - matrix traffic per iteration: %.1f MB (CSR %.1f MB)\n", mtx_BCSR_bytes(mBCSR) / 1e6, csr_bytes / 1e6);
+}
 
-    return status;
+int mtx_SELL_free(struct mtx_SELL *mSELL)
+{
+    free(mSELL->chunk_ptr);
+    free(mSELL->chunk_width);
+    free(mSELL->row_ind);
+    free(mSELL->col);
+    free(mSELL->data);
+    free(mSELL->col_scale);
+
+    return 0;
 }
 
+int mtx_HYB_free(struct mtx_HYB *mHYB)
+{
+    mtx_ELL_free(&mHYB->ell);
+    free(mHYB->coo_row);
+    free(mHYB->coo_col);
+    free(mHYB->coo_data);
+    free(mHYB->col_scale);
+
+    return 0;
+}
+
+int mtx_BCSR_free(struct mtx_BCSR *mBCSR)
+{
+    free(mBCSR->block_ptr);
+    free(mBCSR->seg_row);
+    free(mBCSR->seg_ptr);
+    free(mBCSR->col);
+    free(mBCSR->data);
+    free(mBCSR->col_scale);
+
+    return 0;
+}
 
 int mtx_JDS_free(struct mtx_JDS *mJDS)
 {
@@ -256,6 +725,7 @@ int mtx_JDS_free(struct mtx_JDS *mJDS)
     }
     free(mJDS->pieces);
     free(mJDS->row_ind);
+    free(mJDS->col_scale);
 
     return 0;
 }
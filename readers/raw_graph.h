@@ -0,0 +1,560 @@
+#ifndef RAW_GRAPH
+#define RAW_GRAPH
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+#include "../helpers/file_helper.h"
+#include "../global_config.h"
+
+/*
+Readers for graphs that were not prepared with `py_src/prepare_graph.py`:
+    - SNAP edge lists: `[from] [to]` lines with arbitrary non-negative 64-bit ids
+      and `#` (or `%`) comment lines; the ids are compacted to 0..n-1 in
+      increasing order with a parallel hash map;
+    - Pajek: `*Vertices n` followed by `*Arcs` (directed) and/or `*Edges`
+      (undirected) sections with 1-based ids;
+    - MatrixMarket coordinate files: entry `(i, j)` is the arc i -> j, 1-based,
+      symmetric matrices are expanded to both directions, values are ignored.
+Undirected edges are stored as two arcs (self loops only once). The original id
+of every node is kept in `node_ids`, so that results can be written with it.
+*/
+
+#define MAX_EDGE_SECTIONS 16
+
+struct edge_section  // [begin, end) contains one edge per line
+{
+    char *begin;
+    char *end;
+    int undirected;
+};
+
+struct id_map  // open addressing hash map: 64-bit id -> dense id
+{
+    long long *keys;    // ID_MAP_EMPTY for free slots
+    int *values;
+    long long capacity; // power of two
+};
+
+#define ID_MAP_EMPTY (-1LL)
+
+
+const char * graph_format_name(int format) {
+    switch (format) {
+        case FORMAT_SNAP: return "SNAP";
+        case FORMAT_PAJEK: return "Pajek";
+        case FORMAT_MTX: return "MatrixMarket";
+        default: return "prepared edge list";
+    }
+}
+
+int detect_format_from_text(char * start, size_t len) {
+    /*
+        Returns the format of a graph whose first `len` bytes are in `start` (see
+    INPUT_FORMAT in global_config.h), judging by its first non-blank character:
+    `%%MatrixMarket` banner, `*` for a Pajek section, `#` or `%` for a SNAP
+    comment. Anything else is taken to be a prepared edge list with a
+    `[node_count]\t[edge_count]` header.
+    */
+    if (INPUT_FORMAT != FORMAT_AUTO)
+        return INPUT_FORMAT;
+
+    char * p = start, * end = start + len;
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+    if (p == end)
+        return FORMAT_PREPARED;
+    if (end - p >= 14 && strncmp(p, "%%MatrixMarket", 14) == 0)
+        return FORMAT_MTX;
+    if (*p == '*')
+        return FORMAT_PAJEK;
+    if (*p == '#' || *p == '%')
+        return FORMAT_SNAP;
+    return FORMAT_PREPARED;
+}
+
+int detect_graph_format(char * file_name) {
+    // format of the (uncompressed) graph in `file_name`, see `detect_format_from_text`
+    char start[64];
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return FORMAT_PREPARED; // the reader reports the error
+    ssize_t n = read(fd, start, sizeof(start));
+    close(fd);
+    return detect_format_from_text(start, n > 0 ? n : 0);
+}
+
+int is_comment_line(char * p, char * end) {
+    // blank lines and lines starting with `#` or `%`
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p == end || *p == '\n' || *p == '#' || *p == '%';
+}
+
+int find_mtx_sections(char * data, char * end, struct edge_section * sections, int * sections_count,
+            long long * nodes_count) {
+    // parses the MatrixMarket banner and the size line
+    char object[32], layout[32], field[32], symmetry[32];
+    if (sscanf(data, "%%%%MatrixMarket %31s %31s %31s %31s", object, layout, field, symmetry) != 4
+            || strcasecmp(object, "matrix") != 0 || strcasecmp(layout, "coordinate") != 0) {
+        printf("ERROR: only MatrixMarket `matrix coordinate` files are supported\n");
+        return 1;
+    }
+
+    char * p = next_line(data, end);
+    while (p < end && is_comment_line(p, end))
+        p = next_line(p, end);
+
+    long long rows, cols, entries;
+    int ok0, ok1, ok2;
+    char * q = scan_int(p, end, &rows, &ok0);
+    q = scan_int(q, end, &cols, &ok1);
+    q = scan_int(q, end, &entries, &ok2);
+    if (!ok0 || !ok1 || !ok2 || rows <= 0 || cols <= 0) {
+        printf("ERROR: invalid MatrixMarket size line\n");
+        return 1;
+    }
+
+    *nodes_count = rows > cols ? rows : cols;
+    sections[0].begin = next_line(q, end);
+    sections[0].end = end;
+    sections[0].undirected = strcasecmp(symmetry, "general") != 0;
+    *sections_count = 1;
+    return 0;
+}
+
+int find_pajek_sections(char * data, char * end, struct edge_section * sections, int * sections_count,
+            long long * nodes_count) {
+    // finds the lines starting with `*`; only `*Vertices`, `*Arcs` and `*Edges` are supported
+    *nodes_count = -1;
+    *sections_count = 0;
+    struct edge_section * current = NULL;
+
+    char * p = data;
+    while (p < end && *p != '*')
+        p = next_line(p, end);
+    while (p < end) {
+        char * line_end = next_line(p, end);
+        if (current != NULL)
+            current->end = p;
+        current = NULL;
+
+        int ok;
+        if (strncasecmp(p, "*vertices", 9) == 0) {
+            scan_int(p + 9, line_end, nodes_count, &ok);
+            if (!ok) {
+                printf("ERROR: invalid Pajek `*Vertices` line\n");
+                return 1;
+            }
+        } else if (strncasecmp(p, "*arcslist", 9) == 0 || strncasecmp(p, "*edgeslist", 10) == 0
+                || strncasecmp(p, "*matrix", 7) == 0) {
+            printf("ERROR: Pajek `%.*s` sections are not supported\n", (int) (line_end - p - 1), p);
+            return 1;
+        } else if (strncasecmp(p, "*arcs", 5) == 0 || strncasecmp(p, "*edges", 6) == 0) {
+            if (*sections_count == MAX_EDGE_SECTIONS) {
+                printf("ERROR: too many Pajek sections\n");
+                return 1;
+            }
+            current = &sections[(*sections_count)++];
+            current->begin = line_end;
+            current->end = end;
+            current->undirected = strncasecmp(p, "*edges", 6) == 0;
+        }
+
+        // jump to the next line that starts with `*` (vertex and edge lines are not needed here)
+        char * star = line_end;
+        while ((star = (char *) memchr(star, '*', end - star)) != NULL && star[-1] != '\n')
+            star++;
+        p = star == NULL ? end : star;
+    }
+
+    if (*nodes_count <= 0) {
+        printf("ERROR: Pajek file without a `*Vertices` line\n");
+        return 1;
+    }
+    return 0;
+}
+
+int parse_raw_line(char * line, char * line_end, long long * from, long long * to) {
+    /*
+        Parses `[from] [to]` from the line [line, line_end), ignoring any further
+    fields (weights, timestamps...).
+        Returns 1 if valid, 0 for blank and comment lines and -1 otherwise.
+    */
+    if (is_comment_line(line, line_end))
+        return 0;
+    int ok0, ok1;
+    char * p = scan_int(line, line_end, from, &ok0);
+    scan_int(p, line_end, to, &ok1);
+    if (!ok0 || !ok1 || *from < 0 || *to < 0) {
+        int len = line_end - line;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            len--;
+        printf("ERROR: Line: %.*s\n", len > 64 ? 64 : len, line);
+        return -1;
+    }
+    return 1;
+}
+
+long long parse_raw_sections(struct edge_section * sections, int sections_count, long long ** pairs) {
+    /*
+        Parses the edges of all the sections into `pairs` (`from`, `to`, `from`,
+    `to`, ...), in file order, and returns their number (-1 upon failure).
+        Every section is split into one newline-aligned chunk per thread, as in
+    `read_edges`: the lines of every chunk are counted first (twice for
+    undirected sections), so that every chunk knows where to write its arcs.
+    */
+    int threads = omp_get_max_threads();
+    int chunks = sections_count * threads;
+    char ** chunk_start = (char **) malloc(sections_count * (threads + 1) * sizeof(char *));
+    long long * chunk_offset = (long long *) calloc(chunks + 1, sizeof(long long));
+    long long * chunk_edges = (long long *) calloc(chunks, sizeof(long long));
+    for (int s = 0; s < sections_count; s++)
+        split_in_chunks(sections[s].begin, sections[s].end, threads, &chunk_start[s * (threads + 1)]);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < chunks; c++) {
+        int s = c / threads, t = c % threads;
+        char ** starts = &chunk_start[s * (threads + 1)];
+        chunk_offset[c + 1] = count_lines(starts[t], starts[t + 1]) * (sections[s].undirected ? 2 : 1);
+    }
+    for (int c = 0; c < chunks; c++)
+        chunk_offset[c + 1] += chunk_offset[c];
+
+    long long capacity = chunk_offset[chunks];
+    *pairs = (long long *) malloc(2 * (capacity > 0 ? capacity : 1) * sizeof(long long));
+    if (*pairs == NULL) {
+        printf("Could not allocate space for the edges.\n");
+        free(chunk_start);
+        free(chunk_offset);
+        free(chunk_edges);
+        return -1;
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < chunks; c++) {
+        int s = c / threads, t = c % threads;
+        char ** starts = &chunk_start[s * (threads + 1)];
+        long long * my_pairs = &(*pairs)[2 * chunk_offset[c]];
+        long long valid = 0, from, to;
+        for (char * q = starts[t]; q < starts[t + 1]; ) {
+            char * line_end = next_line(q, starts[t + 1]);
+            if (parse_raw_line(q, line_end, &from, &to) == 1) {
+                my_pairs[2 * valid] = from;
+                my_pairs[2 * valid + 1] = to;
+                valid++;
+                if (sections[s].undirected && from != to) {
+                    my_pairs[2 * valid] = to;
+                    my_pairs[2 * valid + 1] = from;
+                    valid++;
+                }
+            }
+            q = line_end;
+        }
+        chunk_edges[c] = valid;
+    }
+
+    // close the gaps left by comments, invalid lines and undirected self loops
+    long long total = chunk_edges[0];
+    for (int c = 1; c < chunks; c++) {
+        if (total != chunk_offset[c])
+            memmove(&(*pairs)[2 * total], &(*pairs)[2 * chunk_offset[c]], 2 * chunk_edges[c] * sizeof(long long));
+        total += chunk_edges[c];
+    }
+
+    free(chunk_start);
+    free(chunk_offset);
+    free(chunk_edges);
+    return total;
+}
+
+static inline unsigned long long id_hash(long long key) {
+    // finalizer of splitmix64, spreads consecutive ids over the whole table
+    unsigned long long x = (unsigned long long) key;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static inline long long id_map_slot(struct id_map * map, long long key) {
+    // slot of `key`, which must be present in the map
+    long long slot = id_hash(key) & (map->capacity - 1);
+    while (map->keys[slot] != key)
+        slot = (slot + 1) & (map->capacity - 1);
+    return slot;
+}
+
+static inline void id_map_insert(struct id_map * map, long long key) {
+    // lock-free insertion (linear probing, slots are claimed with a CAS)
+    long long slot = id_hash(key) & (map->capacity - 1);
+    while (1) {
+        long long current = map->keys[slot];
+        if (current == key)
+            return;
+        if (current == ID_MAP_EMPTY) {
+            current = __sync_val_compare_and_swap(&map->keys[slot], ID_MAP_EMPTY, key);
+            if (current == ID_MAP_EMPTY || current == key)
+                return;
+        }
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+}
+
+int long_long_compare(const void * a, const void * b) {
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+void sort_ids(long long * ids, long long count) {
+    // every thread sorts one chunk, then the sorted runs are merged pairwise in parallel
+    int threads = omp_get_max_threads();
+    long long * bounds = (long long *) malloc((threads + 1) * sizeof(long long));
+    for (int t = 0; t <= threads; t++)
+        bounds[t] = count * t / threads;
+
+    #pragma omp parallel for schedule(static, 1)
+    for (int t = 0; t < threads; t++)
+        qsort(&ids[bounds[t]], bounds[t + 1] - bounds[t], sizeof(long long), long_long_compare);
+
+    long long * tmp = (long long *) malloc((count > 0 ? count : 1) * sizeof(long long));
+    long long * src = ids, * dst = tmp;
+    for (int width = 1; width < threads; width *= 2) {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int t = 0; t < threads; t += 2 * width) {
+            long long lo = bounds[t];
+            long long mid = bounds[t + width < threads ? t + width : threads];
+            long long hi = bounds[t + 2 * width < threads ? t + 2 * width : threads];
+            long long i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+                dst[k++] = src[i] <= src[j] ? src[i++] : src[j++];
+            while (i < mid)
+                dst[k++] = src[i++];
+            while (j < hi)
+                dst[k++] = src[j++];
+        }
+        long long * swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != ids)
+        memcpy(ids, src, count * sizeof(long long));
+
+    free(tmp);
+    free(bounds);
+}
+
+int compact_ids(long long * pairs, long long edges_count, int * dense, long long * nodes_count, long long ** node_ids) {
+    /*
+        Maps the ids in `pairs` to 0..n-1 (in increasing order of the original
+    ids) and writes them to `dense`. The original ids are returned in `node_ids`.
+        All the endpoints are inserted into a hash map in parallel, the distinct
+    ids are collected and sorted, and their positions are stored back in the
+    map, which is then used to translate the endpoints.
+        Returns 1 upon failure.
+    */
+    struct id_map map;
+    map.capacity = 1024;
+    while (map.capacity < 3 * edges_count) // at most 2 * edges_count distinct ids, load <= 2/3
+        map.capacity *= 2;
+    map.keys = (long long *) malloc(map.capacity * sizeof(long long));
+    map.values = (int *) malloc(map.capacity * sizeof(int));
+    if (map.keys == NULL || map.values == NULL) {
+        printf("Could not allocate the node id map.\n");
+        return 1;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < map.capacity; i++)
+        map.keys[i] = ID_MAP_EMPTY;
+
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < 2 * edges_count; i++)
+        id_map_insert(&map, pairs[i]);
+
+    // collect the distinct ids, every thread copies the keys of its range of slots
+    int max_threads = omp_get_max_threads();
+    long long * thread_offset = (long long *) calloc(max_threads + 1, sizeof(long long));
+    #pragma omp parallel num_threads(max_threads)
+    {
+        int t = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        long long first = map.capacity * t / threads, last = map.capacity * (t + 1) / threads;
+        long long count = 0;
+        for (long long i = first; i < last; i++)
+            count += map.keys[i] != ID_MAP_EMPTY;
+        thread_offset[t + 1] = count;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int u = 0; u < threads; u++)
+                thread_offset[u + 1] += thread_offset[u];
+            *nodes_count = thread_offset[threads];
+            *node_ids = (long long *) malloc((*nodes_count > 0 ? *nodes_count : 1) * sizeof(long long));
+        }
+
+        long long position = thread_offset[t];
+        for (long long i = first; i < last; i++)
+            if (map.keys[i] != ID_MAP_EMPTY)
+                (*node_ids)[position++] = map.keys[i];
+    }
+    free(thread_offset);
+
+    if (*nodes_count > INT_MAX) {
+        printf("ERROR: the graph has %lld nodes, at most %d are supported\n", *nodes_count, INT_MAX);
+        free(map.keys);
+        free(map.values);
+        return 1;
+    }
+
+    sort_ids(*node_ids, *nodes_count);
+
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < *nodes_count; i++)
+        map.values[id_map_slot(&map, (*node_ids)[i])] = i;
+
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < 2 * edges_count; i++)
+        dense[i] = map.values[id_map_slot(&map, pairs[i])];
+
+    free(map.keys);
+    free(map.values);
+    return 0;
+}
+
+int build_raw_edges(long long * pairs, long long total, long long declared_nodes, int first_id, int *** edges,
+            int ** out_degrees, int ** in_degrees, int * nodes_count, edge_t * edges_count, long long ** node_ids) {
+    /*
+        Turns the `total` arcs in `pairs` (64-bit ids, freed here) into the arrays
+    returned by `read_edges`. If `declared_nodes` is negative the ids are
+    compacted with `compact_ids`, otherwise they must be in
+    [first_id, first_id + declared_nodes) and are only shifted. `node_ids`
+    receives the original ids (it may be NULL if they are not needed).
+        Returns 1 upon failure.
+    */
+    if (total > EDGE_MAX) {
+        printf("ERROR: the graph has %lld edges, enable LARGE_GRAPHS in global_config.h\n", total);
+        free(pairs);
+        return 1;
+    }
+    if (declared_nodes > INT_MAX) {
+        printf("ERROR: the graph has %lld nodes, at most %d are supported\n", declared_nodes, INT_MAX);
+        free(pairs);
+        return 1;
+    }
+
+    int * contiguous_space = (int *) malloc(2 * (total > 0 ? total : 1) * sizeof(int));
+    if (contiguous_space == NULL) {
+        printf("Could not allocate space for the edges.\n");
+        free(pairs);
+        return 1;
+    }
+
+    long long nodes;
+    long long * ids = NULL;
+    if (declared_nodes < 0) {
+        // SNAP: arbitrary ids
+        if (compact_ids(pairs, total, contiguous_space, &nodes, &ids)) {
+            free(pairs);
+            free(contiguous_space);
+            return 1;
+        }
+    } else {
+        // Pajek, MatrixMarket and prepared edge lists: ids are already consecutive
+        nodes = declared_nodes;
+        long long invalid = 0;
+        #pragma omp parallel for schedule(static) reduction(+:invalid)
+        for (long long i = 0; i < 2 * total; i++) {
+            invalid += pairs[i] < first_id || pairs[i] >= first_id + nodes;
+            contiguous_space[i] = pairs[i] - first_id;
+        }
+        if (invalid) {
+            printf("ERROR: %lld endpoints are not in [%d, %lld]\n", invalid, first_id, first_id + nodes - 1);
+            free(pairs);
+            free(contiguous_space);
+            return 1;
+        }
+        if (first_id != 0) {
+            ids = (long long *) malloc(nodes * sizeof(long long));
+            #pragma omp parallel for schedule(static)
+            for (long long i = 0; i < nodes; i++)
+                ids[i] = i + first_id;
+        }
+    }
+    free(pairs);
+    if (node_ids != NULL)
+        *node_ids = ids;
+    else
+        free(ids);
+
+    *nodes_count = nodes;
+    *edges_count = total;
+    *out_degrees = (int *) calloc(nodes, sizeof(int));
+    *in_degrees = (int *) calloc(nodes, sizeof(int));
+    *edges = (int **) malloc((total > 0 ? total : 1) * sizeof(int *));
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < total; i++) {
+        (*edges)[i] = &contiguous_space[2 * i];
+        #pragma omp atomic
+        (*out_degrees)[contiguous_space[2 * i]]++;
+        #pragma omp atomic
+        (*in_degrees)[contiguous_space[2 * i + 1]]++;
+    }
+
+    return 0;
+}
+
+int read_raw_edges(char * file_name, int format, int *** edges, int ** out_degrees, int ** in_degrees,
+            int * nodes_count, edge_t * edges_count, long long ** node_ids) {
+    /*
+        Reads a SNAP, Pajek or MatrixMarket file (see the top of this file) and
+    returns the same arrays as `read_edges`, plus the original id of every
+    node in `node_ids`.
+        Returns 1 upon failure.
+    */
+    double start = omp_get_wtime();
+    size_t file_size;
+    char * data = map_file(file_name, &file_size);
+    if (data == NULL) {
+        printf("ERROR while reading graph `%s`\n", file_name);
+        return 1;
+    }
+    char * file_end = data + file_size;
+
+    struct edge_section sections[MAX_EDGE_SECTIONS];
+    int sections_count = 1, status = 0;
+    long long declared_nodes = -1;
+    if (format == FORMAT_MTX)
+        status = find_mtx_sections(data, file_end, sections, &sections_count, &declared_nodes);
+    else if (format == FORMAT_PAJEK)
+        status = find_pajek_sections(data, file_end, sections, &sections_count, &declared_nodes);
+    else {
+        sections[0].begin = data;
+        sections[0].end = file_end;
+        sections[0].undirected = 0;
+    }
+    if (status) {
+        unmap_file(data, file_size);
+        return 1;
+    }
+
+    long long * pairs;
+    long long total = parse_raw_sections(sections, sections_count, &pairs);
+    unmap_file(data, file_size);
+    if (total < 0 || build_raw_edges(pairs, total, declared_nodes, 1, edges, out_degrees, in_degrees,
+                nodes_count, edges_count, node_ids))
+        return 1;
+
+    double elapsed = omp_get_wtime() - start;
+    printf("Parsed %.1f MB (%s, %d nodes, %lld edges) with %d threads in %.4f s (%.1f MB/s)\n", file_size / 1e6,
+            graph_format_name(format), *nodes_count, (long long) *edges_count, omp_get_max_threads(), elapsed,
+            file_size / 1e6 / elapsed);
+    return 0;
+}
+
+#endif
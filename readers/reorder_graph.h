@@ -0,0 +1,372 @@
+#ifndef REORDER_GRAPH
+#define REORDER_GRAPH
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "custom_matrix.h"
+#include "raw_graph.h"
+#include "../global_config.h"
+
+#define GORDER_HUB_DEGREE 256 // in-lists longer than this are not used to score siblings
+#define REORDER_TIMING_SWEEPS 3
+
+
+char * reorder_strategy_name(int strategy) {
+    switch (strategy) {
+        case REORDER_NONE: return "none";
+        case REORDER_DEGREE: return "degree";
+        case REORDER_BFS: return "bfs";
+        case REORDER_RCM: return "rcm";
+        case REORDER_GORDER: return "gorder";
+        default: return "unknown";
+    }
+}
+
+void order_by_degree(int * degrees, int nodes_count, int descending, int * order) {
+    // stable counting sort of the nodes by degree
+    int max_degree = 0;
+    for (int i = 0; i < nodes_count; i++)
+        if (degrees[i] > max_degree)
+            max_degree = degrees[i];
+
+    int * starts = (int *) calloc(max_degree + 2, sizeof(int));
+    for (int i = 0; i < nodes_count; i++)
+        starts[(descending ? max_degree - degrees[i] : degrees[i]) + 1]++;
+    for (int d = 0; d <= max_degree; d++)
+        starts[d + 1] += starts[d];
+    for (int i = 0; i < nodes_count; i++)
+        order[starts[descending ? max_degree - degrees[i] : degrees[i]]++] = i;
+    free(starts);
+}
+
+void order_by_bfs(int ** graph_in, int ** graph_out, int * in_degrees, int * out_degrees, int nodes_count,
+        int cuthill_mckee, int * order) {
+    /*
+     * breadth-first order over the undirected graph (in- and out-neighbours). Every component
+     * starts from its highest degree node. With `cuthill_mckee` it starts from its lowest degree
+     * node instead, the new neighbours of each node are queued by increasing degree and the
+     * final order is reversed (reverse Cuthill-McKee)
+     */
+    int * degrees = (int *) malloc(nodes_count * sizeof(int));
+    int * starts = (int *) malloc(nodes_count * sizeof(int));
+    char * visited = (char *) calloc(nodes_count, sizeof(char));
+    int max_degree = 0;
+    for (int i = 0; i < nodes_count; i++) {
+        degrees[i] = in_degrees[i] + out_degrees[i];
+        if (degrees[i] > max_degree)
+            max_degree = degrees[i];
+    }
+    order_by_degree(degrees, nodes_count, !cuthill_mckee, starts);
+    long long * batch = (long long *) malloc((max_degree + 1) * sizeof(long long));
+
+    int head = 0, tail = 0;
+    for (int s = 0; s < nodes_count; s++) {
+        if (visited[starts[s]])
+            continue;
+        visited[starts[s]] = 1;
+        order[tail++] = starts[s];
+
+        while (head < tail) {
+            int node = order[head++];
+            int batch_size = 0;
+            for (int j = 0; j < in_degrees[node]; j++) {
+                int neighbour = graph_in[node][j];
+                if (!visited[neighbour]) {
+                    visited[neighbour] = 1;
+                    batch[batch_size++] = ((long long) degrees[neighbour] << 32) | neighbour;
+                }
+            }
+            for (int j = 0; j < out_degrees[node]; j++) {
+                int neighbour = graph_out[node][j];
+                if (!visited[neighbour]) {
+                    visited[neighbour] = 1;
+                    batch[batch_size++] = ((long long) degrees[neighbour] << 32) | neighbour;
+                }
+            }
+            if (cuthill_mckee)
+                qsort(batch, batch_size, sizeof(long long), long_long_compare);
+            for (int k = 0; k < batch_size; k++)
+                order[tail++] = (int) (batch[k] & 0xffffffffLL);
+        }
+    }
+
+    if (cuthill_mckee)
+        for (int i = 0, j = nodes_count - 1; i < j; i++, j--) {
+            int tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+        }
+
+    free(batch);
+    free(visited);
+    free(starts);
+    free(degrees);
+}
+
+struct score_buckets {
+    int * score;
+    int * next;
+    int * prev;
+    int * head;   // first node of every score, -1 if none
+    int head_size;
+    int top;      // no node has a higher score
+};
+
+void score_buckets_insert(struct score_buckets * b, int node) {
+    int s = b->score[node];
+    if (s >= b->head_size) {
+        int size = b->head_size;
+        b->head_size = 2 * s;
+        b->head = (int *) realloc(b->head, b->head_size * sizeof(int));
+        for (int i = size; i < b->head_size; i++)
+            b->head[i] = -1;
+    }
+    b->prev[node] = -1;
+    b->next[node] = b->head[s];
+    if (b->head[s] != -1)
+        b->prev[b->head[s]] = node;
+    b->head[s] = node;
+    if (s > b->top)
+        b->top = s;
+}
+
+void score_buckets_remove(struct score_buckets * b, int node) {
+    if (b->prev[node] != -1)
+        b->next[b->prev[node]] = b->next[node];
+    else
+        b->head[b->score[node]] = b->next[node];
+    if (b->next[node] != -1)
+        b->prev[b->next[node]] = b->prev[node];
+}
+
+void score_buckets_update(struct score_buckets * b, int node, int delta) {
+    score_buckets_remove(b, node);
+    b->score[node] += delta;
+    score_buckets_insert(b, node);
+}
+
+int score_buckets_pop_max(struct score_buckets * b) {
+    while (b->top > 0 && b->head[b->top] == -1)
+        b->top--;
+    int node = b->head[b->top];
+    score_buckets_remove(b, node);
+    return node;
+}
+
+void update_window_scores(struct score_buckets * b, char * placed, int ** graph_in, int ** graph_out,
+        int * in_degrees, int * out_degrees, int node, int delta) {
+    // direct neighbours, then the nodes that share an out-neighbour (siblings) with `node`
+    for (int j = 0; j < out_degrees[node]; j++)
+        if (!placed[graph_out[node][j]])
+            score_buckets_update(b, graph_out[node][j], delta);
+    for (int j = 0; j < in_degrees[node]; j++)
+        if (!placed[graph_in[node][j]])
+            score_buckets_update(b, graph_in[node][j], delta);
+    for (int j = 0; j < out_degrees[node]; j++) {
+        int target = graph_out[node][j];
+        if (in_degrees[target] > GORDER_HUB_DEGREE)
+            continue;
+        for (int k = 0; k < in_degrees[target]; k++)
+            if (!placed[graph_in[target][k]])
+                score_buckets_update(b, graph_in[target][k], delta);
+    }
+}
+
+void order_by_window(int ** graph_in, int ** graph_out, int * in_degrees, int * out_degrees, int nodes_count,
+        int * order) {
+    /*
+     * Gorder-style greedy order: the next node is the unplaced one with the most relations to
+     * the last GORDER_WINDOW placed nodes, i.e. an edge in either direction or a common
+     * out-neighbour (both are gathered by the same in-list). Scores are kept in bucket lists,
+     * so every update is O(1). Ties go to the node with the highest in-degree
+     */
+    struct score_buckets b;
+    b.score = (int *) calloc(nodes_count, sizeof(int));
+    b.next = (int *) malloc(nodes_count * sizeof(int));
+    b.prev = (int *) malloc(nodes_count * sizeof(int));
+    b.head_size = 64;
+    b.head = (int *) malloc(b.head_size * sizeof(int));
+    for (int i = 0; i < b.head_size; i++)
+        b.head[i] = -1;
+    b.top = 0;
+    char * placed = (char *) calloc(nodes_count, sizeof(char));
+
+    // nodes are pushed in front of their bucket: insert by increasing in-degree
+    int * by_degree = (int *) malloc(nodes_count * sizeof(int));
+    order_by_degree(in_degrees, nodes_count, 0, by_degree);
+    for (int i = 0; i < nodes_count; i++)
+        score_buckets_insert(&b, by_degree[i]);
+    free(by_degree);
+
+    for (int p = 0; p < nodes_count; p++) {
+        int node = score_buckets_pop_max(&b);
+        placed[node] = 1;
+        order[p] = node;
+        update_window_scores(&b, placed, graph_in, graph_out, in_degrees, out_degrees, node, 1);
+        if (p >= GORDER_WINDOW)
+            update_window_scores(&b, placed, graph_in, graph_out, in_degrees, out_degrees,
+                    order[p - GORDER_WINDOW], -1);
+    }
+
+    free(placed);
+    free(b.head);
+    free(b.prev);
+    free(b.next);
+    free(b.score);
+}
+
+int apply_order(int * order, int *** graph, edge_t ** offsets, int ** in_degrees, int ** out_degrees,
+        int ** leaves, int leaves_count, int nodes_count, edge_t edges_count) {
+    /*
+     * relabels the nodes so that node order[i] becomes node i. The in-lists are rewritten with
+     * the new ids and sorted again, so the in-matrix stays the CSR of the transposed graph.
+     * The old arrays may be mapped from the graph cache, so they are not freed
+     */
+    int * new_id = (int *) malloc(nodes_count * sizeof(int));
+    int * new_in = (int *) malloc(nodes_count * sizeof(int));
+    int * new_out = (int *) malloc(nodes_count * sizeof(int));
+    int * new_leaves = (int *) malloc((leaves_count > 0 ? leaves_count : 1) * sizeof(int));
+    edge_t * new_offsets = (edge_t *) malloc((nodes_count + 1) * sizeof(edge_t));
+    int * contiguous_space = (int *) malloc((edges_count > 0 ? edges_count : 1) * sizeof(int));
+    int ** new_graph = (int **) malloc(nodes_count * sizeof(int *));
+    if (new_id == NULL || new_in == NULL || new_out == NULL || new_leaves == NULL || new_offsets == NULL
+            || contiguous_space == NULL || new_graph == NULL) {
+        printf("Could not allocate space for the reordered graph.\n");
+        return 1;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < nodes_count; i++) {
+        new_id[order[i]] = i;
+        new_in[i] = (*in_degrees)[order[i]];
+        new_out[i] = (*out_degrees)[order[i]];
+    }
+    new_offsets[0] = 0;
+    for (int i = 0; i < nodes_count; i++) {
+        new_offsets[i + 1] = new_offsets[i] + new_in[i];
+        new_graph[i] = &contiguous_space[new_offsets[i]];
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (int i = 0; i < nodes_count; i++) {
+        int * old_row = (*graph)[order[i]];
+        for (int j = 0; j < new_in[i]; j++)
+            new_graph[i][j] = new_id[old_row[j]];
+        qsort(new_graph[i], new_in[i], sizeof(int), node_compare);
+    }
+
+    for (int k = 0; k < leaves_count; k++)
+        new_leaves[k] = new_id[(*leaves)[k]];
+    qsort(new_leaves, leaves_count, sizeof(int), node_compare);
+
+    free(new_id);
+    *graph = new_graph;
+    *offsets = new_offsets;
+    *in_degrees = new_in;
+    *out_degrees = new_out;
+    *leaves = new_leaves;
+    return 0;
+}
+
+double average_gather_distance(int ** graph, int * in_degrees, int nodes_count) {
+    // mean distance between the node being computed and the nodes it gathers from
+    double total = 0.;
+    long long count = 0;
+    #pragma omp parallel for schedule(guided) reduction(+ : total, count)
+    for (int i = 0; i < nodes_count; i++) {
+        for (int j = 0; j < in_degrees[i]; j++)
+            total += abs(graph[i][j] - i);
+        count += in_degrees[i];
+    }
+    return count > 0 ? total / count : 0.;
+}
+
+double time_pull_sweep(int ** graph, int * in_degrees, int * out_degrees, int nodes_count) {
+    // average time of one pull sweep as done by `pagerank_custom_in` (parallel)
+    float * pagerank_old = (float *) malloc(nodes_count * sizeof(float));
+    float * pagerank_new = (float *) malloc(nodes_count * sizeof(float));
+    for (int i = 0; i < nodes_count; i++)
+        pagerank_old[i] = 1. / nodes_count;
+
+    double start = omp_get_wtime();
+    for (int sweep = 0; sweep < REORDER_TIMING_SWEEPS; sweep++) {
+        #pragma omp parallel for schedule(guided)
+        for (int i = 0; i < nodes_count; i++) {
+            float i_pr = 0.;
+            for (int j = 0; j < in_degrees[i]; j++)
+                i_pr += pagerank_old[graph[i][j]] / out_degrees[graph[i][j]];
+            pagerank_new[i] = i_pr;
+        }
+        float * tmp = pagerank_old;
+        pagerank_old = pagerank_new;
+        pagerank_new = tmp;
+    }
+    double elapsed = (omp_get_wtime() - start) / REORDER_TIMING_SWEEPS;
+
+    free(pagerank_old);
+    free(pagerank_new);
+    return elapsed;
+}
+
+int reorder_graph(int strategy, int *** graph, edge_t ** offsets, int ** in_degrees, int ** out_degrees,
+        int ** leaves, int leaves_count, int nodes_count, edge_t edges_count, int ** order) {
+    /*
+    Relabels the nodes of the in-matrix returned by `load_graph` to improve the locality
+    of the pull gathers, following `strategy`:
+        - REORDER_DEGREE, hubs first (decreasing out-degree, i.e. the most gathered nodes)
+        - REORDER_BFS, breadth-first from the highest degree node of every component
+        - REORDER_RCM, reverse Cuthill-McKee
+        - REORDER_GORDER, greedy window ordering (see `order_by_window`)
+    Prints the reordering time, and the average gather distance and pull sweep time
+    before and after.
+
+    Parameters:
+        - (in/out) graph, offsets, in_degrees, out_degrees, leaves, as returned by `load_graph`
+        - (in) leaves_count, nodes_count, edges_count
+        - (out) order, `order[i]` is the original id of node `i` (see `restore_order`)
+    Return value: 0 if everything ok, 1 otherwise
+    */
+    double distance_before = average_gather_distance(*graph, *in_degrees, nodes_count);
+    double sweep_before = time_pull_sweep(*graph, *in_degrees, *out_degrees, nodes_count);
+
+    double start = omp_get_wtime();
+    *order = (int *) malloc(nodes_count * sizeof(int));
+    if (strategy == REORDER_DEGREE) {
+        order_by_degree(*out_degrees, nodes_count, 1, *order);
+    } else if (strategy == REORDER_BFS || strategy == REORDER_RCM || strategy == REORDER_GORDER) {
+        int ** graph_out;
+        if (format_graph_out_from_in(*graph, *in_degrees, *out_degrees, &graph_out, nodes_count, edges_count))
+            return 1;
+        if (strategy == REORDER_GORDER)
+            order_by_window(*graph, graph_out, *in_degrees, *out_degrees, nodes_count, *order);
+        else
+            order_by_bfs(*graph, graph_out, *in_degrees, *out_degrees, nodes_count, strategy == REORDER_RCM, *order);
+        free(graph_out[0]);
+        free(graph_out);
+    } else {
+        printf("Unknown reordering strategy %d\n", strategy);
+        return 1;
+    }
+
+    if (apply_order(*order, graph, offsets, in_degrees, out_degrees, leaves, leaves_count, nodes_count, edges_count))
+        return 1;
+    printf("Reordering time (%s): %.4f\n", reorder_strategy_name(strategy), omp_get_wtime() - start);
+
+    printf("Average gather distance: %.1f -> %.1f\n", distance_before,
+            average_gather_distance(*graph, *in_degrees, nodes_count));
+    printf("Pull sweep time: %.5f -> %.5f\n", sweep_before,
+            time_pull_sweep(*graph, *in_degrees, *out_degrees, nodes_count));
+    return 0;
+}
+
+float * restore_order(float * values, int * order, int nodes_count) {
+    // returns a copy of `values` (indexed by the new ids) indexed by the original node ids
+    float * restored = (float *) malloc(nodes_count * sizeof(float));
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < nodes_count; i++)
+        restored[order[i]] = values[i];
+    return restored;
+}
+
+#endif